@@ -42,11 +42,11 @@
 #define R2D(x)              FLT(FLT(x) * FLT(57.29577951308232))/*!< Radians to degrees */
 #define EARTH_RADIUS        FLT(6371.0) /*!< Earth radius in units of kilometers */
 
-#define STAT_UNKNOWN        0
-#define STAT_GGA            1
-#define STAT_GSA            2
-#define STAT_GSV            3
-#define STAT_RMC            4
+#define STAT_UNKNOWN        gps_statement_unknown
+#define STAT_GGA            gps_statement_gga
+#define STAT_GSA            gps_statement_gsa
+#define STAT_GSV            gps_statement_gsv
+#define STAT_RMC            gps_statement_rmc
 
 #define CRC_ADD(_gh, ch)    (_gh)->p.crc_calc ^= (uint8_t)(ch)
 #define TERM_ADD(_gh, ch)   do {    \
@@ -109,6 +109,7 @@ parse_float_number(gps_t* gh, const char* t) {
     return FLT(res);                            /* Return casted value, based on float size */
 }
 
+#if !GPS_CFG_FIXED_POINT
 /**
  * \brief           Parse latitude/longitude NMEA format to double
  * 
@@ -127,6 +128,97 @@ parse_lat_long(gps_t* gh) {
     
     return ll;
 }
+#endif /* !GPS_CFG_FIXED_POINT */
+
+#if GPS_CFG_FIXED_POINT
+/**
+ * \brief           Parse decimal number as fixed point integer
+ * \param[in]       gh: GPS handle
+ * \param[in]       t: Text to parse. Set to `NULL` to parse current GPS term
+ * \param[in]       decimals: Number of decimal places to keep, remaining digits are rounded
+ * \return          Parsed number multiplied by `10^decimals`
+ */
+static int32_t
+parse_fixed_number(gps_t* gh, const char* t, uint8_t decimals) {
+    int32_t res = 0;
+    uint8_t minus;
+
+    if (t == NULL) {
+        t = gh->p.term_str;
+    }
+    for (; *t == ' '; t++) {}                   /* Strip leading spaces */
+
+    minus = (*t == '-' ? (t++, 1) : 0);
+    for (; CIN(*t); t++) {
+        res = 10 * res + CTN(*t);
+    }
+    if (*t == '.') {
+        t++;
+    }
+    for (; decimals > 0; decimals--) {
+        res = 10 * res;
+        if (CIN(*t)) {
+            res += CTN(*t);
+            t++;
+        }
+    }
+    if (CIN(*t) && *t >= '5') {                 /* Round on first dropped digit */
+        res++;
+    }
+    return minus ? -res : res;
+}
+
+/**
+ * \brief           Parse latitude/longitude NMEA format to fixed point
+ *
+ *                  NMEA output for latitude is ddmm.sss and longitude is dddmm.sss
+ * \param[in]       gh: GPS handle
+ * \return          Latitude/Longitude value in units of 1e-7 degrees
+ */
+static int32_t
+parse_lat_long_fixed(gps_t* gh) {
+    const char* t = gh->p.term_str;
+    uint32_t ddmm = 0, frac = 0, scale = 10000000, min;
+
+    for (; *t == ' '; t++) {}                   /* Strip leading spaces */
+    for (; CIN(*t); t++) {                      /* Degrees and integer minutes */
+        ddmm = 10 * ddmm + CTN(*t);
+    }
+    if (*t == '.') {                            /* Fractional minutes, in 1e-7 minutes */
+        for (t++; CIN(*t) && scale > 1; t++) {
+            scale /= 10;
+            frac += CTN(*t) * scale;
+        }
+    }
+    min = (ddmm % 100) * 10000000 + frac;       /* Minutes in 1e-7 units, max 6e8 */
+    return (int32_t)((ddmm / 100) * 10000000 + (min + 30) / 60);
+}
+#endif /* GPS_CFG_FIXED_POINT */
+
+/**
+ * \brief           Parse UTC time in NMEA `hhmmss.sss` format
+ * \param[in]       gh: GPS handle
+ * \return          Time of day in milliseconds
+ */
+static uint32_t
+parse_time_ms(gps_t* gh) {
+    const char* t = gh->p.term_str;
+    uint32_t ms = 0, scale = 1000;
+
+    if (!CIN(t[0]) || !CIN(t[1]) || !CIN(t[2]) || !CIN(t[3]) || !CIN(t[4]) || !CIN(t[5])) {
+        return 0;                               /* Empty before the receiver knows the time */
+    }
+    ms = (10 * CTN(t[0]) + CTN(t[1])) * 3600000UL
+        + (10 * CTN(t[2]) + CTN(t[3])) * 60000UL
+        + (10 * CTN(t[4]) + CTN(t[5])) * 1000UL;
+    if (t[6] == '.') {                          /* Fractional seconds, 10Hz receivers need them */
+        for (t += 7; CIN(*t) && scale > 1; t++) {
+            scale /= 10;
+            ms += CTN(*t) * scale;
+        }
+    }
+    return ms;
+}
 
 /**
  * \brief           Parse received term
@@ -165,10 +257,29 @@ parse_term(gps_t* gh) {
     } else if (gh->p.stat == STAT_GGA) {        /* Process GPGGA statement */
         switch (gh->p.term_num) {
             case 1:                             /* Process UTC time */
+                gh->p.time_ms = parse_time_ms(gh);
                 gh->p.data.gga.hours = 10 * CTN(gh->p.term_str[0]) + CTN(gh->p.term_str[1]);
                 gh->p.data.gga.minutes = 10 * CTN(gh->p.term_str[2]) + CTN(gh->p.term_str[3]);
                 gh->p.data.gga.seconds = 10 * CTN(gh->p.term_str[4]) + CTN(gh->p.term_str[5]);
                 break;
+#if GPS_CFG_FIXED_POINT
+            case 2:                             /* Latitude */
+                gh->p.data.gga.latitude_e7 = parse_lat_long_fixed(gh);  /* Parse latitude */
+                break;
+            case 3:                             /* Latitude north/south information */
+                if (gh->p.term_str[0] == 'S' || gh->p.term_str[0] == 's') {
+                    gh->p.data.gga.latitude_e7 = -gh->p.data.gga.latitude_e7;
+                }
+                break;
+            case 4:                             /* Longitude */
+                gh->p.data.gga.longitude_e7 = parse_lat_long_fixed(gh); /* Parse longitude */
+                break;
+            case 5:                             /* Longitude east/west information */
+                if (gh->p.term_str[0] == 'W' || gh->p.term_str[0] == 'w') {
+                    gh->p.data.gga.longitude_e7 = -gh->p.data.gga.longitude_e7;
+                }
+                break;
+#else /* GPS_CFG_FIXED_POINT */
             case 2:                             /* Latitude */
                 gh->p.data.gga.latitude = parse_lat_long(gh);   /* Parse latitude */
                 break;
@@ -185,18 +296,28 @@ parse_term(gps_t* gh) {
                     gh->p.data.gga.longitude = -gh->p.data.gga.longitude;
                 }
                 break;
+#endif /* !GPS_CFG_FIXED_POINT */
             case 6:                             /* Fix status */
                 gh->p.data.gga.fix = (uint8_t)parse_number(gh, NULL);
                 break;
             case 7:                             /* Satellites in use */
                 gh->p.data.gga.sats_in_use = (uint8_t)parse_number(gh, NULL);
                 break;
+#if GPS_CFG_FIXED_POINT
+            case 9:                             /* Altitude */
+                gh->p.data.gga.altitude_cm = parse_fixed_number(gh, NULL, 2);
+                break;
+            case 11:                            /* Altitude above ellipsoid */
+                gh->p.data.gga.geo_sep_cm = parse_fixed_number(gh, NULL, 2);
+                break;
+#else /* GPS_CFG_FIXED_POINT */
             case 9:                             /* Altitude */
                 gh->p.data.gga.altitude = parse_float_number(gh, NULL);
                 break;
             case 11:                            /* Altitude above ellipsoid */
                 gh->p.data.gga.geo_sep = parse_float_number(gh, NULL);
                 break;
+#endif /* !GPS_CFG_FIXED_POINT */
             default: break;
         }
 #endif /* GPS_CFG_STATEMENT_GPGGA */
@@ -257,6 +378,9 @@ parse_term(gps_t* gh) {
 #if GPS_CFG_STATEMENT_GPRMC
     } else if (gh->p.stat == STAT_RMC) {        /* Process GPRMC statement */
         switch (gh->p.term_num) {
+            case 1:                             /* Process UTC time */
+                gh->p.time_ms = parse_time_ms(gh);
+                break;
             case 2:                             /* Process valid status */
                 gh->p.data.rmc.is_valid = (gh->p.term_str[0] == 'A');
                 break;
@@ -308,15 +432,23 @@ copy_from_tmp_memory(gps_t* gh) {
     if (0) {
 #if GPS_CFG_STATEMENT_GPGGA
     } else if (gh->p.stat == STAT_GGA) {
+#if GPS_CFG_FIXED_POINT
+        gh->latitude_e7 = gh->p.data.gga.latitude_e7;
+        gh->longitude_e7 = gh->p.data.gga.longitude_e7;
+        gh->altitude_cm = gh->p.data.gga.altitude_cm;
+        gh->geo_sep_cm = gh->p.data.gga.geo_sep_cm;
+#else /* GPS_CFG_FIXED_POINT */
         gh->latitude = gh->p.data.gga.latitude;
         gh->longitude = gh->p.data.gga.longitude;
         gh->altitude = gh->p.data.gga.altitude;
         gh->geo_sep = gh->p.data.gga.geo_sep;
+#endif /* !GPS_CFG_FIXED_POINT */
         gh->sats_in_use = gh->p.data.gga.sats_in_use;
         gh->fix = gh->p.data.gga.fix;
         gh->hours = gh->p.data.gga.hours;
         gh->minutes = gh->p.data.gga.minutes;
         gh->seconds = gh->p.data.gga.seconds;
+        gh->time_ms = gh->p.time_ms;
 #endif /* GPS_CFG_STATEMENT_GPGGA */
 #if GPS_CFG_STATEMENT_GPGSA
     } else if (gh->p.stat == STAT_GSA) {
@@ -339,6 +471,7 @@ copy_from_tmp_memory(gps_t* gh) {
         gh->date = gh->p.data.rmc.date;
         gh->month = gh->p.data.rmc.month;
         gh->year = gh->p.data.rmc.year;
+        gh->time_ms = gh->p.time_ms;
 #endif /* GPS_CFG_STATEMENT_GPRMC */
     }
     return 1;
@@ -355,6 +488,22 @@ gps_init(gps_t* gh) {
     return 1;
 }
 
+/**
+ * \brief           Set callback called after each valid statement
+ * \note            Callback is called from \ref gps_process context,
+ *                  statement data are already copied to user memory
+ * \param[in]       gh: GPS handle structure
+ * \param[in]       fn: Callback function. Set to `NULL` to disable it
+ * \param[in]       arg: User argument passed to callback
+ * \return          `1` on success, `0` otherwise
+ */
+uint8_t
+gps_set_statement_fn(gps_t* gh, gps_statement_fn fn, void* arg) {
+    gh->statement_fn = fn;
+    gh->statement_arg = arg;
+    return 1;
+}
+
 /**
  * \brief           Process NMEA data from GPS receiver
  * \param[in]       gh: GPS handle structure
@@ -382,7 +531,11 @@ gps_process(gps_t* gh, const void* data, size_t len) {
             if (check_crc(gh)) {                /* Check for CRC result */
                 /* CRC is OK, in theory we can copy data from statements to user data */
                 copy_from_tmp_memory(gh);       /* Copy memory from temporary to user memory */
+                if (gh->statement_fn != NULL) {
+                    gh->statement_fn(gh, (gps_statement_t)gh->p.stat, gh->statement_arg);
+                }
             }
+            gh->p.stat = STAT_UNKNOWN;          /* Statement is done, ignore repeated line endings */
         } else {
             if (!gh->p.star) {                  /* Add to CRC only if star not yet detected */
                 CRC_ADD(gh, *d);                /* Add to CRC */
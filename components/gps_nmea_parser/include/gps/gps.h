@@ -58,6 +58,18 @@ extern "C" {
 #define GPS_CFG_DOUBLE                      1
 #endif
 
+/**
+ * \brief           Enables `1` or disables `0` fixed point parsing of
+ *                  latitude, longitude, altitude and geoid separation.
+ *                  When enabled, `GGA` coordinates are converted straight from text to
+ *                  `int32_t` in units of `1e-7` degrees and altitudes to centimeters,
+ *                  without any floating point operation.
+ *                  When disabled, \ref gps_float_t fields are used instead.
+ */
+#ifndef GPS_CFG_FIXED_POINT
+#define GPS_CFG_FIXED_POINT                 1
+#endif
+
 /**
  * \brief           Enables `1` or disables `0` `GGA` statement parsing.
  *
@@ -145,16 +157,45 @@ typedef struct {
     uint8_t snr;                                /*!< Signal-to-noise ratio */
 } gps_sat_t;
 
+/**
+ * \brief           List of NMEA statements reported to \ref gps_statement_fn
+ */
+typedef enum {
+    gps_statement_unknown = 0,                  /*!< Unknown or disabled statement */
+    gps_statement_gga,                          /*!< GPGGA statement */
+    gps_statement_gsa,                          /*!< GPGSA statement */
+    gps_statement_gsv,                          /*!< GPGSV statement */
+    gps_statement_rmc,                          /*!< GPRMC statement */
+} gps_statement_t;
+
+struct gps;
+
+/**
+ * \brief           Callback called after each statement with valid CRC
+ *                  has been copied to user memory
+ * \param[in]       gh: GPS handle
+ * \param[in]       stat: Statement which has been processed
+ * \param[in]       arg: User argument set with \ref gps_set_statement_fn
+ */
+typedef void (*gps_statement_fn)(struct gps* gh, gps_statement_t stat, void* arg);
+
 /**
  * \brief           GPS main structure
  */
-typedef struct {
+typedef struct gps {
 #if GPS_CFG_STATEMENT_GPGGA || __DOXYGEN__
     /* Information related to GPGGA statement */
+#if GPS_CFG_FIXED_POINT
+    int32_t latitude_e7;                        /*!< Latitude in units of 1e-7 degrees */
+    int32_t longitude_e7;                       /*!< Longitude in units of 1e-7 degrees */
+    int32_t altitude_cm;                        /*!< Altitude in units of centimeters */
+    int32_t geo_sep_cm;                         /*!< Geoid separation in units of centimeters */
+#else /* GPS_CFG_FIXED_POINT */
     gps_float_t latitude;                       /*!< Latitude in units of degrees */
     gps_float_t longitude;                      /*!< Longitude in units of degrees */
     gps_float_t altitude;                       /*!< Altitude in units of meters */
     gps_float_t geo_sep;                        /*!< Geoid separation in units of meters */
+#endif /* !GPS_CFG_FIXED_POINT */
     uint8_t sats_in_use;                        /*!< Number of satellites in use */
     uint8_t fix;                                /*!< Fix status. `0` = invalid, `1` = GPS fix, `2` = DGPS fix, `3` = PPS fix */
     uint8_t hours;                              /*!< Hours in UTC */
@@ -190,6 +231,12 @@ typedef struct {
     uint8_t year;                               /*!< Fix year */
 #endif /* GPS_CFG_STATEMENT_GPRMC || __DOXYGEN__ */
 
+    uint32_t time_ms;                           /*!< UTC time of day of the last `GGA` or `RMC` statement,
+                                                        in milliseconds. Statements of the same fix share it */
+
+    gps_statement_fn statement_fn;              /*!< Optional statement completion callback */
+    void* statement_arg;                        /*!< User argument for statement callback */
+
 #if !__DOXYGEN__
     struct {
         uint8_t stat;                           /*!< Statement index */
@@ -200,15 +247,24 @@ typedef struct {
         uint8_t star;                           /*!< Star detected flag */
         
         uint8_t crc_calc;                       /*!< Calculated CRC string */
+
+        uint32_t time_ms;                       /*!< UTC time of `GGA` or `RMC` in milliseconds */
         
         union {
             uint8_t dummy;                      /*!< Dummy byte */
 #if GPS_CFG_STATEMENT_GPGGA
             struct {
+#if GPS_CFG_FIXED_POINT
+                int32_t latitude_e7;            /*!< GPS latitude position in 1e-7 degrees */
+                int32_t longitude_e7;           /*!< GPS longitude position in 1e-7 degrees */
+                int32_t altitude_cm;            /*!< GPS altitude in centimeters */
+                int32_t geo_sep_cm;             /*!< Geoid separation in units of centimeters */
+#else /* GPS_CFG_FIXED_POINT */
                 gps_float_t latitude;           /*!< GPS latitude position in degrees */
                 gps_float_t longitude;          /*!< GPS longitude position in degrees */
                 gps_float_t altitude;           /*!< GPS altitude in meters */
                 gps_float_t geo_sep;            /*!< Geoid separation in units of meters */
+#endif /* !GPS_CFG_FIXED_POINT */
                 uint8_t sats_in_use;            /*!< Number of satellites currently in use */
                 uint8_t fix;                    /*!< Type of current fix, `0` = Invalid, `1` = GPS fix, `2` = Differential GPS fix */
                 uint8_t hours;                  /*!< Current UTC hours */
@@ -289,6 +345,7 @@ typedef enum {
 
 uint8_t     gps_init(gps_t* gh);
 uint8_t     gps_process(gps_t* gh, const void* data, size_t len);
+uint8_t     gps_set_statement_fn(gps_t* gh, gps_statement_fn fn, void* arg);
 
 uint8_t     gps_distance_bearing(gps_float_t las, gps_float_t los, gps_float_t lae, gps_float_t loe, gps_float_t* d, gps_float_t* b);
 gps_float_t gps_to_speed(gps_float_t sik, gps_speed_t ts);
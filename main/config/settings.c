@@ -108,9 +108,20 @@ static const char *screen_autopoweroff_table[] = {"Disabled", "30 sec", "1 min",
 #endif
 
 static const char *uart_in_out_type_table[] = {"Input", "Output"};
-static const char *uart_protocol_table[] = {"ATP", "MSP", "MAVLINK", "LTM", "NMEA", "PELCO_D"};
+static const char *uart_protocol_table[] = {"ATP", "MSP", "MAVLINK", "LTM", "NMEA", "PELCO_D", "SMARTPORT", "UBX", "AUTO", "BRIDGE"};
+static const char *mavlink_rate_table[] = {"Off", "1 Hz", "2 Hz", "5 Hz", "10 Hz"};
 static const char *uart_baudrate_table[] = {"1200", "2400", "4800", "9600", "19200", "38400", "57600", "115200"};
 
+#if defined(USE_WIFI)
+static const char *wifi_mode_table[] = {"Station", "AP"};
+static const char *wifi_power_save_table[] = {"None", "Min", "Max"};
+#endif
+
+#if defined(USE_IMU)
+// Indexed by imu_log_mode_e
+static const char *imu_log_table[] = {"Off", "UDP", "RAM"};
+#endif
+
 static const char *home_source_table[] = {"NONE", "UART1", "UART2"};
 
 static const char *estimate_second_table[] = {"1 sec", "3 sec", "5 sec", "10 sec"};
@@ -188,10 +199,17 @@ static const setting_t settings[] = {
     STRING_SETTING(SETTING_KEY_WIFI_SSID, "SSID", FOLDER_ID_WIFI),
     STRING_SETTING(SETTING_KEY_WIFI_PWD, "PWD", FOLDER_ID_WIFI),
     STRING_SETTING(SETTING_KEY_WIFI_IP, "IP", FOLDER_ID_WIFI),
+    STRING_SETTING(SETTING_KEY_WIFI_NETMASK, "Netmask", FOLDER_ID_WIFI),
+    STRING_SETTING(SETTING_KEY_WIFI_GATEWAY, "Gateway", FOLDER_ID_WIFI),
     CMD_SETTING(SETTING_KEY_WIFI_SMART_CONFIG, "Smart Config", FOLDER_ID_WIFI, 0, SETTING_CMD_STATUS_NONE),
+    U8_MAP_SETTING(SETTING_KEY_WIFI_MODE, "Mode", 0, FOLDER_ID_WIFI, wifi_mode_table, 0),
+    U8_SETTING(SETTING_KEY_WIFI_AP_CHANNEL, "AP Channel", 0, FOLDER_ID_WIFI, 1, 13, 6),
+    BOOL_SETTING(SETTING_KEY_WIFI_STATIC_IP, "Static IP", 0, FOLDER_ID_WIFI, false),
+    U8_MAP_SETTING(SETTING_KEY_WIFI_POWER_SAVE, "Power Save", 0, FOLDER_ID_WIFI, wifi_power_save_table, 1),
 #endif
 
     FOLDER(SETTING_KEY_PORT, "Port", FOLDER_ID_PORT, FOLDER_ID_ROOT, NULL),
+    U8_MAP_SETTING(SETTING_KEY_PORT_MAVLINK_RATE, "MAVLink Rate", 0, FOLDER_ID_PORT, mavlink_rate_table, 1),
 
     FOLDER(SETTING_KEY_PORT_UART1, "UART1", FOLDER_ID_UART1, FOLDER_ID_PORT, NULL),
     BOOL_SETTING(SETTING_KEY_PORT_UART1_ENABLE, "Enable", SETTING_FLAG_NAME_MAP, FOLDER_ID_UART1, false),
@@ -243,6 +261,8 @@ static const setting_t settings[] = {
     FOLDER(SETTING_KEY_IMU, "IMU", FOLDER_ID_IMU, FOLDER_ID_ROOT, NULL),
     BOOL_SETTING(SETTING_KEY_IMU_ENABLE, "Enable", SETTING_FLAG_NAME_MAP, FOLDER_ID_IMU, true),
     CMD_SETTING(SETTING_KEY_IMU_INFO, "IMU Info", FOLDER_ID_IMU, 0, SETTING_CMD_STATUS_NONE),
+    U8_MAP_SETTING(SETTING_KEY_IMU_LOG, "Raw Log", 0, FOLDER_ID_IMU, imu_log_table, 0),
+    BOOL_SETTING(SETTING_KEY_IMU_GYRO_AUTO_BIAS, "Gyro Auto Bias", SETTING_FLAG_NAME_MAP, FOLDER_ID_IMU, true),
     FOLDER(SETTING_KEY_IMU_CALIBRATION, "Calibration", FOLDER_ID_CALIBRATION, FOLDER_ID_IMU, NULL),
 
     CMD_SETTING(SETTING_KEY_IMU_CALIBRATION_ACC, "ACC", FOLDER_ID_CALIBRATION, 0, SETTING_CMD_STATUS_NONE),
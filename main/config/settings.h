@@ -18,7 +18,7 @@
 #define SETTING_ADVANCED_POS_FOLDER_COUNT 2
 #define SETTING_HOME_FOLDER_COUNT 9
 #if defined(USE_WIFI)
-#define SETTING_WIFI_FOLDER_COUNT 6
+#define SETTING_WIFI_FOLDER_COUNT 12
 #else
 #define SETTING_WIFI_FOLDER_COUNT 0
 #endif
@@ -27,7 +27,7 @@
 #define SETTING_SERVO_TILT_FOLDER_COUNT 6
 #define SETTING_EASE_FOLDER_COUNT 7
 
-#define SETTING_PORT_FOLDER_COUNT 3
+#define SETTING_PORT_FOLDER_COUNT 4
 #define SETTING_PORT_UART1_FOLDER_COUNT 4
 #define SETTING_PORT_UART2_FOLDER_COUNT 4
 // #define SETTING_PORT_UART1_FOLDER_COUNT 6
@@ -64,7 +64,7 @@
 #endif
 
 #if defined(USE_IMU)
-#define SETTING_IMU_FOLDER_COUNT 4
+#define SETTING_IMU_FOLDER_COUNT 6
 #define SETTING_IMU_CALIBRATION_FOLDER_COUNT 3
 #else
 #define SETTING_IMU_FOLDER_COUNT 0
@@ -134,12 +134,20 @@
 #define SETTING_KEY_WIFI_SSID SETTING_KEY_WIFI_PREFIX "ssid"
 #define SETTING_KEY_WIFI_PWD SETTING_KEY_WIFI_PREFIX "pwd"
 #define SETTING_KEY_WIFI_IP SETTING_KEY_WIFI_PREFIX "ip"
+#define SETTING_KEY_WIFI_NETMASK SETTING_KEY_WIFI_PREFIX "nm"
+#define SETTING_KEY_WIFI_GATEWAY SETTING_KEY_WIFI_PREFIX "gw"
 #define SETTING_KEY_WIFI_SMART_CONFIG SETTING_KEY_WIFI_PREFIX "sc"
+#define SETTING_KEY_WIFI_MODE SETTING_KEY_WIFI_PREFIX "mode"
+#define SETTING_KEY_WIFI_AP_CHANNEL SETTING_KEY_WIFI_PREFIX "ch"
+#define SETTING_KEY_WIFI_STATIC_IP SETTING_KEY_WIFI_PREFIX "sip"
+#define SETTING_KEY_WIFI_POWER_SAVE SETTING_KEY_WIFI_PREFIX "ps"
 #endif
 
 #define SETTING_KEY_PORT "port"
 #define SETTING_KEY_PORT_PREFIX SETTING_KEY_PORT "."
 
+#define SETTING_KEY_PORT_MAVLINK_RATE SETTING_KEY_PORT_PREFIX "mr"
+
 #define SETTING_KEY_PORT_UART1 SETTING_KEY_PORT_PREFIX "u1"
 #define SETTING_KEY_PORT_UART1_PREFIX SETTING_KEY_PORT_UART1 "."
 #define SETTING_KEY_PORT_UART1_ENABLE SETTING_KEY_PORT_UART1_PREFIX "Enable"
@@ -205,6 +213,8 @@
 #define SETTING_KEY_IMU_PREFIX SETTING_KEY_IMU "."
 #define SETTING_KEY_IMU_ENABLE SETTING_KEY_IMU_PREFIX "Enable"
 #define SETTING_KEY_IMU_INFO SETTING_KEY_IMU_PREFIX "info"
+#define SETTING_KEY_IMU_LOG SETTING_KEY_IMU_PREFIX "log"
+#define SETTING_KEY_IMU_GYRO_AUTO_BIAS SETTING_KEY_IMU_PREFIX "gbias"
 
 #define SETTING_KEY_IMU_CALIBRATION SETTING_KEY_IMU_PREFIX "c"
 #define SETTING_KEY_IMU_CALIBRATION_PREFIX SETTING_KEY_IMU_PREFIX "."
@@ -17,6 +17,7 @@ typedef struct input_s
 {
     bool is_open;
     bool home_source;
+    uint8_t source;
     void *data;
     input_vtable_t vtable;
 } input_t;
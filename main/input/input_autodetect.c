@@ -0,0 +1,283 @@
+#include <stdio.h>
+
+#include <hal/log.h>
+#include "input/input_autodetect.h"
+#include "platform/storage.h"
+#include "util/macros.h"
+#include "../components/c_library_v2/common/mavlink.h"
+
+#define AUTODETECT_STORAGE_KEY "autodetect"
+
+static const char *TAG = "Input.Autodetect";
+
+// Most common telemetry baudrates first
+static const int autodetect_baudrates[] = { PROTOCOL_BAUDRATE_115200, PROTOCOL_BAUDRATE_57600, PROTOCOL_BAUDRATE_9600, PROTOCOL_BAUDRATE_38400, PROTOCOL_BAUDRATE_19200, PROTOCOL_BAUDRATE_4800, PROTOCOL_BAUDRATE_2400, PROTOCOL_BAUDRATE_1200 };
+
+static const protocol_e autodetect_protocols[INPUT_AUTODETECT_COUNT] = {
+    [INPUT_AUTODETECT_LTM] = PROTOCOL_LTM,
+    [INPUT_AUTODETECT_MAVLINK] = PROTOCOL_MAVLINK,
+    [INPUT_AUTODETECT_NMEA] = PROTOCOL_NMEA,
+    [INPUT_AUTODETECT_UBX] = PROTOCOL_UBX,
+};
+
+static storage_t storage;
+static bool storage_initialized = false;
+
+// Parser state of our own for each UART. mavlink_parse_char() would need a
+// channel, and those belong to the router, which takes the UART over once
+// MAVLink is detected (see MAVLINK_LINK_CHANNEL()).
+static struct
+{
+    mavlink_message_t message;
+    mavlink_status_t status;
+} autodetect_mavlink[INPUT_AUTODETECT_UART_COUNT];
+
+static storage_t *input_autodetect_storage(void)
+{
+    if (!storage_initialized)
+    {
+        storage_init(&storage, AUTODETECT_STORAGE_KEY);
+        storage_initialized = true;
+    }
+    return &storage;
+}
+
+bool input_autodetect_load(uint8_t com, protocol_e *protocol, int *baudrate)
+{
+    char key[16];
+    uint8_t p;
+    uint32_t b;
+
+    snprintf(key, sizeof(key), "uart%u_protocol", com);
+    if (!storage_get_u8(input_autodetect_storage(), key, &p) || p >= PROTOCOL_AUTO)
+    {
+        return false;
+    }
+
+    snprintf(key, sizeof(key), "uart%u_baudrate", com);
+    if (!storage_get_u32(input_autodetect_storage(), key, &b))
+    {
+        return false;
+    }
+
+    *protocol = p;
+    *baudrate = b;
+    return true;
+}
+
+static void input_autodetect_save(uint8_t com, protocol_e protocol, int baudrate)
+{
+    char key[16];
+
+    snprintf(key, sizeof(key), "uart%u_protocol", com);
+    storage_set_u8(input_autodetect_storage(), key, protocol);
+
+    snprintf(key, sizeof(key), "uart%u_baudrate", com);
+    storage_set_u32(input_autodetect_storage(), key, baudrate);
+
+    storage_commit(input_autodetect_storage());
+}
+
+static void input_autodetect_nmea_statement(struct gps *gh, gps_statement_t stat, void *arg)
+{
+    input_autodetect_t *input_autodetect = arg;
+
+    // Only called for sentences that passed the checksum
+    if (stat != gps_statement_unknown)
+    {
+        input_autodetect->frames[INPUT_AUTODETECT_NMEA]++;
+    }
+}
+
+static void input_autodetect_reset(input_autodetect_t *input_autodetect)
+{
+    memset(input_autodetect->frames, 0, sizeof(input_autodetect->frames));
+    input_autodetect->ltm.status = LTM_IDLE;
+    input_autodetect->ubx.status = UBX_IDLE;
+    memset(&autodetect_mavlink[input_autodetect->com - 1], 0, sizeof(autodetect_mavlink[0]));
+}
+
+// Same as mavlink_parse_char(), on this UART's own parser state
+static bool input_autodetect_mavlink_parse(input_autodetect_t *input_autodetect, uint8_t c)
+{
+    mavlink_message_t *rxmsg = &autodetect_mavlink[input_autodetect->com - 1].message;
+    mavlink_status_t *status = &autodetect_mavlink[input_autodetect->com - 1].status;
+    mavlink_message_t message;
+    mavlink_status_t message_status;
+
+    uint8_t result = mavlink_frame_char_buffer(rxmsg, status, c, &message, &message_status);
+    if (result == MAVLINK_FRAMING_BAD_CRC || result == MAVLINK_FRAMING_BAD_SIGNATURE)
+    {
+        status->msg_received = MAVLINK_FRAMING_INCOMPLETE;
+        status->parse_state = MAVLINK_PARSE_STATE_IDLE;
+        if (c == MAVLINK_STX)
+        {
+            status->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
+            rxmsg->len = 0;
+            mavlink_start_checksum(rxmsg);
+        }
+        return false;
+    }
+    return result == MAVLINK_FRAMING_OK;
+}
+
+static void input_autodetect_next_baudrate(input_autodetect_t *input_autodetect, time_micros_t now)
+{
+    input_autodetect->baudrate_index = (input_autodetect->baudrate_index + 1) % ARRAY_COUNT(autodetect_baudrates);
+    input_autodetect->baudrate = autodetect_baudrates[input_autodetect->baudrate_index];
+    input_autodetect->next_baudrate_switch = now + MILLIS_TO_MICROS(INPUT_AUTODETECT_DWELL_MS);
+
+    serial_port_set_baudrate(input_autodetect->serial_port, input_autodetect->baudrate);
+    input_autodetect_reset(input_autodetect);
+
+    LOG_D(TAG, "Probing [UART%d] at %d", input_autodetect->com, input_autodetect->baudrate);
+}
+
+static bool input_autodetect_update(void *input, void *data, time_micros_t now)
+{
+    input_autodetect_t *input_autodetect = input;
+
+    if (input_autodetect->locked)
+    {
+        return false;
+    }
+
+    if (now > input_autodetect->next_baudrate_switch)
+    {
+        bool progress = false;
+        for (int ii = 0; ii < INPUT_AUTODETECT_COUNT; ii++)
+        {
+            progress |= input_autodetect->frames[ii] > 0;
+        }
+
+        if (progress)
+        {
+            // Got a valid frame at this baudrate, give it some more time
+            input_autodetect->next_baudrate_switch = now + MILLIS_TO_MICROS(INPUT_AUTODETECT_DWELL_MS);
+        }
+        else
+        {
+            input_autodetect_next_baudrate(input_autodetect, now);
+        }
+    }
+
+    int n = serial_port_read(input_autodetect->serial_port, input_autodetect->buf, sizeof(input_autodetect->buf), 0);
+    if (n <= 0)
+    {
+        return false;
+    }
+
+    for (int ii = 0; ii < n; ii++)
+    {
+        uint8_t c = input_autodetect->buf[ii];
+
+        if (ltm_decode(&input_autodetect->ltm, c))
+        {
+            input_autodetect->frames[INPUT_AUTODETECT_LTM]++;
+        }
+        if (input_autodetect_mavlink_parse(input_autodetect, c))
+        {
+            input_autodetect->frames[INPUT_AUTODETECT_MAVLINK]++;
+        }
+        if (ubx_decode(&input_autodetect->ubx, c))
+        {
+            input_autodetect->frames[INPUT_AUTODETECT_UBX]++;
+        }
+    }
+
+    gps_process(&input_autodetect->gps, input_autodetect->buf, n);
+
+    for (int ii = 0; ii < INPUT_AUTODETECT_COUNT; ii++)
+    {
+        if (input_autodetect->frames[ii] >= INPUT_AUTODETECT_LOCK_FRAMES)
+        {
+            input_autodetect->locked = true;
+            input_autodetect->protocol = autodetect_protocols[ii];
+            LOG_I(TAG, "Detected protocol %d at %d on [UART%d]", input_autodetect->protocol, input_autodetect->baudrate, input_autodetect->com);
+            input_autodetect_save(input_autodetect->com, input_autodetect->protocol, input_autodetect->baudrate);
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool input_autodetect_get_result(const input_autodetect_t *input, protocol_e *protocol, int *baudrate)
+{
+    if (!input->locked)
+    {
+        return false;
+    }
+
+    *protocol = input->protocol;
+    *baudrate = input->baudrate;
+    return true;
+}
+
+static void input_autodetect_close(void *input, void *config)
+{
+    input_autodetect_t *input_autodetect = input;
+    serial_port_destroy(&input_autodetect->serial_port);
+    gps_set_statement_fn(&input_autodetect->gps, NULL, NULL);
+    ltm_destroy(&input_autodetect->ltm);
+    ubx_destroy(&input_autodetect->ubx);
+}
+
+static bool input_autodetect_open(void *input, void *config)
+{
+    input_autodetect_config_t *config_autodetect = config;
+    input_autodetect_t *input_autodetect = input;
+    time_micros_t now = time_micros_now();
+
+    input_autodetect->inverted = false;
+    input_autodetect->last_frame_recv = now;
+    input_autodetect->enable_rx_deadline = TIME_MICROS_MAX;
+    input_autodetect->com = config_autodetect->com;
+    input_autodetect->locked = false;
+    input_autodetect->baudrate_index = 0;
+
+    // Start with the given baudrate, then cycle through the rest
+    for (int ii = 0; ii < ARRAY_COUNT(autodetect_baudrates); ii++)
+    {
+        if (autodetect_baudrates[ii] == config_autodetect->baudrate)
+        {
+            input_autodetect->baudrate_index = ii;
+            break;
+        }
+    }
+    input_autodetect->baudrate = autodetect_baudrates[input_autodetect->baudrate_index];
+    input_autodetect->next_baudrate_switch = now + MILLIS_TO_MICROS(INPUT_AUTODETECT_DWELL_MS);
+
+    serial_port_config_t serial_config = {
+        .baud_rate = input_autodetect->baudrate,
+        .tx_pin = config_autodetect->tx,
+        .rx_pin = config_autodetect->rx,
+        .tx_buffer_size = INPUT_AUTODETECT_READ_SIZE,
+        .rx_buffer_size = INPUT_AUTODETECT_READ_SIZE * 4,
+        .parity = SERIAL_PARITY_DISABLE,
+        .stop_bits = SERIAL_STOP_BITS_1,
+        .inverted = input_autodetect->inverted,
+    };
+
+    input_autodetect->serial_port = serial_port_open(&serial_config);
+    LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", input_autodetect->baudrate, gpio_toa(config_autodetect->tx), gpio_toa(config_autodetect->rx));
+
+    ltm_init(&input_autodetect->ltm);
+    ubx_init(&input_autodetect->ubx);
+    gps_init(&input_autodetect->gps);
+    gps_set_statement_fn(&input_autodetect->gps, input_autodetect_nmea_statement, input_autodetect);
+
+    input_autodetect_reset(input_autodetect);
+
+    return true;
+}
+
+void input_autodetect_init(input_autodetect_t *input)
+{
+    input->serial_port = NULL;
+    input->input.vtable = (input_vtable_t){
+        .open = input_autodetect_open,
+        .update = input_autodetect_update,
+        .close = input_autodetect_close,
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input/input.h"
+
+#include "io/gpio.h"
+#include "io/serial.h"
+
+#include "protocols/protocol.h"
+#include "protocols/ltm.h"
+#include "protocols/nmea.h"
+#include "protocols/ubx.h"
+
+// Time spent listening at each baudrate before trying the next one
+#define INPUT_AUTODETECT_DWELL_MS 1500
+// Valid (CRC checked) frames required before locking onto a protocol
+#define INPUT_AUTODETECT_LOCK_FRAMES 3
+#define INPUT_AUTODETECT_READ_SIZE 128
+// UART1 and UART2
+#define INPUT_AUTODETECT_UART_COUNT 2
+
+typedef enum
+{
+    INPUT_AUTODETECT_LTM,
+    INPUT_AUTODETECT_MAVLINK,
+    INPUT_AUTODETECT_NMEA,
+    INPUT_AUTODETECT_UBX,
+    INPUT_AUTODETECT_COUNT,
+} input_autodetect_detector_e;
+
+typedef struct input_autodetect_config_s
+{
+    int baudrate;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+    uint8_t com;
+} input_autodetect_config_t;
+
+typedef struct input_autodetect_s
+{
+    input_t input;
+    serial_port_t *serial_port;
+    time_micros_t last_frame_recv;
+    time_micros_t enable_rx_deadline;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+    bool inverted;
+    time_micros_t next_inversion_switch;
+
+    uint8_t com;
+    uint8_t buf[INPUT_AUTODETECT_READ_SIZE];
+    uint8_t baudrate_index;
+    time_micros_t next_baudrate_switch;
+    uint8_t frames[INPUT_AUTODETECT_COUNT];
+    bool locked;
+    protocol_e protocol;
+    int baudrate;
+
+    ltm_t ltm;
+    ubx_t ubx;
+    gps_t gps;
+} input_autodetect_t;
+
+void input_autodetect_init(input_autodetect_t *input);
+// Returns true once a protocol has been detected, filling protocol and baudrate
+bool input_autodetect_get_result(const input_autodetect_t *input, protocol_e *protocol, int *baudrate);
+// Returns the last protocol detected on the given UART, if any was persisted
+bool input_autodetect_load(uint8_t com, protocol_e *protocol, int *baudrate);
@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include <hal/log.h>
+#include "input/input_bridge.h"
+#include "wifi/udp.h"
+
+static const char *TAG = "Input.Bridge";
+
+static void input_bridge_flush(input_bridge_t *input_bridge, time_micros_t now)
+{
+    uint32_t latency = now - input_bridge->batch_start;
+
+    io_write(&input_bridge->udp, input_bridge->batch, input_bridge->batch_pos);
+
+    input_bridge->stats.downlink_bytes += input_bridge->batch_pos;
+    input_bridge->stats.downlink_datagrams++;
+    input_bridge->stats.batch_latency_total_us += latency;
+    if (latency > input_bridge->stats.batch_latency_max_us)
+    {
+        input_bridge->stats.batch_latency_max_us = latency;
+    }
+
+    input_bridge->batch_pos = 0;
+}
+
+static void input_bridge_log_stats(input_bridge_t *input_bridge, time_micros_t now)
+{
+    input_bridge_stats_t *stats = &input_bridge->stats;
+    uint32_t avg_latency = stats->downlink_datagrams > 0 ? stats->batch_latency_total_us / stats->downlink_datagrams : 0;
+
+    LOG_I(TAG, "[UART%d] down: %u B/s in %u datagrams, batch latency avg %uus max %uus | up: %u B/s",
+          input_bridge->com,
+          stats->downlink_bytes * 1000 / INPUT_BRIDGE_STATS_INTERVAL_MS,
+          stats->downlink_datagrams,
+          avg_latency,
+          stats->batch_latency_max_us,
+          stats->uplink_bytes * 1000 / INPUT_BRIDGE_STATS_INTERVAL_MS);
+
+    memset(stats, 0, sizeof(*stats));
+    input_bridge->next_stats = now + MILLIS_TO_MICROS(INPUT_BRIDGE_STATS_INTERVAL_MS);
+}
+
+static bool input_bridge_update(void *input, void *data, time_micros_t now)
+{
+    input_bridge_t *input_bridge = input;
+    bool updated = false;
+
+    if (!input_bridge->udp_open)
+    {
+        return false;
+    }
+
+    // Aircraft to UDP
+    int n = serial_port_read(input_bridge->serial_port, &input_bridge->batch[input_bridge->batch_pos], sizeof(input_bridge->batch) - input_bridge->batch_pos, 0);
+    if (n > 0)
+    {
+        if (input_bridge->batch_pos == 0)
+        {
+            input_bridge->batch_start = now;
+        }
+        input_bridge->batch_pos += n;
+        updated = true;
+    }
+
+    if (input_bridge->batch_pos == sizeof(input_bridge->batch) ||
+        (input_bridge->batch_pos > 0 && now - input_bridge->batch_start >= INPUT_BRIDGE_BATCH_TIMEOUT_US))
+    {
+        input_bridge_flush(input_bridge, now);
+    }
+
+    // UDP to aircraft, each datagram is written out as soon as it arrives
+    n = io_read(&input_bridge->udp, input_bridge->uplink, sizeof(input_bridge->uplink), 0);
+    if (n > 0)
+    {
+        serial_port_write(input_bridge->serial_port, input_bridge->uplink, n);
+        input_bridge->stats.uplink_bytes += n;
+        updated = true;
+    }
+
+    if (now > input_bridge->next_stats)
+    {
+        input_bridge_log_stats(input_bridge, now);
+    }
+
+    return updated;
+}
+
+static void input_bridge_close(void *input, void *config)
+{
+    input_bridge_t *input_bridge = input;
+    if (input_bridge->udp_open)
+    {
+        wifi_udp_bridge_close(input_bridge->com);
+        input_bridge->udp_open = false;
+    }
+    serial_port_destroy(&input_bridge->serial_port);
+}
+
+static bool input_bridge_open(void *input, void *config)
+{
+    input_bridge_config_t *config_bridge = config;
+    input_bridge_t *input_bridge = input;
+    time_micros_t now = time_micros_now();
+
+    input_bridge->com = config_bridge->com;
+    input_bridge->batch_pos = 0;
+    input_bridge->next_stats = now + MILLIS_TO_MICROS(INPUT_BRIDGE_STATS_INTERVAL_MS);
+    memset(&input_bridge->stats, 0, sizeof(input_bridge->stats));
+
+    serial_port_config_t serial_config = {
+        .baud_rate = config_bridge->baudrate,
+        .tx_pin = config_bridge->tx,
+        .rx_pin = config_bridge->rx,
+        .tx_buffer_size = INPUT_BRIDGE_BATCH_SIZE * 2,
+        .rx_buffer_size = INPUT_BRIDGE_BATCH_SIZE * 4,
+        .parity = SERIAL_PARITY_DISABLE,
+        .stop_bits = SERIAL_STOP_BITS_1,
+        .inverted = false,
+    };
+
+    input_bridge->serial_port = serial_port_open(&serial_config);
+    LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", config_bridge->baudrate, gpio_toa(config_bridge->tx), gpio_toa(config_bridge->rx));
+
+    input_bridge->udp_open = wifi_udp_bridge_open(input_bridge->com, &input_bridge->udp);
+    if (!input_bridge->udp_open)
+    {
+        LOG_E(TAG, "Could not open the UDP side of [UART%d]", input_bridge->com);
+    }
+
+    return true;
+}
+
+void input_bridge_init(input_bridge_t *input)
+{
+    input->serial_port = NULL;
+    input->input.vtable = (input_vtable_t){
+        .open = input_bridge_open,
+        .update = input_bridge_update,
+        .close = input_bridge_close,
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input/input.h"
+
+#include "io/gpio.h"
+#include "io/io.h"
+#include "io/serial.h"
+
+// A datagram is sent when the batch is full or its first byte is this old
+#define INPUT_BRIDGE_BATCH_SIZE 512
+#define INPUT_BRIDGE_BATCH_TIMEOUT_US 1000
+#define INPUT_BRIDGE_STATS_INTERVAL_MS 10000
+
+typedef struct input_bridge_config_s
+{
+    int baudrate;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+    uint8_t com;
+} input_bridge_config_t;
+
+typedef struct input_bridge_stats_s
+{
+    uint32_t downlink_bytes;
+    uint32_t downlink_datagrams;
+    uint32_t uplink_bytes;
+    // Time from the first byte of a batch being read to it being sent
+    uint32_t batch_latency_max_us;
+    uint64_t batch_latency_total_us;
+} input_bridge_stats_t;
+
+typedef struct input_bridge_s
+{
+    input_t input;
+    serial_port_t *serial_port;
+    uint8_t com;
+    io_t udp;
+    bool udp_open;
+
+    uint8_t batch[INPUT_BRIDGE_BATCH_SIZE];
+    int batch_pos;
+    time_micros_t batch_start;
+    uint8_t uplink[INPUT_BRIDGE_BATCH_SIZE];
+
+    input_bridge_stats_t stats;
+    time_micros_t next_stats;
+} input_bridge_t;
+
+void input_bridge_init(input_bridge_t *input);
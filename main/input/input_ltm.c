@@ -10,10 +10,11 @@ static bool input_ltm_update(void *input, void *data, time_micros_t now)
 
     bool updated = false;
 
-    int ret = ltm_update(input_ltm->ltm, data);
+    int ret = ltm_update(&input_ltm->ltm, data);
     if (ret == 2)
     {
         input_ltm->last_frame_recv = now;
+        updated = true;
     }
 
     return updated;
@@ -23,8 +24,7 @@ static void input_ltm_close(void *input, void *config)
 {
     input_ltm_t *input_ltm = input;
     serial_port_destroy(&input_ltm->serial_port);
-    ltm_destroy(input_ltm->ltm);
-    free(input_ltm->ltm);
+    ltm_destroy(&input_ltm->ltm);
 }
 
 static bool input_ltm_open(void *input, void *config)
@@ -51,16 +51,12 @@ static bool input_ltm_open(void *input, void *config)
     input_ltm->serial_port = serial_port_open(&serial_config);
     LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", config_ltm->baudrate, gpio_toa(config_ltm->tx), gpio_toa(config_ltm->rx));
 
-    input_ltm->ltm = (ltm_t *)malloc(sizeof(ltm_t));
+    ltm_init(&input_ltm->ltm);
 
-    ltm_init(input_ltm->ltm);
+    input_ltm->ltm.io = SERIAL_IO(input_ltm->serial_port);
 
-    input_ltm->ltm->io->write = (io_write_f)&serial_port_write;
-    input_ltm->ltm->io->read = (io_read_f)&serial_port_read;
-    input_ltm->ltm->io->flags = (io_flags_f)&serial_port_io_flags;
-    input_ltm->ltm->io->data = input_ltm->serial_port;
-
-    input_ltm->ltm->home_source = input_ltm->input.home_source;
+    input_ltm->ltm.home_source = input_ltm->input.home_source;
+    input_ltm->ltm.source = input_ltm->input.source;
 
     return true;
 }
@@ -25,7 +25,7 @@ typedef struct input_ltm_s
     time_micros_t enable_rx_deadline;
     hal_gpio_t rx;
     hal_gpio_t tx;
-    ltm_t *ltm;
+    ltm_t ltm;
     bool inverted;
     time_micros_t next_inversion_switch;
 } input_ltm_t;
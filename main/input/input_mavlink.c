@@ -1,6 +1,7 @@
 
 #include <hal/log.h>
 #include "input/input_mavlink.h"
+#include "protocols/mavlink_router.h"
 
 static const char *TAG = "Input.Mavlink";
 
@@ -12,10 +13,11 @@ static bool input_mavlink_update(void *input, void *data, time_micros_t now)
     input_mavlink_t *input_mavlink = input;
 
     bool updated = false;
-    int ret = mavlink_update(input_mavlink->mavlink, data);
+    int ret = mavlink_update(&input_mavlink->mavlink, data);
     if (ret == 2)
     {
         input_mavlink->last_frame_recv = now;
+        updated = true;
     }
 
     return updated;
@@ -24,9 +26,14 @@ static bool input_mavlink_update(void *input, void *data, time_micros_t now)
 static void input_mavlink_close(void *input, void *config)
 {
     input_mavlink_t *input_mavlink = input;
+    mavlink_link_e link = mavlink_router_link_from_source(input_mavlink->input.source);
+    if (link != MAVLINK_LINK_NONE)
+    {
+        // Stop forwarding before the port goes away
+        mavlink_router_set_link(link, NULL, NULL);
+    }
     serial_port_destroy(&input_mavlink->serial_port);
-    mavlink_destroy(input_mavlink->mavlink);
-    free(input_mavlink->mavlink);
+    mavlink_destroy(&input_mavlink->mavlink);
 }
 
 static bool input_mavlink_open(void *input, void *config)
@@ -43,7 +50,8 @@ static bool input_mavlink_open(void *input, void *config)
         .baud_rate = config_mavlink->baudrate,
         .tx_pin = config_mavlink->tx,
         .rx_pin = config_mavlink->rx,
-        .tx_buffer_size = MAVLINK_FRAME_SIZE_MAX,
+        // Also carries the frames forwarded from the other links
+        .tx_buffer_size = MAVLINK_FRAME_SIZE_MAX * 4,
         .rx_buffer_size = MAVLINK_FRAME_SIZE_MAX * 4,
         .parity = SERIAL_PARITY_DISABLE,
         .stop_bits = SERIAL_STOP_BITS_1,
@@ -53,16 +61,18 @@ static bool input_mavlink_open(void *input, void *config)
     input_mavlink->serial_port = serial_port_open(&serial_config);
     LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", config_mavlink->baudrate, gpio_toa(config_mavlink->tx), gpio_toa(config_mavlink->rx));
 
-    input_mavlink->mavlink = (mavlink_t *)malloc(sizeof(mavlink_t));
+    mavlink_init(&input_mavlink->mavlink);
 
-    mavlink_init(input_mavlink->mavlink);
+    input_mavlink->mavlink.io = SERIAL_IO(input_mavlink->serial_port);
 
-    input_mavlink->mavlink->io->write = (io_write_f)&serial_port_write;
-    input_mavlink->mavlink->io->read = (io_read_f)&serial_port_read;
-    input_mavlink->mavlink->io->flags = (io_flags_f)&serial_port_io_flags;
+    input_mavlink->mavlink.home_source = input_mavlink->input.home_source;
+    input_mavlink->mavlink.source = input_mavlink->input.source;
 
-    input_mavlink->mavlink->io->data = input_mavlink->serial_port;
-    input_mavlink->mavlink->home_source = input_mavlink->input.home_source;
+    mavlink_link_e link = mavlink_router_link_from_source(input_mavlink->input.source);
+    if (link != MAVLINK_LINK_NONE)
+    {
+        mavlink_router_set_link(link, (io_write_f)serial_port_write, input_mavlink->serial_port);
+    }
 
     return true;
 }
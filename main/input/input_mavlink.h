@@ -25,7 +25,7 @@ typedef struct input_mavlink_s
     time_micros_t enable_rx_deadline;
     hal_gpio_t rx;
     hal_gpio_t tx;
-    mavlink_t *mavlink;
+    mavlink_t mavlink;
     bool inverted;
     time_micros_t next_inversion_switch;
 } input_mavlink_t;
@@ -25,7 +25,7 @@ typedef struct input_nmea_s
     time_micros_t enable_rx_deadline;
     hal_gpio_t rx;
     hal_gpio_t tx;
-    nmea_t *nmea;
+    nmea_t nmea;
     bool inverted;
     time_micros_t next_inversion_switch;
 } input_nmea_t;
@@ -0,0 +1,75 @@
+#include <hal/log.h>
+#include "input/input_smartport.h"
+
+static const char *TAG = "Input.SmartPort";
+
+static bool input_smartport_update(void *input, void *data, time_micros_t now)
+{
+    input_smartport_t *input_smartport = input;
+
+    bool updated = false;
+
+    int ret = smartport_update(&input_smartport->smartport, data);
+    if (ret == 2)
+    {
+        input_smartport->last_frame_recv = now;
+        updated = true;
+    }
+
+    return updated;
+}
+
+static void input_smartport_close(void *input, void *config)
+{
+    input_smartport_t *input_smartport = input;
+    serial_port_destroy(&input_smartport->serial_port);
+    smartport_destroy(&input_smartport->smartport);
+}
+
+static bool input_smartport_open(void *input, void *config)
+{
+    input_smartport_config_t *config_smartport = config;
+    input_smartport_t *input_smartport = input;
+    time_micros_t now = time_micros_now();
+
+    // SmartPort is an inverted single wire bus, listen on the RX pin
+    // in half duplex mode.
+    input_smartport->inverted = true;
+    input_smartport->last_frame_recv = now;
+    input_smartport->enable_rx_deadline = TIME_MICROS_MAX;
+    input_smartport->rx = config_smartport->rx;
+    input_smartport->tx = config_smartport->rx;
+
+    serial_port_config_t serial_config = {
+        .baud_rate = config_smartport->baudrate,
+        .tx_pin = input_smartport->tx,
+        .rx_pin = input_smartport->rx,
+        .tx_buffer_size = SMARTPORT_BUFFER_SIZE,
+        .rx_buffer_size = SMARTPORT_BUFFER_SIZE * 2,
+        .parity = SERIAL_PARITY_DISABLE,
+        .stop_bits = SERIAL_STOP_BITS_1,
+        .inverted = input_smartport->inverted,
+    };
+
+    input_smartport->serial_port = serial_port_open(&serial_config);
+    LOG_I(TAG, "Open with Baudrate: %d, Half duplex: %s, Inverted: %d", config_smartport->baudrate, gpio_toa(input_smartport->rx), input_smartport->inverted);
+
+    smartport_init(&input_smartport->smartport);
+
+    input_smartport->smartport.io = SERIAL_IO(input_smartport->serial_port);
+
+    input_smartport->smartport.home_source = input_smartport->input.home_source;
+    input_smartport->smartport.source = input_smartport->input.source;
+
+    return true;
+}
+
+void input_smartport_init(input_smartport_t *input)
+{
+    input->serial_port = NULL;
+    input->input.vtable = (input_vtable_t){
+        .open = input_smartport_open,
+        .update = input_smartport_update,
+        .close = input_smartport_close,
+    };
+}
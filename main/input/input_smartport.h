@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input/input.h"
+
+#include "io/gpio.h"
+#include "io/serial.h"
+
+#include "protocols/smartport.h"
+
+typedef struct input_smartport_config_s
+{
+    int baudrate;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+} input_smartport_config_t;
+
+typedef struct input_smartport_s
+{
+    input_t input;
+    serial_port_t *serial_port;
+    time_micros_t last_frame_recv;
+    time_micros_t enable_rx_deadline;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+    smartport_t smartport;
+    bool inverted;
+    time_micros_t next_inversion_switch;
+} input_smartport_t;
+
+void input_smartport_init(input_smartport_t *input);
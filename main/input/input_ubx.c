@@ -0,0 +1,108 @@
+#include <hal/log.h>
+#include "input/input_ubx.h"
+
+static const char *TAG = "Input.Ubx";
+
+static void input_ubx_configure(input_ubx_t *input_ubx, time_micros_t now)
+{
+    switch (input_ubx->config_step)
+    {
+    case INPUT_UBX_CONFIG_BAUDRATE:
+        // The receiver might still be at the port baudrate, ask it to
+        // switch and wait until the request has been sent out.
+        serial_port_set_baudrate(input_ubx->serial_port, input_ubx->baudrate);
+        ubx_configure_baudrate(&input_ubx->ubx, UBX_BAUDRATE);
+        input_ubx->next_config_step = now + (MICROS_PER_SEC * 10 * 64ull) / input_ubx->baudrate + MILLIS_TO_MICROS(20);
+        input_ubx->config_step = INPUT_UBX_CONFIG_MESSAGES;
+        break;
+    case INPUT_UBX_CONFIG_MESSAGES:
+        if (now < input_ubx->next_config_step)
+        {
+            break;
+        }
+        serial_port_set_baudrate(input_ubx->serial_port, UBX_BAUDRATE);
+        ubx_configure_nav_pvt(&input_ubx->ubx, UBX_NAV_RATE_MS);
+        input_ubx->last_frame_recv = now;
+        input_ubx->config_step = INPUT_UBX_RUNNING;
+        break;
+    case INPUT_UBX_RUNNING:
+        if (now - input_ubx->last_frame_recv > MILLIS_TO_MICROS(INPUT_UBX_CONFIG_TIMEOUT_MS))
+        {
+            LOG_I(TAG, "No NAV-PVT received, reconfigure receiver");
+            input_ubx->config_step = INPUT_UBX_CONFIG_BAUDRATE;
+        }
+        break;
+    }
+}
+
+static bool input_ubx_update(void *input, void *data, time_micros_t now)
+{
+    input_ubx_t *input_ubx = input;
+
+    bool updated = false;
+
+    input_ubx_configure(input_ubx, now);
+
+    int ret = ubx_update(&input_ubx->ubx, data);
+    if (ret == 2)
+    {
+        input_ubx->last_frame_recv = now;
+        updated = true;
+    }
+
+    return updated;
+}
+
+static void input_ubx_close(void *input, void *config)
+{
+    input_ubx_t *input_ubx = input;
+    serial_port_destroy(&input_ubx->serial_port);
+    ubx_destroy(&input_ubx->ubx);
+}
+
+static bool input_ubx_open(void *input, void *config)
+{
+    input_ubx_config_t *config_ubx = config;
+    input_ubx_t *input_ubx = input;
+    time_micros_t now = time_micros_now();
+
+    input_ubx->inverted = false;
+    input_ubx->last_frame_recv = now;
+    input_ubx->enable_rx_deadline = TIME_MICROS_MAX;
+    input_ubx->baudrate = config_ubx->baudrate;
+    input_ubx->config_step = INPUT_UBX_CONFIG_BAUDRATE;
+    input_ubx->next_config_step = now;
+
+    serial_port_config_t serial_config = {
+        .baud_rate = config_ubx->baudrate,
+        .tx_pin = config_ubx->tx,
+        .rx_pin = config_ubx->rx,
+        .tx_buffer_size = UBX_BUFFER_SIZE * 2,
+        .rx_buffer_size = UBX_BUFFER_SIZE * 4,
+        .parity = SERIAL_PARITY_DISABLE,
+        .stop_bits = SERIAL_STOP_BITS_1,
+        .inverted = input_ubx->inverted,
+    };
+
+    input_ubx->serial_port = serial_port_open(&serial_config);
+    LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", config_ubx->baudrate, gpio_toa(config_ubx->tx), gpio_toa(config_ubx->rx));
+
+    ubx_init(&input_ubx->ubx);
+
+    input_ubx->ubx.io = SERIAL_IO(input_ubx->serial_port);
+
+    input_ubx->ubx.home_source = input_ubx->input.home_source;
+    input_ubx->ubx.source = input_ubx->input.source;
+
+    return true;
+}
+
+void input_ubx_init(input_ubx_t *input)
+{
+    input->serial_port = NULL;
+    input->input.vtable = (input_vtable_t){
+        .open = input_ubx_open,
+        .update = input_ubx_update,
+        .close = input_ubx_close,
+    };
+}
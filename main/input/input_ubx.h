@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input/input.h"
+
+#include "io/gpio.h"
+#include "io/serial.h"
+
+#include "protocols/ubx.h"
+
+// Reconfigure the receiver if no NAV-PVT arrives for this long
+#define INPUT_UBX_CONFIG_TIMEOUT_MS 3000
+
+typedef enum
+{
+    INPUT_UBX_CONFIG_BAUDRATE,
+    INPUT_UBX_CONFIG_MESSAGES,
+    INPUT_UBX_RUNNING,
+} input_ubx_config_step_e;
+
+typedef struct input_ubx_config_s
+{
+    int baudrate;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+} input_ubx_config_t;
+
+typedef struct input_ubx_s
+{
+    input_t input;
+    serial_port_t *serial_port;
+    time_micros_t last_frame_recv;
+    time_micros_t enable_rx_deadline;
+    hal_gpio_t rx;
+    hal_gpio_t tx;
+    ubx_t ubx;
+    bool inverted;
+    time_micros_t next_inversion_switch;
+    int baudrate;
+    input_ubx_config_step_e config_step;
+    time_micros_t next_config_step;
+} input_ubx_t;
+
+void input_ubx_init(input_ubx_t *input);
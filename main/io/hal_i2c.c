@@ -31,4 +31,75 @@ void hal_i2c_cmd_take(hal_i2c_bus_t i2c_bus)
 void hal_i2c_cmd_give(hal_i2c_bus_t i2c_bus)
 {
     xSemaphoreGive(_mutexs[i2c_bus]);
+}
+
+hal_err_t hal_i2c_write(hal_i2c_bus_t i2c_bus, uint8_t addr, uint8_t *data, size_t size)
+{
+    hal_i2c_cmd_t cmd;
+    hal_err_t err;
+
+    if ((err = hal_i2c_cmd_init(&cmd)) != HAL_ERR_NONE)
+    {
+        return err;
+    }
+
+    if ((err = hal_i2c_cmd_master_start(&cmd)) == HAL_ERR_NONE &&
+        (err = hal_i2c_cmd_master_write_byte(&cmd, HAL_I2C_WRITE_ADDR(addr), ACK_CHECK_EN)) == HAL_ERR_NONE &&
+        (err = hal_i2c_cmd_master_write(&cmd, data, size, ACK_CHECK_EN)) == HAL_ERR_NONE &&
+        (err = hal_i2c_cmd_master_stop(&cmd)) == HAL_ERR_NONE)
+    {
+        err = hal_i2c_cmd_master_exec(i2c_bus, &cmd);
+    }
+
+    hal_i2c_cmd_destroy(&cmd);
+    return err;
+}
+
+static hal_err_t hal_i2c_cmd_build_write_then_read(hal_i2c_cmd_t *cmd, uint8_t addr, uint8_t *wdata, size_t wsize, uint8_t *rdata, size_t rsize)
+{
+    hal_err_t err;
+
+    if ((err = hal_i2c_cmd_master_start(cmd)) != HAL_ERR_NONE ||
+        (err = hal_i2c_cmd_master_write_byte(cmd, HAL_I2C_WRITE_ADDR(addr), ACK_CHECK_EN)) != HAL_ERR_NONE ||
+        (err = hal_i2c_cmd_master_write(cmd, wdata, wsize, ACK_CHECK_EN)) != HAL_ERR_NONE ||
+        // Repeated start, the bus isn't released between the write and the read
+        (err = hal_i2c_cmd_master_start(cmd)) != HAL_ERR_NONE ||
+        (err = hal_i2c_cmd_master_write_byte(cmd, HAL_I2C_READ_ADDR(addr), ACK_CHECK_EN)) != HAL_ERR_NONE)
+    {
+        return err;
+    }
+
+    if (rsize > 1 && (err = hal_i2c_cmd_master_read(cmd, rdata, rsize - 1, ACK_VAL)) != HAL_ERR_NONE)
+    {
+        return err;
+    }
+
+    if ((err = hal_i2c_cmd_master_read_byte(cmd, &rdata[rsize - 1], NACK_VAL)) != HAL_ERR_NONE)
+    {
+        return err;
+    }
+
+    return hal_i2c_cmd_master_stop(cmd);
+}
+
+// The command link is built for every transaction: i2c_master_cmd_begin() in
+// esp-idf v3.x consumes the link while running it (byte_num and data advance),
+// so a link can't be executed twice.
+hal_err_t hal_i2c_write_then_read(hal_i2c_bus_t i2c_bus, uint8_t addr, uint8_t *wdata, size_t wsize, uint8_t *rdata, size_t rsize)
+{
+    hal_i2c_cmd_t cmd;
+    hal_err_t err;
+
+    if ((err = hal_i2c_cmd_init(&cmd)) != HAL_ERR_NONE)
+    {
+        return err;
+    }
+
+    if ((err = hal_i2c_cmd_build_write_then_read(&cmd, addr, wdata, wsize, rdata, rsize)) == HAL_ERR_NONE)
+    {
+        err = hal_i2c_cmd_master_exec(i2c_bus, &cmd);
+    }
+
+    hal_i2c_cmd_destroy(&cmd);
+    return err;
 }
\ No newline at end of file
@@ -22,4 +22,10 @@ typedef struct hal_i2c_config_s
 void hal_i2c_init(hal_i2c_config_t *cfg);
 void hal_i2c_deinit(hal_i2c_config_t *cfg);
 void hal_i2c_cmd_take(hal_i2c_bus_t i2c_bus);
-void hal_i2c_cmd_give(hal_i2c_bus_t i2c_bus);
\ No newline at end of file
+void hal_i2c_cmd_give(hal_i2c_bus_t i2c_bus);
+
+// Writes data in a single transaction. Doesn't take the bus mutex.
+hal_err_t hal_i2c_write(hal_i2c_bus_t i2c_bus, uint8_t addr, uint8_t *data, size_t size);
+// Writes wdata and reads rdata back after a repeated start, as a single transaction.
+// Doesn't take the bus mutex.
+hal_err_t hal_i2c_write_then_read(hal_i2c_bus_t i2c_bus, uint8_t addr, uint8_t *wdata, size_t wsize, uint8_t *rdata, size_t rsize);
\ No newline at end of file
@@ -22,6 +22,7 @@
 #include "tracker/tracker.h"
 #include "tracker/servo.h"
 #include "protocols/atp.h"
+#include "protocols/mavlink_router.h"
 
 #include "util/time.h"
 #include "util/macros.h"
@@ -50,6 +51,8 @@ static void setting_changed(const setting_t *setting, void *user_data)
 
 void iats_tracker_init(void)
 {
+	// Inputs register their links while the tracker configures them
+	mavlink_router_init();
 	tracker_init(&tracker);
 }
 
@@ -104,6 +107,7 @@ void iats_wifi_init(void)
 	wifi.t = tracker.atp;
 	wifi.callback = tracker.atp->atp_decode;
 	tracker.atp->atp_send = wifi.send;
+	tracker.atp->atp_flush = wifi.flush;
 }
 #endif
 
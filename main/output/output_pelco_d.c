@@ -9,7 +9,7 @@ static bool output_pelco_d_update(void *output, void *data, time_micros_t now)
     output_pelco_d_t *output_pelco_d = output;
 
     bool updated = false;
-    int ret = pelco_d_update(output_pelco_d->pelco_d, data);
+    int ret = pelco_d_update(&output_pelco_d->pelco_d, data);
     
     if (ret == 2)
     {
@@ -24,8 +24,7 @@ static void output_pelco_d_close(void *output, void *config)
 {
     output_pelco_d_t *output_pelco_d = output;
     serial_port_destroy(&output_pelco_d->serial_port);
-    pelco_d_destroy(output_pelco_d->pelco_d);
-    free(output_pelco_d->pelco_d);
+    pelco_d_destroy(&output_pelco_d->pelco_d);
 }
 
 static bool output_pelco_d_open(void *output, void *config)
@@ -52,14 +51,9 @@ static bool output_pelco_d_open(void *output, void *config)
     output_pelco_d->serial_port = serial_port_open(&serial_config);
     LOG_I(TAG, "Open with Baudrate: %d, TX: %s, RX: %s", config_pelco_d->baudrate, gpio_toa(config_pelco_d->tx), gpio_toa(config_pelco_d->rx));
 
-    output_pelco_d->pelco_d = (pelco_d_t *)malloc(sizeof(pelco_d_t));
+    pelco_d_init(&output_pelco_d->pelco_d);
 
-    pelco_d_init(output_pelco_d->pelco_d);
-
-    output_pelco_d->pelco_d->io->write = (io_write_f)&serial_port_write;
-    output_pelco_d->pelco_d->io->read = (io_read_f)&serial_port_read;
-    output_pelco_d->pelco_d->io->flags = (io_flags_f)&serial_port_io_flags;
-    output_pelco_d->pelco_d->io->data = output_pelco_d->serial_port;
+    output_pelco_d->pelco_d.io = SERIAL_IO(output_pelco_d->serial_port);
 
     return true;
 }
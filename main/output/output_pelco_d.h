@@ -25,7 +25,7 @@ typedef struct output_pelco_d_s
     time_micros_t enable_rx_deadline;
     hal_gpio_t rx;
     hal_gpio_t tx;
-    pelco_d_t *pelco_d;
+    pelco_d_t pelco_d;
     bool inverted;
     time_micros_t next_inversion_switch;
 } output_pelco_d_t;
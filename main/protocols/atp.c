@@ -3,6 +3,7 @@
 #include "atp.h"
 #include "tracker/observer.h"
 #include "config/settings.h"
+#include "util/macros.h"
 
 static const char *TAG = "Protocol.Atp";
 static telemetry_t plane_vals[TAG_PLANE_COUNT];
@@ -11,7 +12,12 @@ static telemetry_t param_vals[TAG_PARAM_COUNT];
 // static telemetry_t iats_pro_param_vals[TAG_PARAM_IATS_PRO_COUNT];
 static atp_cmd_t atp_cmd;
 static atp_ctr_t atp_ctr;
+static atp_frame_t dec_frame;
+static atp_frame_t enc_frame;
 static atp_t *atp;
+// Last plane altitude received over ATP, frames don't always carry it
+static int32_t atp_plane_altitude;
+static bool atp_plane_selected;
 
 typedef union
 {
@@ -312,58 +318,117 @@ static void atp_cmd_heartbeat(atp_frame_t *frame)
     }
 }
 
+// Reports the frame's position to the arbiter, leaving buffer_index as it was
+static void atp_cmd_airplane_fix(atp_frame_t *frame, time_micros_t now)
+{
+    uint8_t start = frame->buffer_index;
+    position_fix_t fix = {
+        .altitude = atp_plane_altitude,
+        .accuracy = ARBITER_ACCURACY_UNKNOWN_CM,
+        .time = now,
+    };
+    uint8_t position = 0;
+
+    while (frame->buffer_index < frame->atp_tag_len + 5)
+    {
+        uint8_t tag = frame->buffer[frame->buffer_index++];
+        uint8_t size = frame->buffer[frame->buffer_index++];
+
+        switch (tag)
+        {
+        case TAG_PLANE_LONGITUDE:   //plane's longitude L:4
+            fix.longitude = (int32_t)tagread_u32(frame);
+            position |= 1 << 0;
+            break;
+        case TAG_PLANE_LATITUDE:    //plane's latitude L:4
+            fix.latitude = (int32_t)tagread_u32(frame);
+            position |= 1 << 1;
+            break;
+        case TAG_PLANE_ALTITUDE:    //plane's altitude L:4
+            fix.altitude = atp_plane_altitude = (int32_t)tagread_u32(frame);
+            break;
+        default:
+            // A bad size mustn't wrap the index around
+            frame->buffer_index = MIN(frame->buffer_index + size, frame->atp_tag_len + 5);
+            break;
+        }
+    }
+
+    if (position == ((1 << 0) | (1 << 1)))
+    {
+        atp_plane_selected = atp->plane_fix(atp->tracker, PROTOCOL_IO_ATP, &fix);
+    }
+
+    frame->buffer_index = start;
+}
+
 static void atp_cmd_airplane(atp_frame_t *frame)
 {
     time_micros_t now = time_micros_now();
 
+    // Selected with this frame's position, so the first frame after a
+    // source switch already publishes the rest of its tags
+    atp_cmd_airplane_fix(frame, now);
+
     while (frame->buffer_index < frame->atp_tag_len + 5)
     {
         switch (frame->buffer[frame->buffer_index++])
         {
         case TAG_PLANE_LONGITUDE:   //plane's longitude L:4
-            frame->buffer_index++;
-            ATP_SET_I32(TAG_PLANE_LONGITUDE, (int32_t)tagread_u32(frame), now);
-            atp->tag_value_changed(atp->tracker, TAG_PLANE_LONGITUDE);
-            // printf("TAG_PLANE_LONGITUDE:%d\n", telemetry_get_i32(atp_get_telemetry_tag_val(TAG_PLANE_LONGITUDE)));
-            break;
         case TAG_PLANE_LATITUDE:    //plane's latitude L:4
-            frame->buffer_index++;
-            ATP_SET_I32(TAG_PLANE_LATITUDE, (int32_t)tagread_u32(frame), now);
-            atp->tag_value_changed(atp->tracker, TAG_PLANE_LATITUDE);
-            // printf("TAG_PLANE_LATITUDE:%d\n", telemetry_get_i32(atp_get_telemetry_tag_val(TAG_PLANE_LATITUDE)));
-            break;
         case TAG_PLANE_ALTITUDE:    //plane's altitude L:4
-            frame->buffer_index++;
-            ATP_SET_I32(TAG_PLANE_ALTITUDE, (int32_t)tagread_u32(frame), now);
+            // Already read by atp_cmd_airplane_fix()
+            frame->buffer_index += 1 + 4;
             break;
         case TAG_PLANE_SPEED:       //plane's speed L:2
+        {
             frame->buffer_index++;
-            ATP_SET_I16(TAG_PLANE_SPEED, (int16_t)tagread_u16(frame), now);
+            int16_t speed = (int16_t)tagread_u16(frame);
+            if (atp_plane_selected) ATP_SET_I16(TAG_PLANE_SPEED, speed, now);
             break;
+        }
         case TAG_PLANE_DISTANCE:    //plane's distance L:4
+        {
             frame->buffer_index++;
-            ATP_SET_U32(TAG_PLANE_DISTANCE, tagread_u32(frame), now);
+            uint32_t distance = tagread_u32(frame);
+            if (atp_plane_selected) ATP_SET_U32(TAG_PLANE_DISTANCE, distance, now);
             break;
+        }
         case TAG_PLANE_STAR:        //plane's star numbers L:1
+        {
             frame->buffer_index++;
-            ATP_SET_U8(TAG_PLANE_STAR, tagread_u8(frame), now);
+            uint8_t star = tagread_u8(frame);
+            if (atp_plane_selected) ATP_SET_U8(TAG_PLANE_STAR, star, now);
             break;
+        }
         case TAG_PLANE_FIX:         //plane's fix type L:1
+        {
             frame->buffer_index++;
-            ATP_SET_U8(TAG_PLANE_FIX, tagread_u8(frame), now);
+            uint8_t fix_type = tagread_u8(frame);
+            if (atp_plane_selected) ATP_SET_U8(TAG_PLANE_FIX, fix_type, now);
             break;
+        }
         case TAG_PLANE_PITCH:       //plane's pitch L:2
+        {
             frame->buffer_index++;
-            ATP_SET_I16(TAG_PLANE_PITCH, (int16_t)tagread_u16(frame), now);
+            int16_t pitch = (int16_t)tagread_u16(frame);
+            if (atp_plane_selected) ATP_SET_I16(TAG_PLANE_PITCH, pitch, now);
             break;
+        }
         case TAG_PLANE_ROLL:        //plane's roll L:2
+        {
             frame->buffer_index++;
-            ATP_SET_I16(TAG_PLANE_ROLL, (int16_t)tagread_u16(frame), now);
+            int16_t roll = (int16_t)tagread_u16(frame);
+            if (atp_plane_selected) ATP_SET_I16(TAG_PLANE_ROLL, roll, now);
             break;
+        }
         case TAG_PLANE_HEADING:     //plane's heading L:2
+        {
             frame->buffer_index++;
-            ATP_SET_U16(TAG_PLANE_HEADING, tagread_u16(frame), now);
+            uint16_t heading = tagread_u16(frame);
+            if (atp_plane_selected) ATP_SET_U16(TAG_PLANE_HEADING, heading, now);
             break;
+        }
         default:
             frame->buffer_index++;
             break;
@@ -872,8 +937,8 @@ void atp_init(atp_t *t)
     // t->iats_pro_param_vals = (telemetry_t *)&iats_pro_param_vals;
     t->atp_cmd = &atp_cmd;
     t->atp_ctr = &atp_ctr;
-    t->dec_frame = (atp_frame_t *)malloc(sizeof(atp_frame_t));
-    t->enc_frame = (atp_frame_t *)malloc(sizeof(atp_frame_t));
+    t->dec_frame = &dec_frame;
+    t->enc_frame = &enc_frame;
 
     for(int i = 0; i < TAG_PLANE_COUNT + TAG_TRACKER_COUNT + TAG_PARAM_COUNT; i++)
     {
@@ -920,18 +985,15 @@ telemetry_t *atp_get_telemetry_tag_val(uint8_t tag)
 
 uint8_t atp_popup_cmd()
 {
-    int index = 0;
-    uint8_t ret = atp_cmd.cmds[index];
-    uint8_t cmd = ret;
+    uint8_t ret = atp_cmd.cmds[0];
 
-    while (cmd == 0 && index < 4)
+    // Shift the rest down so queued commands keep their order
+    for (int index = 0; index < ARRAY_COUNT(atp_cmd.cmds) - 1; index++)
     {
         atp_cmd.cmds[index] = atp_cmd.cmds[index + 1];
-        index++;
-        cmd = atp_cmd.cmds[index];
     }
 
-    atp_cmd.cmds[index] = 0;  
+    atp_cmd.cmds[ARRAY_COUNT(atp_cmd.cmds) - 1] = 0;
 
     return ret;  
 }
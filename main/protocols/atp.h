@@ -6,6 +6,7 @@
 #include "util/time.h"
 #include "util/data_state.h"
 #include "tracker/telemetry.h"
+#include "tracker/arbiter.h"
 
 #define MAX_TAG_COUNT							   10        //每帧数据最大TAG数
 #define MAX_CMD_COUNT							   5         //最大缓存等待发送的指令数
@@ -170,7 +171,9 @@ typedef struct atp_frame_s
 
 typedef void (*pTr_atp_decode)(void *t, void *buffer, int offset, int len);
 typedef void (*pTr_atp_send)(void *buffer, int len);
+typedef void (*pTr_atp_flush)(void);
 typedef void (*pTr_tag_value_changed)(void *t, uint8_t tag);
+typedef bool (*pTr_plane_fix)(void *t, uint8_t source, const position_fix_t *fix);
 
 typedef struct atp_cmd_s
 {
@@ -190,7 +193,10 @@ typedef struct atp_s
 {
     pTr_atp_decode atp_decode;
     pTr_atp_send atp_send;
+    // Sends the frames passed to atp_send since the last flush
+    pTr_atp_flush atp_flush;
     pTr_tag_value_changed tag_value_changed;
+    pTr_plane_fix plane_fix;
     void *tracker;
 
     atp_frame_t *dec_frame;
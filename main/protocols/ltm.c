@@ -15,7 +15,6 @@ void ltm_init(ltm_t *ltm)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
-    ltm->io = (io_t *)malloc(sizeof(io_t));
     ltm->buf_pos = 0;
     ltm->status = LTM_IDLE;
     ltm->gframe = &gframe;
@@ -33,7 +32,7 @@ void ltm_init(ltm_t *ltm)
 int ltm_update(ltm_t *ltm, void *data)
 {
     int rem = sizeof(ltm->buf)  - ltm->buf_pos;
-    int n = io_read(ltm->io, &ltm->buf[ltm->buf_pos], rem, 0);
+    int n = io_read(&ltm->io, &ltm->buf[ltm->buf_pos], rem, 0);
 
     uint8_t ret = 0;
 
@@ -59,13 +58,26 @@ int ltm_update(ltm_t *ltm, void *data)
             switch (ltm->function)
             {
                 case LTM_GFRAME:
-                    ATP_SET_I32(TAG_PLANE_LONGITUDE,  ltm->gframe->longitude, now);
-                    ATP_SET_I32(TAG_PLANE_LATITUDE, ltm->gframe->latitude, now);
-                    ATP_SET_I32(TAG_PLANE_ALTITUDE, ltm->gframe->altitude, now);
-                    ATP_SET_I16(TAG_PLANE_STAR, (int16_t)(ltm->gframe->sats >> 2) & 0xFF, now);
-                    ATP_SET_U8(TAG_PLANE_FIX, (uint8_t)(ltm->gframe->sats & 0b00000011), now);
-                    atp->tag_value_changed(atp->tracker, TAG_PLANE_LATITUDE);
-                    atp->tag_value_changed(atp->tracker, TAG_PLANE_LONGITUDE);
+                {
+                    uint8_t fix_type = (uint8_t)(ltm->gframe->sats & 0b00000011);
+                    if (fix_type == 0)
+                    {
+                        break;
+                    }
+
+                    position_fix_t fix = {
+                        .latitude = ltm->gframe->latitude,
+                        .longitude = ltm->gframe->longitude,
+                        .altitude = ltm->gframe->altitude,
+                        .accuracy = ARBITER_ACCURACY_UNKNOWN_CM,
+                        .time = now,
+                    };
+
+                    if (atp->plane_fix(atp->tracker, ltm->source, &fix))
+                    {
+                        ATP_SET_I16(TAG_PLANE_STAR, (int16_t)(ltm->gframe->sats >> 2) & 0xFF, now);
+                        ATP_SET_U8(TAG_PLANE_FIX, fix_type, now);
+                    }
 
                     // LOG_I(TAG, "ALT: %d", ltm->gframe->altitude);
                     // LOG_I(TAG, "GS: %d", ltm->gframe->ground_speed);
@@ -73,6 +85,7 @@ int ltm_update(ltm_t *ltm, void *data)
                     // LOG_I(TAG, "Fix: %d", (uint8_t)(ltm->gframe->sats & 0b00000011));
                     // LOG_I(TAG, "SIZE OF: %d", sizeof(ltm_gframe_t));
                     break;
+                }
             }
 
             break;
@@ -197,5 +210,4 @@ bool ltm_decode(ltm_t *ltm, uint8_t c)
 
 void ltm_destroy(ltm_t *ltm)
 {
-    free(ltm->io);
 }
\ No newline at end of file
@@ -92,8 +92,9 @@ typedef struct ltm_xframe_s
 typedef struct ltm_s
 {
     telemetry_t *plane_vals;
-    io_t *io;
+    io_t io;
     bool home_source;
+    uint8_t source;
 
     uint8_t buf[LTM_BUFFER_SIZE * 2];
     uint8_t payload[LTM_MAX_PAYLOAD_SIZE];
@@ -3,9 +3,12 @@
 #include <hal/log.h>
 #include "../components/c_library_v2/common/mavlink.h"
 #include "atp.h"
+#include "mavlink_router.h"
 
 static mavlink_status_t mavlink_status;
 static mavlink_message_t mavlink_message;
+static mavlink_global_position_int_t mavlink_global_position;
+static mavlink_home_position_t mavlink_home_position;
 
 static const char *TAG = "Protocol.Mavlink";
 
@@ -13,28 +16,78 @@ void mavlink_init(mavlink_t *mavlink)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
-    mavlink->io = (io_t *)malloc(sizeof(io_t));;
     mavlink->buf_pos = 0;
+    mavlink->parse_pos = 0;
+    mavlink->frame_start = -1;
     mavlink->status = &mavlink_status;
     mavlink->message = &mavlink_message;
 
-    mavlink->message_value.global_position = (mavlink_global_position_int_t *)malloc(sizeof(mavlink_global_position_int_t));
-    mavlink->message_value.home_position = (mavlink_home_position_t *)malloc(sizeof(mavlink_home_position_t));
+    mavlink->message_value.global_position = &mavlink_global_position;
+    mavlink->message_value.home_position = &mavlink_home_position;
 
     memset(&mavlink->buf, 0, sizeof(mavlink->buf));
 
     LOG_I(TAG, "Initialized");
 }
 
+static void mavlink_handle_message(mavlink_t *mavlink, atp_t *atp)
+{
+    LOG_D(TAG, "Received message with ID [%d], sequence: [%d] from component [%d] of system [%d]", mavlink->message->msgid, mavlink->message->seq, mavlink->message->compid, mavlink->message->sysid);
+
+    mavlink->counter++;
+
+    if (mavlink->message->seq == 0xff)
+    {
+        mavlink->link_quality = mavlink->counter / 255.0f;
+        mavlink->counter = 0;
+        LOG_I(TAG, "link_quality: [%.2f] ", mavlink->link_quality);
+    }
+
+    time_micros_t now = time_micros_now();
+
+    switch(mavlink->message->msgid) 
+    {
+    case MAVLINK_MSG_ID_GLOBAL_POSITION_INT: // ID for GLOBAL_POSITION_INT
+    {
+        // Get all fields in payload (into global_position)
+        mavlink_msg_global_position_int_decode(mavlink->message, mavlink->message_value.global_position);
+        position_fix_t fix = {
+            .latitude = mavlink->message_value.global_position->lat,
+            .longitude = mavlink->message_value.global_position->lon,
+            .altitude = mavlink->message_value.global_position->alt / 10,
+            .accuracy = ARBITER_ACCURACY_UNKNOWN_CM,
+            .time = now,
+        };
+        atp->plane_fix(atp->tracker, mavlink->source, &fix);
+        break;
+    }
+    case MAVLINK_MSG_ID_HOME_POSITION:
+        mavlink_msg_home_position_decode(mavlink->message, mavlink->message_value.home_position);
+        ATP_SET_I32(TAG_TRACKER_LONGITUDE,  mavlink->message_value.home_position->longitude, now);
+        ATP_SET_I32(TAG_TRACKER_LATITUDE,  mavlink->message_value.home_position->latitude, now);
+        ATP_SET_I32(TAG_TRACKER_ALTITUDE,  mavlink->message_value.home_position->altitude / 10, now);
+        atp->tag_value_changed(atp->tracker, TAG_TRACKER_LONGITUDE);
+        atp->tag_value_changed(atp->tracker, TAG_TRACKER_LATITUDE);
+        atp->tag_value_changed(atp->tracker, TAG_TRACKER_ALTITUDE);
+        break;
+    case MAVLINK_MSG_ID_GPS_RAW_INT:
+        //mavlink_msg_gps_raw_int_decode(mavlink->message, mavlink->message_value.gps_raw);
+        //ATP_SET_I16(TAG_PLANE_SPEED,  (uint16_t)(mavlink->message_value.gps_raw->vel / 100), now);
+        break;
+    }
+}
+
 int mavlink_update(mavlink_t *mavlink, void *data)
 {
-    int chan = MAVLINK_COMM_0;
-    int rem = sizeof(mavlink->buf)  - mavlink->buf_pos;
-    int n = io_read(mavlink->io, &mavlink->buf[mavlink->buf_pos], rem, 0);
+    mavlink_link_e link = mavlink_router_link_from_source(mavlink->source);
+    // Own channel per link, so both UARTs can run MAVLink at the same time
+    uint8_t chan = link != MAVLINK_LINK_NONE ? MAVLINK_LINK_CHANNEL(link) : MAVLINK_COMM_0;
+    int rem = sizeof(mavlink->buf) - mavlink->buf_pos;
+    int n = io_read(&mavlink->io, &mavlink->buf[mavlink->buf_pos], rem, 0);
 
     uint8_t ret = 0;
 
-    if (n <= 0 && mavlink->buf_pos == 0)
+    if (n <= 0)
     {
         return ret;
     }
@@ -42,72 +95,49 @@ int mavlink_update(mavlink_t *mavlink, void *data)
     mavlink->buf_pos += n;
     LOG_D(TAG, "Read %d bytes, buf at %u", n, mavlink->buf_pos);
 
-    int start = 0;
-    int end = mavlink->buf_pos;
     ret = 1;
 
-    while(start < mavlink->buf_pos)
+    for (int ii = mavlink->parse_pos; ii < mavlink->buf_pos; ii++)
     {
-        if (mavlink_parse_char(chan, mavlink->buf[start], mavlink->message, mavlink->status))
+        if (mavlink_parse_char(chan, mavlink->buf[ii], mavlink->message, mavlink->status))
         {
-            LOG_D(TAG, "Received message with ID [%d], sequence: [%d] from component [%d] of system [%d]", mavlink->message->msgid, mavlink->message->seq, mavlink->message->compid, mavlink->message->sysid);
+            mavlink_handle_message(mavlink, (atp_t *)data);
 
-            mavlink->counter++;
-
-            if (mavlink->message->seq == 0xff)
+            // The frame is still in buf, forward it without packing it again
+            if (link != MAVLINK_LINK_NONE && mavlink->frame_start >= 0)
             {
-                mavlink->link_quality = mavlink->counter / 255.0f;
-                mavlink->counter = 0;
-                LOG_I(TAG, "link_quality: [%.2f] ", mavlink->link_quality);
+                mavlink_router_route(link, mavlink->message, &mavlink->buf[mavlink->frame_start], ii - mavlink->frame_start + 1);
             }
 
-            time_micros_t now = time_micros_now();
-            atp_t *atp = (atp_t *)data;
-
-            switch(mavlink->message->msgid) 
+            mavlink->frame_start = -1;
+            ret = 2;
+        }
+        else
+        {
+            uint8_t parse_state = mavlink_get_channel_status(chan)->parse_state;
+            if (parse_state == MAVLINK_PARSE_STATE_GOT_STX)
             {
-            case MAVLINK_MSG_ID_GLOBAL_POSITION_INT: // ID for GLOBAL_POSITION_INT
-                // Get all fields in payload (into global_position)
-                mavlink_msg_global_position_int_decode(mavlink->message, mavlink->message_value.global_position);
-                ATP_SET_I32(TAG_PLANE_LONGITUDE,  mavlink->message_value.global_position->lon, now);
-                ATP_SET_I32(TAG_PLANE_LATITUDE, mavlink->message_value.global_position->lat, now);
-                ATP_SET_I32(TAG_PLANE_ALTITUDE, mavlink->message_value.global_position->alt / 10, now);
-                atp->tag_value_changed(atp->tracker, TAG_PLANE_LATITUDE);
-                atp->tag_value_changed(atp->tracker, TAG_PLANE_LONGITUDE);
-                break;
-            case MAVLINK_MSG_ID_HOME_POSITION:
-                mavlink_msg_home_position_decode(mavlink->message, mavlink->message_value.home_position);
-                ATP_SET_I32(TAG_TRACKER_LONGITUDE,  mavlink->message_value.home_position->longitude, now);
-                ATP_SET_I32(TAG_TRACKER_LATITUDE,  mavlink->message_value.home_position->latitude, now);
-                ATP_SET_I32(TAG_TRACKER_ALTITUDE,  mavlink->message_value.home_position->altitude / 10, now);
-                atp->tag_value_changed(atp->tracker, TAG_TRACKER_LONGITUDE);
-                atp->tag_value_changed(atp->tracker, TAG_TRACKER_LATITUDE);
-                atp->tag_value_changed(atp->tracker, TAG_TRACKER_ALTITUDE);
-                break;
-            case MAVLINK_MSG_ID_GPS_RAW_INT:
-                //mavlink_msg_gps_raw_int_decode(mavlink->message, mavlink->message_value.gps_raw);
-                //ATP_SET_I16(TAG_PLANE_SPEED,  (uint16_t)(mavlink->message_value.gps_raw->vel / 100), now);
-                break;
+                mavlink->frame_start = ii;
+            }
+            else if (parse_state <= MAVLINK_PARSE_STATE_IDLE)
+            {
+                // Bad CRC or garbage, nothing to keep
+                mavlink->frame_start = -1;
             }
-
-            ret = 2;
-            break;
         }
-
-        start++;
     }
 
-    if (start > 0)
+    // Keep the frame being received at the start of buf, everything before it is done
+    int keep = 0;
+    if (mavlink->frame_start >= 0)
     {
-        LOG_D(TAG, "Consumed %d bytes", start);
-        LOG_BUFFER_D(TAG, &mavlink->buf[0], start);
-        if (start != mavlink->buf_pos)
-        {
-            // Got some data at the end that we need to copy
-            memmove(mavlink->buf, &mavlink->buf[start], end - start);
-        }
-        mavlink->buf_pos -= start;
+        keep = mavlink->buf_pos - mavlink->frame_start;
+        memmove(mavlink->buf, &mavlink->buf[mavlink->frame_start], keep);
+        mavlink->frame_start = 0;
     }
+    LOG_D(TAG, "Consumed %d bytes", mavlink->buf_pos - keep);
+    mavlink->buf_pos = keep;
+    mavlink->parse_pos = keep;
 
     return ret;
 }
@@ -120,11 +150,10 @@ bool mavlink_has_buffered_data(mavlink_t *mavlink)
 void mavlink_port_reset(mavlink_t *mavlink)
 {
     mavlink->buf_pos = 0;
+    mavlink->parse_pos = 0;
+    mavlink->frame_start = -1;
 }
 
 void mavlink_destroy(mavlink_t *mavlink)
 {
-    free(mavlink->io);
-    free(mavlink->message_value.global_position);
-    free(mavlink->message_value.home_position);
 }
\ No newline at end of file
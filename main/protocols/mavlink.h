@@ -17,14 +17,17 @@ typedef struct __mavlink_gps_raw_int_t mavlink_gps_raw_int_t;
 typedef struct mavlink_s
 {
     telemetry_t *plane_vals;
-    io_t *io;
+    io_t io;
     uint8_t buf[MAVLINK_FRAME_SIZE_MAX * 2];
     int buf_pos;
+    int parse_pos;
+    int frame_start;
     mavlink_status_t *status;
     mavlink_message_t *message;
     uint8_t counter;
     float link_quality;
     bool home_source;
+    uint8_t source;
 
     struct 
     {
@@ -0,0 +1,264 @@
+#include <string.h>
+
+#include <hal/log.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "../components/c_library_v2/common/mavlink.h"
+#include "mavlink_router.h"
+
+static const char *TAG = "Protocol.MavlinkRouter";
+
+static const char *mavlink_link_names[MAVLINK_LINK_COUNT] = {
+    [MAVLINK_LINK_UART1] = "UART1",
+    [MAVLINK_LINK_UART2] = "UART2",
+    [MAVLINK_LINK_UDP] = "UDP",
+};
+
+static mavlink_router_t router;
+// Only used by mavlink_router_receive(), UART links parse into their own buffers
+static mavlink_message_t router_message;
+static mavlink_status_t router_status;
+
+static SemaphoreHandle_t _mutex;
+
+void mavlink_router_init(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    memset(&router, 0, sizeof(router));
+
+    _mutex = xSemaphoreCreateMutex();
+
+    LOG_I(TAG, "Initialized");
+}
+
+mavlink_link_e mavlink_router_link_from_source(protocol_io_source_e source)
+{
+    switch (source)
+    {
+    case PROTOCOL_IO_UART1:
+        return MAVLINK_LINK_UART1;
+    case PROTOCOL_IO_UART2:
+        return MAVLINK_LINK_UART2;
+    default:
+        break;
+    }
+    return MAVLINK_LINK_NONE;
+}
+
+void mavlink_router_set_link(mavlink_link_e link, io_write_f write, void *data)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    router.links[link] = (io_t){
+        .write = write,
+        .data = data,
+    };
+
+    if (!write)
+    {
+        // Whatever was behind this link is gone, relearn it if it comes back
+        int jj = 0;
+        for (int ii = 0; ii < router.route_count; ii++)
+        {
+            if (router.routes[ii].link != link)
+            {
+                router.routes[jj++] = router.routes[ii];
+            }
+        }
+        router.route_count = jj;
+    }
+
+    xSemaphoreGive(_mutex);
+
+    LOG_I(TAG, "Link %s %s", mavlink_link_names[link], write ? "added" : "removed");
+}
+
+void mavlink_router_set_local(uint8_t sysid, uint8_t compid, mavlink_router_local_f handler, void *data)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    router.local.sysid = sysid;
+    router.local.compid = compid;
+    router.local.handler = handler;
+    router.local.data = data;
+
+    xSemaphoreGive(_mutex);
+}
+
+void mavlink_router_send(const mavlink_message_t *msg)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint16_t size = mavlink_msg_to_send_buffer(buf, msg);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    for (int ii = 0; ii < MAVLINK_LINK_COUNT; ii++)
+    {
+        io_write(&router.links[ii], buf, size);
+    }
+
+    xSemaphoreGive(_mutex);
+}
+
+static void mavlink_router_learn(mavlink_link_e from, const mavlink_message_t *msg)
+{
+    if (msg->sysid == 0)
+    {
+        return;
+    }
+
+    for (int ii = 0; ii < router.route_count; ii++)
+    {
+        mavlink_route_t *route = &router.routes[ii];
+        if (route->sysid == msg->sysid && route->compid == msg->compid)
+        {
+            if (route->link != from)
+            {
+                LOG_I(TAG, "System %u component %u moved to %s", msg->sysid, msg->compid, mavlink_link_names[from]);
+                route->link = from;
+            }
+            return;
+        }
+    }
+
+    if (router.route_count == MAVLINK_ROUTER_MAX_ROUTES)
+    {
+        LOG_D(TAG, "Route table full, not adding system %u component %u", msg->sysid, msg->compid);
+        return;
+    }
+
+    router.routes[router.route_count++] = (mavlink_route_t){
+        .sysid = msg->sysid,
+        .compid = msg->compid,
+        .link = from,
+    };
+    LOG_I(TAG, "Found system %u component %u on %s", msg->sysid, msg->compid, mavlink_link_names[from]);
+}
+
+static void mavlink_router_get_target(const mavlink_message_t *msg, int *target_system, int *target_component)
+{
+    // -1 means the message has no such field, so it goes everywhere
+    *target_system = -1;
+    *target_component = -1;
+
+    const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(msg->msgid);
+    if (!entry)
+    {
+        return;
+    }
+
+    const uint8_t *payload = (const uint8_t *)_MAV_PAYLOAD(msg);
+    if (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM)
+    {
+        *target_system = payload[entry->target_system_ofs];
+    }
+    if (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT)
+    {
+        *target_component = payload[entry->target_component_ofs];
+    }
+}
+
+static bool mavlink_router_link_has_target(mavlink_link_e link, int target_system, int target_component)
+{
+    for (int ii = 0; ii < router.route_count; ii++)
+    {
+        const mavlink_route_t *route = &router.routes[ii];
+        if (route->link == link && route->sysid == target_system &&
+            (target_component <= 0 || route->compid == target_component))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void mavlink_router_route(mavlink_link_e from, const mavlink_message_t *msg, const uint8_t *frame, size_t size)
+{
+    int target_system;
+    int target_component;
+    bool sent = false;
+    mavlink_router_local_f local = NULL;
+    void *local_data = NULL;
+
+    mavlink_router_get_target(msg, &target_system, &target_component);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    mavlink_router_learn(from, msg);
+
+    for (int ii = 0; ii < MAVLINK_LINK_COUNT; ii++)
+    {
+        io_t *io = &router.links[ii];
+        if (ii == from || !io->write)
+        {
+            continue;
+        }
+
+        // Broadcasts go everywhere, targeted messages only where the target was seen
+        if (target_system <= 0 || mavlink_router_link_has_target(ii, target_system, target_component))
+        {
+            io_write(io, frame, size);
+            sent = true;
+        }
+    }
+
+    if (sent)
+    {
+        router.forwarded++;
+    }
+    else
+    {
+        router.dropped++;
+    }
+
+    if (router.local.handler &&
+        (target_system <= 0 || target_system == router.local.sysid) &&
+        (target_component <= 0 || target_component == router.local.compid))
+    {
+        local = router.local.handler;
+        local_data = router.local.data;
+    }
+
+    xSemaphoreGive(_mutex);
+
+    // Outside the lock, the handler might want to reply
+    if (local)
+    {
+        local(local_data, msg);
+    }
+}
+
+void mavlink_router_receive(mavlink_link_e from, const uint8_t *buf, size_t size)
+{
+    uint8_t chan = MAVLINK_LINK_CHANNEL(from);
+    int frame_start = -1;
+
+    for (int ii = 0; ii < size; ii++)
+    {
+        if (mavlink_parse_char(chan, buf[ii], &router_message, &router_status))
+        {
+            // Frames split across buffers can't be forwarded without copying them
+            if (frame_start >= 0)
+            {
+                mavlink_router_route(from, &router_message, &buf[frame_start], ii - frame_start + 1);
+            }
+            frame_start = -1;
+        }
+        else
+        {
+            uint8_t parse_state = mavlink_get_channel_status(chan)->parse_state;
+            if (parse_state == MAVLINK_PARSE_STATE_GOT_STX)
+            {
+                frame_start = ii;
+            }
+            else if (parse_state <= MAVLINK_PARSE_STATE_IDLE)
+            {
+                // Bad CRC or garbage, nothing to keep
+                frame_start = -1;
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io/io.h"
+#include "protocols/protocol.h"
+
+// Systems/components remembered for targeted messages
+#define MAVLINK_ROUTER_MAX_ROUTES 16
+
+// Same ports used by most WiFi telemetry bridges, so GCSs connect out of the box
+#define MAVLINK_ROUTER_UDP_LOCAL_PORT 14555
+#define MAVLINK_ROUTER_UDP_REMOTE_PORT 14550
+
+typedef struct __mavlink_message mavlink_message_t;
+
+typedef enum
+{
+    MAVLINK_LINK_UART1,
+    MAVLINK_LINK_UART2,
+    MAVLINK_LINK_UDP,
+    MAVLINK_LINK_COUNT,
+} mavlink_link_e;
+
+#define MAVLINK_LINK_NONE MAVLINK_LINK_COUNT
+// MAVLINK_COMM_0 is left to code parsing outside of the router
+#define MAVLINK_LINK_CHANNEL(link) (1 + (link))
+
+typedef struct mavlink_route_s
+{
+    uint8_t sysid;
+    uint8_t compid;
+    uint8_t link;
+} mavlink_route_t;
+
+// Called for messages addressed to this device (or to everyone)
+typedef void (*mavlink_router_local_f)(void *data, const mavlink_message_t *msg);
+
+typedef struct mavlink_router_s
+{
+    io_t links[MAVLINK_LINK_COUNT];
+    struct
+    {
+        uint8_t sysid;
+        uint8_t compid;
+        mavlink_router_local_f handler;
+        void *data;
+    } local;
+    mavlink_route_t routes[MAVLINK_ROUTER_MAX_ROUTES];
+    uint8_t route_count;
+    uint32_t forwarded;
+    uint32_t dropped;
+} mavlink_router_t;
+
+void mavlink_router_init(void);
+// Maps a tracker input source to its link, MAVLINK_LINK_NONE if it can't be routed
+mavlink_link_e mavlink_router_link_from_source(protocol_io_source_e source);
+// Frames are forwarded to a link by calling write. Pass NULL to remove the link.
+void mavlink_router_set_link(mavlink_link_e link, io_write_f write, void *data);
+// Forwards a parsed message to the other links. frame must point to the message
+// exactly as it was received, it's written out as is.
+void mavlink_router_route(mavlink_link_e from, const mavlink_message_t *msg, const uint8_t *frame, size_t size);
+// Makes this device a MAVLink system, receiving the messages sent to it
+void mavlink_router_set_local(uint8_t sysid, uint8_t compid, mavlink_router_local_f handler, void *data);
+// Sends a message originating from this device to every link
+void mavlink_router_send(const mavlink_message_t *msg);
+// Parses a buffer of complete frames (e.g. an UDP datagram) and routes them
+void mavlink_router_receive(mavlink_link_e from, const uint8_t *buf, size_t size);
@@ -9,7 +9,7 @@
 typedef struct msp_s
 {
     telemetry_t *plane_vals;
-    io_t *io;
+    io_t io;
     uint8_t counter;
     float link_quality;
 } msp_t;
@@ -3,76 +3,153 @@
 #include <hal/log.h>
 #include "atp.h"
 
-static gps_t gps;
-
 static const char *TAG = "Protocol.Nmea";
 
+static void nmea_publish(nmea_t *nmea)
+{
+    atp_t *atp = (atp_t *)nmea->data;
+    gps_t *gps = &nmea->gps;
+    time_micros_t now = nmea->epoch_time;
+    uint8_t epoch = nmea->epoch;
+
+    nmea->epoch = 0;
+
+    if (!(epoch & NMEA_EPOCH_GGA) || gps->fix == 0)
+    {
+        return;
+    }
+
+    nmea->fix_received = true;
+
+#if GPS_CFG_FIXED_POINT
+    int32_t lat = gps->latitude_e7;
+    int32_t lon = gps->longitude_e7;
+    int32_t alt = gps->altitude_cm;
+#else
+    int32_t lat = (int32_t)(gps->latitude * 10000000.0);
+    int32_t lon = (int32_t)(gps->longitude * 10000000.0);
+    int32_t alt = (int32_t)(gps->altitude * 100);
+#endif
+
+    if (nmea->home_source)
+    {
+        bool changed = telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LATITUDE), lat, now);
+        changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LONGITUDE), lon, now);
+        changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_ALTITUDE), alt, now);
+
+        if (changed)
+        {
+            atp->tag_value_changed(atp->tracker, TAG_TRACKER_LATITUDE);
+            atp->tag_value_changed(atp->tracker, TAG_TRACKER_LONGITUDE);
+        }
+        return;
+    }
+
+    position_fix_t fix = {
+        .latitude = lat,
+        .longitude = lon,
+        .altitude = alt,
+        // HDOP comes from GSA, which not every receiver sends
+        .accuracy = gps->dop_h > 0 ? (uint32_t)(gps->dop_h * NMEA_UERE_CM) : ARBITER_ACCURACY_UNKNOWN_CM,
+        .time = now,
+    };
+
+    if (!atp->plane_fix(atp->tracker, nmea->source, &fix))
+    {
+        return;
+    }
+
+    ATP_SET_I16(TAG_PLANE_STAR, gps->sats_in_use, now);
+    ATP_SET_U8(TAG_PLANE_FIX, gps->fix, now);
+
+    if ((epoch & NMEA_EPOCH_RMC) && gps->is_valid)
+    {
+        ATP_SET_I16(TAG_PLANE_SPEED, (int16_t)gps_to_speed(gps->speed, gps_speed_mps), now);
+        ATP_SET_U16(TAG_PLANE_HEADING, (uint16_t)gps->coarse, now);
+    }
+}
+
+static void nmea_statement(gps_t *gps, gps_statement_t stat, void *arg)
+{
+    nmea_t *nmea = arg;
+    uint8_t flag;
+
+    switch (stat)
+    {
+    case gps_statement_gga:
+        flag = NMEA_EPOCH_GGA;
+        break;
+    case gps_statement_rmc:
+        flag = NMEA_EPOCH_RMC;
+        break;
+    default:
+        return;
+    }
+
+    // A sentence for another fix, or the same one twice, means the
+    // receiver doesn't send everything we expected. Flush what we have
+    // and learn it, so GGA and RMC from different fixes are never mixed.
+    if (nmea->epoch != 0 && (gps->time_ms != nmea->epoch_utc_ms || (nmea->epoch & flag)))
+    {
+        LOG_D(TAG, "Incomplete fix 0x%02x, expected 0x%02x", nmea->epoch, nmea->expect);
+        nmea->expect = nmea->epoch;
+        nmea_publish(nmea);
+    }
+
+    if (nmea->epoch == 0)
+    {
+        nmea->epoch_time = time_micros_now();
+        nmea->epoch_utc_ms = gps->time_ms;
+    }
+
+    nmea->epoch |= flag;
+    nmea->expect |= flag;
+
+    if ((nmea->epoch & nmea->expect) == nmea->expect)
+    {
+        nmea_publish(nmea);
+    }
+}
+
 void nmea_init(nmea_t *nmea)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
-    nmea->io = (io_t *)malloc(sizeof(io_t));;
-    nmea->gps = &gps;
-    nmea->buf_pos = 0;
+    nmea->data = NULL;
+    nmea->epoch = 0;
+    nmea->expect = NMEA_EPOCH_GGA | NMEA_EPOCH_RMC;
+    nmea->epoch_time = 0;
+    nmea->epoch_utc_ms = 0;
+    nmea->fix_received = false;
 
     memset(&nmea->buf, 0, sizeof(nmea->buf));
 
+    gps_init(&nmea->gps);
+    gps_set_statement_fn(&nmea->gps, nmea_statement, nmea);
+
     LOG_I(TAG, "Initialized");
 }
 
 int nmea_update(nmea_t *nmea, void *data)
 {
-    int rem = sizeof(nmea->buf)  - nmea->buf_pos;
-    int n = io_read(nmea->io, &nmea->buf[nmea->buf_pos], rem, 0);
-
-    uint8_t ret = 0;
+    int n = io_read(&nmea->io, nmea->buf, sizeof(nmea->buf), 0);
 
-    if (n <= 0 && nmea->buf_pos == 0)
+    if (n <= 0)
     {
-        return ret;
+        return 0;
     }
 
-    nmea->buf_pos += n;
-    LOG_D(TAG, "Read %d bytes, buf at %u", n, nmea->buf_pos);
+    LOG_D(TAG, "Read %d bytes", n);
 
-    if (gps_process(&gps, &nmea->buf, nmea->buf_pos))
-    {
-        if (gps.fix_mode >= 3 && (telemetry_get_i32(atp_get_telemetry_tag_val(TAG_PLANE_LATITUDE)) != (int32_t)(gps.longitude * 10000000.0f) || telemetry_get_i32(atp_get_telemetry_tag_val(TAG_PLANE_LONGITUDE)) != (int32_t)(gps.latitude * 10000000.0f)))
-        {
-            time_micros_t now = time_micros_now();
-            atp_t *atp = (atp_t *)data;
-
-            if (nmea->home_source)
-            {
-                ATP_SET_I32(TAG_TRACKER_LONGITUDE, (int32_t)(gps.longitude * 10000000.0f), now);
-                ATP_SET_I32(TAG_TRACKER_LATITUDE, (int32_t)(gps.latitude * 10000000.0f), now);
-                ATP_SET_I32(TAG_TRACKER_ALTITUDE, (int32_t)(gps.altitude * 100), now);
-                atp->tag_value_changed(atp->tracker, TAG_TRACKER_LATITUDE);
-                atp->tag_value_changed(atp->tracker, TAG_TRACKER_LONGITUDE);
-            }
-            else
-            {
-                ATP_SET_I32(TAG_PLANE_LONGITUDE, (int32_t)(gps.longitude * 10000000.0f), now);
-                ATP_SET_I32(TAG_PLANE_LATITUDE, (int32_t)(gps.latitude * 10000000.0f), now);
-                ATP_SET_I32(TAG_PLANE_ALTITUDE, (int32_t)(gps.altitude * 100), now);
-                ATP_SET_I16(TAG_PLANE_SPEED, (int16_t)gps_to_speed(gps.speed, gps_speed_mps), now);
-                ATP_SET_U16(TAG_PLANE_HEADING, (uint16_t)gps.coarse, now);
-                atp->tag_value_changed(atp->tracker, TAG_PLANE_LATITUDE);
-                atp->tag_value_changed(atp->tracker, TAG_PLANE_LONGITUDE);
-            }
-            
-
-            ret = 1;
-        }
-    }
+    nmea->data = data;
+    nmea->fix_received = false;
 
-    nmea->buf_pos = 0;
+    gps_process(&nmea->gps, nmea->buf, n);
 
-    return ret;
+    return nmea->fix_received ? 2 : 1;
 }
 
 void nmea_destroy(nmea_t *nmea)
 {
-    free(nmea->io);
-    free(nmea->gps);
-}
\ No newline at end of file
+    gps_set_statement_fn(&nmea->gps, NULL, NULL);
+}
@@ -2,23 +2,43 @@
 
 #include "io/io.h"
 #include "util/data_state.h"
+#include "util/time.h"
 #include "../components/gps_nmea_parser/include/gps/gps.h"
 #include "tracker/telemetry.h"
 
 #define NMEA_FRAME_SIZE_MAX 267
+#define NMEA_READ_SIZE 128
+// Typical user equivalent range error, horizontal accuracy ~= HDOP * UERE
+#define NMEA_UERE_CM 500
+
+typedef enum
+{
+    NMEA_EPOCH_GGA = 1 << 0,
+    NMEA_EPOCH_RMC = 1 << 1,
+} nmea_epoch_e;
 
 typedef struct nmea_s
 {
     telemetry_t *plane_vals;
-    io_t *io;
-    uint8_t buf[NMEA_FRAME_SIZE_MAX * 2];
-    int buf_pos;
+    io_t io;
+    // Parser state lives in gps, so a sentence can span several reads
+    uint8_t buf[NMEA_READ_SIZE];
     bool home_source;
+    uint8_t source;
+    void *data;
+
+    // Sentences received for the current fix and the ones the
+    // receiver is known to send for every fix
+    uint8_t epoch;
+    uint8_t expect;
+    time_micros_t epoch_time;
+    // UTC time of day the sentences of the current fix carry
+    uint32_t epoch_utc_ms;
+    bool fix_received;
 
-    gps_t *gps;
-    
+    gps_t gps;
 } nmea_t;
 
 void nmea_init(nmea_t *nmea);
 int nmea_update(nmea_t *nmea, void *data);
-void nmea_destroy(nmea_t *nmea);
\ No newline at end of file
+void nmea_destroy(nmea_t *nmea);
@@ -48,7 +48,6 @@ void pelco_d_init(pelco_d_t *pelco_d)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
-    pelco_d->io = (io_t *)malloc(sizeof(io_t));;
     pelco_d->buf_pos = 0;
 
     memset(&pelco_d->recive_buf, 0, sizeof(pelco_d->recive_buf));
@@ -60,7 +59,7 @@ void pelco_d_init(pelco_d_t *pelco_d)
 int pelco_d_update(pelco_d_t *pelco_d, void *data)
 {
     int rem = sizeof(pelco_d->recive_buf)  - pelco_d->buf_pos;
-    int n = io_read(pelco_d->io, &pelco_d->recive_buf[pelco_d->buf_pos], rem, 0);
+    int n = io_read(&pelco_d->io, &pelco_d->recive_buf[pelco_d->buf_pos], rem, 0);
 
     uint8_t ret = 0;
 
@@ -69,7 +68,7 @@ int pelco_d_update(pelco_d_t *pelco_d, void *data)
     if (t->servo->internal.pan.currtent_degree != pelco_d->pan_degree)
     {
         set_pan(pelco_d, t->servo->internal.pan.currtent_degree);
-        n = io_write(pelco_d->io, &pelco_d->send_buf, PELCO_D_FRAME_SIZE);
+        n = io_write(&pelco_d->io, &pelco_d->send_buf, PELCO_D_FRAME_SIZE);
 
         if (n > 0)
         {   
@@ -83,7 +82,7 @@ int pelco_d_update(pelco_d_t *pelco_d, void *data)
     if (t->servo->internal.tilt.currtent_degree != pelco_d->tilt_degree)
     {
         set_tilt(pelco_d, 360 - t->servo->internal.tilt.currtent_degree);
-        n = io_write(pelco_d->io, &pelco_d->send_buf, PELCO_D_FRAME_SIZE);
+        n = io_write(&pelco_d->io, &pelco_d->send_buf, PELCO_D_FRAME_SIZE);
 
         if (n > 0)
         {   
@@ -99,5 +98,4 @@ int pelco_d_update(pelco_d_t *pelco_d, void *data)
 
 void pelco_d_destroy(pelco_d_t *pelco_d)
 {
-    free(pelco_d->io);
 }
\ No newline at end of file
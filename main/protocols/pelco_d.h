@@ -14,7 +14,7 @@ typedef struct pelco_d_s
 {
     telemetry_t *plane_vals;
     telemetry_t *tracker_vals;
-    io_t *io;
+    io_t io;
     uint8_t recive_buf[PELCO_D_FRAME_SIZE * 2];
     uint8_t send_buf[PELCO_D_FRAME_SIZE];
     int buf_pos;
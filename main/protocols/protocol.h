@@ -16,7 +16,11 @@ typedef enum
     PROTOCOL_MAVLINK,
     PROTOCOL_LTM,
     PROTOCOL_NMEA,
-    PROTOCOL_PELCO_D
+    PROTOCOL_PELCO_D,
+    PROTOCOL_SMARTPORT,
+    PROTOCOL_UBX,
+    PROTOCOL_AUTO,
+    PROTOCOL_BRIDGE
 } protocol_e;
 
 typedef enum
@@ -0,0 +1,210 @@
+#include "smartport.h"
+
+#include <hal/log.h>
+#include "atp.h"
+
+static const char *TAG = "Protocol.SmartPort";
+
+void smartport_init(smartport_t *smartport)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    smartport->buf_pos = 0;
+    smartport->frame_pos = 0;
+    smartport->escape = false;
+    smartport->status = SMARTPORT_IDLE;
+    smartport->position = 0;
+    smartport->altitude = 0;
+    smartport->selected = false;
+
+    memset(&smartport->buf, 0, sizeof(smartport->buf));
+
+    LOG_I(TAG, "Initialized");
+}
+
+static bool smartport_check_crc(const uint8_t *frame)
+{
+    uint16_t crc = 0;
+
+    for (int ii = 0; ii < SMARTPORT_FRAME_SIZE; ii++)
+    {
+        crc += frame[ii];
+        crc += crc >> 8;
+        crc &= 0xFF;
+    }
+
+    return crc == 0xFF;
+}
+
+static void smartport_publish(smartport_t *smartport, atp_t *atp, time_micros_t now)
+{
+    switch (smartport->app_id & SMARTPORT_ID_MASK)
+    {
+    case SMARTPORT_GPS_LONG_LATI_FIRST_ID:
+    {
+        // Minutes * 10000 to degrees * 1e7
+        int32_t v = (int32_t)(((uint64_t)(smartport->value & 0x3FFFFFFF) * 50) / 3);
+        if (smartport->value & (1 << 30))
+        {
+            v = -v;
+        }
+
+        if (smartport->home_source)
+        {
+            uint8_t tag = (smartport->value & (1u << 31)) ? TAG_TRACKER_LONGITUDE : TAG_TRACKER_LATITUDE;
+            ATP_SET_I32(tag, v, now);
+            atp->tag_value_changed(atp->tracker, tag);
+            break;
+        }
+
+        if (smartport->value & (1u << 31))
+        {
+            smartport->longitude = v;
+            smartport->position |= SMARTPORT_POSITION_LON;
+        }
+        else
+        {
+            smartport->latitude = v;
+            smartport->position |= SMARTPORT_POSITION_LAT;
+        }
+
+        if (smartport->position == (SMARTPORT_POSITION_LAT | SMARTPORT_POSITION_LON))
+        {
+            position_fix_t fix = {
+                .latitude = smartport->latitude,
+                .longitude = smartport->longitude,
+                .altitude = smartport->altitude,
+                .accuracy = ARBITER_ACCURACY_UNKNOWN_CM,
+                .time = now,
+            };
+            smartport->selected = atp->plane_fix(atp->tracker, smartport->source, &fix);
+            smartport->position = 0;
+        }
+        break;
+    }
+    case SMARTPORT_GPS_ALT_FIRST_ID:
+        if (smartport->home_source)
+        {
+            ATP_SET_I32(TAG_TRACKER_ALTITUDE, (int32_t)smartport->value, now);
+        }
+        else
+        {
+            // Sent along with the next position
+            smartport->altitude = (int32_t)smartport->value;
+        }
+        break;
+    case SMARTPORT_GPS_SPEED_FIRST_ID:
+        if (!smartport->home_source && smartport->selected)
+        {
+            // Knots * 1000 to m/s
+            ATP_SET_I16(TAG_PLANE_SPEED, (int16_t)(((uint64_t)smartport->value * 514444) / 1000000000), now);
+        }
+        break;
+    case SMARTPORT_GPS_COURS_FIRST_ID:
+        if (!smartport->home_source && smartport->selected)
+        {
+            ATP_SET_U16(TAG_PLANE_HEADING, (uint16_t)((smartport->value / 100) % 360), now);
+        }
+        break;
+    }
+}
+
+int smartport_update(smartport_t *smartport, void *data)
+{
+    int rem = sizeof(smartport->buf) - smartport->buf_pos;
+    int n = io_read(&smartport->io, &smartport->buf[smartport->buf_pos], rem, 0);
+
+    uint8_t ret = 0;
+
+    if (n <= 0 && smartport->buf_pos == 0)
+    {
+        return ret;
+    }
+
+    smartport->buf_pos += n;
+    LOG_D(TAG, "Read %d bytes, buf at %u", n, smartport->buf_pos);
+
+    ret = 1;
+
+    // Frames are short and polled every ~12ms, so decode everything we got
+    for (int ii = 0; ii < smartport->buf_pos; ii++)
+    {
+        if (smartport_decode(smartport, smartport->buf[ii]))
+        {
+            LOG_D(TAG, "Sensor [0x%02x] app id [0x%04x] value [%u]", smartport->physical_id, smartport->app_id, smartport->value);
+            smartport_publish(smartport, (atp_t *)data, time_micros_now());
+            ret = 2;
+        }
+    }
+
+    smartport->buf_pos = 0;
+
+    return ret;
+}
+
+bool smartport_decode(smartport_t *smartport, uint8_t c)
+{
+    if (c == SMARTPORT_START_STOP)
+    {
+        // Every poll from the receiver starts with 0x7E, resync on it
+        smartport->status = SMARTPORT_STATE_PHYSICAL_ID;
+        smartport->frame_pos = 0;
+        smartport->escape = false;
+        return false;
+    }
+
+    if (smartport->status == SMARTPORT_IDLE)
+    {
+        return false;
+    }
+
+    if (smartport->status == SMARTPORT_STATE_PHYSICAL_ID)
+    {
+        smartport->physical_id = c;
+        smartport->status = SMARTPORT_STATE_DATA;
+        return false;
+    }
+
+    if (c == SMARTPORT_BYTE_STUFF)
+    {
+        smartport->escape = true;
+        return false;
+    }
+
+    if (smartport->escape)
+    {
+        c ^= SMARTPORT_STUFF_MASK;
+        smartport->escape = false;
+    }
+
+    if (smartport->frame_pos == 0 && c != SMARTPORT_DATA_FRAME)
+    {
+        // Not a sensor reply, wait for the next poll
+        smartport->status = SMARTPORT_IDLE;
+        return false;
+    }
+
+    smartport->frame[smartport->frame_pos++] = c;
+
+    if (smartport->frame_pos < SMARTPORT_FRAME_SIZE)
+    {
+        return false;
+    }
+
+    smartport->status = SMARTPORT_IDLE;
+
+    if (!smartport_check_crc(smartport->frame))
+    {
+        LOG_D(TAG, "CRC error from sensor [0x%02x]", smartport->physical_id);
+        return false;
+    }
+
+    smartport->app_id = smartport->frame[1] | (smartport->frame[2] << 8);
+    smartport->value = smartport->frame[3] | (smartport->frame[4] << 8) | (smartport->frame[5] << 16) | ((uint32_t)smartport->frame[6] << 24);
+
+    return true;
+}
+
+void smartport_destroy(smartport_t *smartport)
+{
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "io/io.h"
+#include "util/macros.h"
+#include "util/time.h"
+#include "util/data_state.h"
+#include "tracker/telemetry.h"
+
+#define SMARTPORT_BAUDRATE 57600
+
+#define SMARTPORT_START_STOP 0x7E
+#define SMARTPORT_BYTE_STUFF 0x7D
+#define SMARTPORT_STUFF_MASK 0x20
+
+#define SMARTPORT_DATA_FRAME 0x10
+
+// Sensor IDs are ranges of 16 (FIRST_ID .. FIRST_ID + 0x0F)
+#define SMARTPORT_ID_MASK 0xFFF0
+#define SMARTPORT_GPS_LONG_LATI_FIRST_ID 0x0800 // lat/lon, bit31: lon, bit30: negative, minutes * 10000
+#define SMARTPORT_GPS_ALT_FIRST_ID 0x0820 // cm
+#define SMARTPORT_GPS_SPEED_FIRST_ID 0x0830 // knots * 1000
+#define SMARTPORT_GPS_COURS_FIRST_ID 0x0840 // degrees * 100
+
+// frame type + app id (2) + value (4) + crc
+#define SMARTPORT_FRAME_SIZE 8
+#define SMARTPORT_BUFFER_SIZE 64
+
+// Latitude and longitude arrive in separate frames
+#define SMARTPORT_POSITION_LAT (1 << 0)
+#define SMARTPORT_POSITION_LON (1 << 1)
+
+typedef enum
+{
+    SMARTPORT_IDLE,
+    SMARTPORT_STATE_PHYSICAL_ID,
+    SMARTPORT_STATE_DATA,
+} smartport_frame_status_e;
+
+typedef struct smartport_s
+{
+    telemetry_t *plane_vals;
+    io_t io;
+    bool home_source;
+    uint8_t source;
+
+    uint8_t buf[SMARTPORT_BUFFER_SIZE];
+    uint8_t buf_pos;
+    uint8_t frame[SMARTPORT_FRAME_SIZE];
+    uint8_t frame_pos;
+    bool escape;
+    uint8_t physical_id;
+    uint16_t app_id;
+    uint32_t value;
+    smartport_frame_status_e status;
+
+    int32_t latitude;
+    int32_t longitude;
+    int32_t altitude;
+    uint8_t position;
+    bool selected;
+} smartport_t;
+
+void smartport_init(smartport_t *smartport);
+int smartport_update(smartport_t *smartport, void *data);
+bool smartport_decode(smartport_t *smartport, uint8_t c);
+void smartport_destroy(smartport_t *smartport);
@@ -0,0 +1,289 @@
+#include "ubx.h"
+
+#include <hal/log.h>
+#include "atp.h"
+
+static const char *TAG = "Protocol.Ubx";
+
+static void ubx_checksum(uint8_t *ck_a, uint8_t *ck_b, const uint8_t *data, size_t len)
+{
+    for (size_t ii = 0; ii < len; ii++)
+    {
+        *ck_a += data[ii];
+        *ck_b += *ck_a;
+    }
+}
+
+static uint8_t *ubx_put_u8(uint8_t *p, uint8_t v)
+{
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *ubx_put_u16(uint8_t *p, uint16_t v)
+{
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+    return p;
+}
+
+static uint8_t *ubx_put_u32(uint8_t *p, uint32_t v)
+{
+    p = ubx_put_u16(p, v & 0xFFFF);
+    return ubx_put_u16(p, v >> 16);
+}
+
+void ubx_init(ubx_t *ubx)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    ubx->buf_pos = 0;
+    ubx->status = UBX_IDLE;
+    ubx->acks = 0;
+    ubx->naks = 0;
+
+    memset(&ubx->buf, 0, sizeof(ubx->buf));
+    memset(&ubx->nav_pvt, 0, sizeof(ubx->nav_pvt));
+
+    LOG_I(TAG, "Initialized");
+}
+
+int ubx_send(ubx_t *ubx, uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t len)
+{
+    uint8_t header[6] = {UBX_SYNC1, UBX_SYNC2, msg_class, msg_id, len & 0xFF, len >> 8};
+    uint8_t ck[2] = {0, 0};
+
+    ubx_checksum(&ck[0], &ck[1], &header[2], sizeof(header) - 2);
+    ubx_checksum(&ck[0], &ck[1], payload, len);
+
+    int n = io_write(&ubx->io, header, sizeof(header));
+    if (len > 0)
+    {
+        n += io_write(&ubx->io, payload, len);
+    }
+    n += io_write(&ubx->io, ck, sizeof(ck));
+
+    return n;
+}
+
+void ubx_configure_baudrate(ubx_t *ubx, uint32_t baudrate)
+{
+    uint8_t payload[20];
+    uint8_t *p;
+
+    // Legacy receivers (M8 and older), UART1 8N1, UBX+NMEA in, UBX out
+    memset(payload, 0, sizeof(payload));
+    p = ubx_put_u8(payload, 1);
+    p = ubx_put_u8(p, 0);
+    p = ubx_put_u16(p, 0);
+    p = ubx_put_u32(p, 0x000008D0);
+    p = ubx_put_u32(p, baudrate);
+    p = ubx_put_u16(p, 0x0003);
+    p = ubx_put_u16(p, 0x0001);
+    ubx_send(ubx, UBX_CLASS_CFG, UBX_CFG_PRT, payload, sizeof(payload));
+
+    // Generation 9+ receivers, RAM layer only
+    p = ubx_put_u8(payload, 0);
+    p = ubx_put_u8(p, 0x01);
+    p = ubx_put_u16(p, 0);
+    p = ubx_put_u32(p, UBX_CFG_KEY_UART1_BAUDRATE);
+    p = ubx_put_u32(p, baudrate);
+    ubx_send(ubx, UBX_CLASS_CFG, UBX_CFG_VALSET, payload, p - payload);
+
+    LOG_I(TAG, "Request baudrate %u", baudrate);
+}
+
+void ubx_configure_nav_pvt(ubx_t *ubx, uint16_t rate_ms)
+{
+    uint8_t payload[32];
+    uint8_t *p;
+
+    // Legacy receivers: measurement rate and NAV-PVT on every solution
+    p = ubx_put_u16(payload, rate_ms);
+    p = ubx_put_u16(p, 1);
+    p = ubx_put_u16(p, 1);
+    ubx_send(ubx, UBX_CLASS_CFG, UBX_CFG_RATE, payload, p - payload);
+
+    p = ubx_put_u8(payload, UBX_CLASS_NAV);
+    p = ubx_put_u8(p, UBX_NAV_PVT);
+    p = ubx_put_u8(p, 1);
+    ubx_send(ubx, UBX_CLASS_CFG, UBX_CFG_MSG, payload, p - payload);
+
+    // Generation 9+ receivers
+    p = ubx_put_u8(payload, 0);
+    p = ubx_put_u8(p, 0x01);
+    p = ubx_put_u16(p, 0);
+    p = ubx_put_u32(p, UBX_CFG_KEY_RATE_MEAS);
+    p = ubx_put_u16(p, rate_ms);
+    p = ubx_put_u32(p, UBX_CFG_KEY_MSGOUT_NAV_PVT_UART1);
+    p = ubx_put_u8(p, 1);
+    p = ubx_put_u32(p, UBX_CFG_KEY_UART1OUTPROT_UBX);
+    p = ubx_put_u8(p, 1);
+    p = ubx_put_u32(p, UBX_CFG_KEY_UART1OUTPROT_NMEA);
+    p = ubx_put_u8(p, 0);
+    ubx_send(ubx, UBX_CLASS_CFG, UBX_CFG_VALSET, payload, p - payload);
+
+    LOG_I(TAG, "Request NAV-PVT every %ums", rate_ms);
+}
+
+static void ubx_publish_nav_pvt(ubx_t *ubx, atp_t *atp, time_micros_t now)
+{
+    const ubx_nav_pvt_t *pvt = &ubx->nav_pvt;
+
+    if (pvt->fix_type < UBX_FIX_2D || !(pvt->flags & UBX_FLAGS_GNSS_FIX_OK))
+    {
+        return;
+    }
+
+    LOG_D(TAG, "PVT fix:%u sv:%u lat:%d lon:%d h_acc:%umm", pvt->fix_type, pvt->num_sv, pvt->lat, pvt->lon, pvt->h_acc);
+
+    if (ubx->home_source)
+    {
+        bool changed = telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LATITUDE), pvt->lat, now);
+        changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LONGITUDE), pvt->lon, now);
+        changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_TRACKER_ALTITUDE), pvt->h_msl / 10, now);
+
+        if (changed)
+        {
+            atp->tag_value_changed(atp->tracker, TAG_TRACKER_LATITUDE);
+            atp->tag_value_changed(atp->tracker, TAG_TRACKER_LONGITUDE);
+        }
+        return;
+    }
+
+    position_fix_t fix = {
+        .latitude = pvt->lat,
+        .longitude = pvt->lon,
+        .altitude = pvt->h_msl / 10,
+        .accuracy = pvt->h_acc / 10,
+        .time = now,
+    };
+
+    if (!atp->plane_fix(atp->tracker, ubx->source, &fix))
+    {
+        return;
+    }
+
+    ATP_SET_I16(TAG_PLANE_STAR, pvt->num_sv, now);
+    ATP_SET_U8(TAG_PLANE_FIX, pvt->fix_type, now);
+    ATP_SET_I16(TAG_PLANE_SPEED, (int16_t)(pvt->g_speed / 1000), now);
+    ATP_SET_U16(TAG_PLANE_HEADING, (uint16_t)((pvt->head_mot / 100000) % 360), now);
+}
+
+int ubx_update(ubx_t *ubx, void *data)
+{
+    int rem = sizeof(ubx->buf) - ubx->buf_pos;
+    int n = io_read(&ubx->io, &ubx->buf[ubx->buf_pos], rem, 0);
+
+    uint8_t ret = 0;
+
+    if (n <= 0 && ubx->buf_pos == 0)
+    {
+        return ret;
+    }
+
+    ubx->buf_pos += n;
+    LOG_D(TAG, "Read %d bytes, buf at %u", n, ubx->buf_pos);
+
+    ret = 1;
+
+    // The decoder keeps its own state, so the whole buffer can be consumed
+    for (int ii = 0; ii < ubx->buf_pos; ii++)
+    {
+        if (!ubx_decode(ubx, ubx->buf[ii]))
+        {
+            continue;
+        }
+
+        switch (ubx->msg_class)
+        {
+        case UBX_CLASS_NAV:
+            if (ubx->msg_id == UBX_NAV_PVT && ubx->length == UBX_NAV_PVT_SIZE)
+            {
+                memcpy(&ubx->nav_pvt, ubx->payload, sizeof(ubx->nav_pvt));
+                ubx_publish_nav_pvt(ubx, (atp_t *)data, time_micros_now());
+                ret = 2;
+            }
+            break;
+        case UBX_CLASS_ACK:
+            if (ubx->msg_id == UBX_ACK_ACK)
+            {
+                ubx->acks++;
+            }
+            else
+            {
+                ubx->naks++;
+                LOG_D(TAG, "NAK for 0x%02x 0x%02x", ubx->payload[0], ubx->payload[1]);
+            }
+            break;
+        }
+    }
+
+    ubx->buf_pos = 0;
+
+    return ret;
+}
+
+bool ubx_decode(ubx_t *ubx, uint8_t c)
+{
+    switch (ubx->status)
+    {
+    case UBX_IDLE:
+        if (c == UBX_SYNC1)
+        {
+            ubx->status = UBX_STATE_SYNC2;
+        }
+        break;
+    case UBX_STATE_SYNC2:
+        ubx->status = c == UBX_SYNC2 ? UBX_STATE_CLASS : UBX_IDLE;
+        break;
+    case UBX_STATE_CLASS:
+        ubx->msg_class = c;
+        ubx->ck_a = c;
+        ubx->ck_b = c;
+        ubx->status = UBX_STATE_ID;
+        break;
+    case UBX_STATE_ID:
+        ubx->msg_id = c;
+        ubx_checksum(&ubx->ck_a, &ubx->ck_b, &c, 1);
+        ubx->status = UBX_STATE_LENGTH1;
+        break;
+    case UBX_STATE_LENGTH1:
+        ubx->length = c;
+        ubx_checksum(&ubx->ck_a, &ubx->ck_b, &c, 1);
+        ubx->status = UBX_STATE_LENGTH2;
+        break;
+    case UBX_STATE_LENGTH2:
+        ubx->length |= c << 8;
+        ubx_checksum(&ubx->ck_a, &ubx->ck_b, &c, 1);
+        ubx->payload_pos = 0;
+        ubx->status = ubx->length > 0 ? UBX_STATE_PAYLOAD : UBX_STATE_CK_A;
+        break;
+    case UBX_STATE_PAYLOAD:
+        // Messages we don't care about may be longer than the payload
+        // buffer, keep checksumming them but drop the bytes.
+        if (ubx->payload_pos < sizeof(ubx->payload))
+        {
+            ubx->payload[ubx->payload_pos] = c;
+        }
+        ubx->payload_pos++;
+        ubx_checksum(&ubx->ck_a, &ubx->ck_b, &c, 1);
+        if (ubx->payload_pos >= ubx->length)
+        {
+            ubx->status = UBX_STATE_CK_A;
+        }
+        break;
+    case UBX_STATE_CK_A:
+        ubx->status = c == ubx->ck_a ? UBX_STATE_CK_B : UBX_IDLE;
+        break;
+    case UBX_STATE_CK_B:
+        ubx->status = UBX_IDLE;
+        return c == ubx->ck_b && ubx->length <= sizeof(ubx->payload);
+    }
+
+    return false;
+}
+
+void ubx_destroy(ubx_t *ubx)
+{
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "io/io.h"
+#include "util/macros.h"
+#include "util/time.h"
+#include "util/data_state.h"
+#include "tracker/telemetry.h"
+
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_ACK 0x05
+#define UBX_CLASS_CFG 0x06
+
+#define UBX_NAV_PVT 0x07
+#define UBX_ACK_NAK 0x00
+#define UBX_ACK_ACK 0x01
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_CFG_VALSET 0x8A
+
+// Configuration keys for generation 9+ receivers
+#define UBX_CFG_KEY_UART1_BAUDRATE 0x40520001 // U4
+#define UBX_CFG_KEY_RATE_MEAS 0x30210001 // U2, ms
+#define UBX_CFG_KEY_MSGOUT_NAV_PVT_UART1 0x20910007 // U1
+#define UBX_CFG_KEY_UART1OUTPROT_UBX 0x10740001 // L
+#define UBX_CFG_KEY_UART1OUTPROT_NMEA 0x10740002 // L
+
+#define UBX_NAV_PVT_SIZE 92
+#define UBX_MAX_PAYLOAD_SIZE 100
+#define UBX_BUFFER_SIZE 128
+
+#define UBX_BAUDRATE 115200
+#define UBX_NAV_RATE_MS 100 // 10Hz, 40 for 25Hz on receivers that support it
+
+#define UBX_FIX_2D 2
+#define UBX_FIX_3D 3
+#define UBX_FLAGS_GNSS_FIX_OK (1 << 0)
+
+typedef enum
+{
+    UBX_IDLE,
+    UBX_STATE_SYNC2,
+    UBX_STATE_CLASS,
+    UBX_STATE_ID,
+    UBX_STATE_LENGTH1,
+    UBX_STATE_LENGTH2,
+    UBX_STATE_PAYLOAD,
+    UBX_STATE_CK_A,
+    UBX_STATE_CK_B,
+} ubx_frame_status_e;
+
+#pragma pack(1)
+typedef struct ubx_nav_pvt_s
+{
+    uint32_t itow; // ms
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t valid;
+    uint32_t t_acc; // ns
+    int32_t nano; // ns
+    uint8_t fix_type; // 0: no fix, 2: 2D, 3: 3D
+    uint8_t flags;
+    uint8_t flags2;
+    uint8_t num_sv;
+    int32_t lon; // 1e-7 deg
+    int32_t lat; // 1e-7 deg
+    int32_t height; // mm above ellipsoid
+    int32_t h_msl; // mm above mean sea level
+    uint32_t h_acc; // mm
+    uint32_t v_acc; // mm
+    int32_t vel_n; // mm/s
+    int32_t vel_e; // mm/s
+    int32_t vel_d; // mm/s
+    int32_t g_speed; // mm/s
+    int32_t head_mot; // 1e-5 deg
+    uint32_t s_acc; // mm/s
+    uint32_t head_acc; // 1e-5 deg
+    uint16_t p_dop; // 0.01
+    uint16_t flags3;
+    uint8_t reserved[4];
+    int32_t head_veh; // 1e-5 deg
+    int16_t mag_dec; // 1e-2 deg
+    uint16_t mag_acc; // 1e-2 deg
+} ubx_nav_pvt_t;
+#pragma pack()
+
+_Static_assert(sizeof(ubx_nav_pvt_t) == UBX_NAV_PVT_SIZE, "invalid ubx_nav_pvt_t size");
+
+typedef struct ubx_s
+{
+    telemetry_t *plane_vals;
+    io_t io;
+    bool home_source;
+    uint8_t source;
+
+    uint8_t buf[UBX_BUFFER_SIZE];
+    uint8_t payload[UBX_MAX_PAYLOAD_SIZE];
+    uint8_t buf_pos;
+    uint16_t payload_pos;
+    uint16_t length;
+    uint8_t msg_class;
+    uint8_t msg_id;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    ubx_frame_status_e status;
+
+    ubx_nav_pvt_t nav_pvt;
+    uint32_t acks;
+    uint32_t naks;
+} ubx_t;
+
+void ubx_init(ubx_t *ubx);
+int ubx_update(ubx_t *ubx, void *data);
+bool ubx_decode(ubx_t *ubx, uint8_t c);
+int ubx_send(ubx_t *ubx, uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t len);
+void ubx_configure_baudrate(ubx_t *ubx, uint32_t baudrate);
+void ubx_configure_nav_pvt(ubx_t *ubx, uint16_t rate_ms);
+void ubx_destroy(ubx_t *ubx);
@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include <hal/log.h>
+#include <hal/err.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "bno055.h"
+#include "util/time.h"
+
+const static char *TAG = "bno055";
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// private utilities
+//
+////////////////////////////////////////////////////////////////////////////////
+static bool bno055_handle_error(bno055_t *bno, hal_err_t err, const char *what)
+{
+  hal_i2c_cmd_give(bno->i2c_cfg->i2c_bus);
+  if (err != HAL_ERR_NONE)
+  {
+    LOG_E(TAG, "%s: %d", what, err);
+    return false;
+  }
+  return true;
+}
+
+static void bno055_write_reg(bno055_t *bno, uint8_t reg, uint8_t data)
+{
+  uint8_t buffer[2] = {reg, data};
+
+  hal_i2c_cmd_take(bno->i2c_cfg->i2c_bus);
+  bno055_handle_error(bno, hal_i2c_write(bno->i2c_cfg->i2c_bus, bno->addr, buffer, 2), "write");
+}
+
+static bool bno055_read_data(bno055_t *bno, uint8_t reg, uint8_t *data, uint8_t len)
+{
+  hal_i2c_cmd_take(bno->i2c_cfg->i2c_bus);
+  return bno055_handle_error(bno, hal_i2c_write_then_read(bno->i2c_cfg->i2c_bus, bno->addr, &reg, 1, data, len), "read");
+}
+
+static uint8_t bno055_read_reg(bno055_t *bno, uint8_t reg)
+{
+  uint8_t ret = 0;
+
+  bno055_read_data(bno, reg, &ret, 1);
+  return ret;
+}
+
+static inline int16_t bno055_i16(const uint8_t *data)
+{
+  return (int16_t)(data[1] << 8 | data[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// public utilities
+//
+////////////////////////////////////////////////////////////////////////////////
+void bno055_init(bno055_t *bno, imu_raw_to_real_t *lsb)
+{
+  uint8_t v;
+
+  v = bno055_read_reg(bno, BNO055_CHIP_ID);
+  bno->available = (v == BNO055_ID);
+
+  if (!bno->available)
+  {
+    LOG_I(TAG, "dont have bno055 chip.");
+    return;
+  }
+
+  LOG_I(TAG, "bno055 chip ID: %x", v);
+
+  bno055_write_reg(bno, BNO055_OPR_MODE, BNO055_OPR_MODE_CONFIG);
+  vTaskDelay(MILLIS_TO_TICKS(25));
+  bno055_write_reg(bno, BNO055_PAGE_ID, 0);
+  bno055_write_reg(bno, BNO055_PWR_MODE, BNO055_PWR_MODE_NORMAL);
+  bno055_write_reg(bno, BNO055_UNIT_SEL, BNO055_UNIT_SEL_MG);
+
+  lsb->accel_lsb = BNO055_ACCEL_LSB;
+  lsb->gyro_lsb = BNO055_GYRO_LSB;
+  lsb->mag_lsb = BNO055_MAG_LSB;
+}
+
+bool bno055_set_alignment(bno055_t *bno, imu_board_align_t align)
+{
+  uint8_t source[3];
+  bool negate[3];
+
+  imu_board_align_axes(align, source, negate);
+
+  // Odd permutations and odd sign flips each mirror the axes
+  bool odd_permutation = source[1] != (source[0] + 1) % 3;
+  bool odd_signs = negate[0] ^ negate[1] ^ negate[2];
+  if (odd_permutation != odd_signs)
+  {
+    LOG_E(TAG, "alignment %d is mirrored, keeping the chip's axes", align);
+    return false;
+  }
+
+  // Still in CONFIG mode from bno055_init()
+  bno055_write_reg(bno, BNO055_AXIS_MAP_CONFIG, source[0] | source[1] << 2 | source[2] << 4);
+  bno055_write_reg(bno, BNO055_AXIS_MAP_SIGN, negate[0] << 2 | negate[1] << 1 | negate[2]);
+  return true;
+}
+
+void bno055_start(bno055_t *bno)
+{
+  bno055_write_reg(bno, BNO055_OPR_MODE, BNO055_OPR_MODE_NDOF);
+  // Switching out of CONFIG takes up to 7ms
+  vTaskDelay(MILLIS_TO_TICKS(20));
+  bno->next_sample = time_micros_now();
+  memset(bno->last_data, 0, sizeof(bno->last_data));
+
+  LOG_I(TAG, "NDOF fusion started");
+}
+
+int bno055_read_sample(bno055_t *bno, imu_sensor_data_t *imu)
+{
+  uint8_t data[BNO055_DATA_SIZE];
+  time_micros_t now = time_micros_now();
+
+  // Outputs only change at BNO055_RATE_HZ, don't load the bus before then
+  if (now < bno->next_sample)
+  {
+    return 0;
+  }
+
+  if (!bno055_read_data(bno, BNO055_ACC_DATA_X_LSB, data, sizeof(data)))
+  {
+    return 0;
+  }
+
+  // No FIFO, data ready flag or sample counter. Sensor noise makes all 9 axes
+  // repeating exactly unlikely, so unchanged data is the sample we already have.
+  // Keep polling until it changes, which also follows the chip's clock drift.
+  if (memcmp(data, bno->last_data, sizeof(data)) == 0)
+  {
+    return 0;
+  }
+  memcpy(bno->last_data, data, sizeof(data));
+  bno->next_sample = now + BNO055_SAMPLE_HOLDOFF_US;
+
+  imu->accel[0] = bno055_i16(&data[0]);
+  imu->accel[1] = bno055_i16(&data[2]);
+  imu->accel[2] = bno055_i16(&data[4]);
+
+  imu->mag[0] = bno055_i16(&data[6]);
+  imu->mag[1] = bno055_i16(&data[8]);
+  imu->mag[2] = bno055_i16(&data[10]);
+  imu->mag_updated = true;
+
+  imu->gyro[0] = bno055_i16(&data[12]);
+  imu->gyro[1] = bno055_i16(&data[14]);
+  imu->gyro[2] = bno055_i16(&data[16]);
+
+  return 1;
+}
+
+bool bno055_read_orientation(bno055_t *bno, float orientation[3])
+{
+  uint8_t data[6];
+
+  if (!bno055_read_data(bno, BNO055_EUL_HEADING_LSB, data, sizeof(data)))
+  {
+    return false;
+  }
+
+  // heading, roll, pitch on the chip, roll, pitch, yaw for us
+  orientation[0] = bno055_i16(&data[2]) * BNO055_EULER_LSB;
+  orientation[1] = bno055_i16(&data[4]) * BNO055_EULER_LSB;
+  orientation[2] = bno055_i16(&data[0]) * BNO055_EULER_LSB;
+
+  return true;
+}
+
+bool bno055_self_test(bno055_t *bno)
+{
+  uint8_t v = bno055_read_reg(bno, BNO055_ST_RESULT);
+
+  LOG_I(TAG, "self test: %x, calibration: %x", v, bno055_read_reg(bno, BNO055_CALIB_STAT));
+  return (v & BNO055_ST_RESULT_OK) == BNO055_ST_RESULT_OK;
+}
@@ -0,0 +1,77 @@
+#ifndef __BNO055_DEF_H__
+#define __BNO055_DEF_H__
+
+#include "../imu.h"
+#include "io/hal_i2c.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BNO055: accel/gyro/mag with an on-chip fusion core. In NDOF mode it outputs
+// absolute orientation at 100Hz, the madgwick filter isn't needed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define BNO055_I2C_ADDR             0x28
+#define BNO055_ID                   0xA0
+
+/* Page 0 registers */
+#define BNO055_CHIP_ID              0x00
+#define BNO055_PAGE_ID              0x07
+#define BNO055_ACC_DATA_X_LSB       0x08
+#define BNO055_EUL_HEADING_LSB      0x1A
+#define BNO055_TEMP                 0x34
+#define BNO055_CALIB_STAT           0x35
+#define BNO055_ST_RESULT            0x36
+#define BNO055_SYS_STATUS           0x39
+#define BNO055_UNIT_SEL             0x3B
+#define BNO055_OPR_MODE             0x3D
+#define BNO055_PWR_MODE             0x3E
+#define BNO055_SYS_TRIGGER          0x3F
+#define BNO055_AXIS_MAP_CONFIG      0x41
+#define BNO055_AXIS_MAP_SIGN        0x42
+
+#define BNO055_OPR_MODE_CONFIG      0x00
+#define BNO055_OPR_MODE_NDOF        0x0C
+#define BNO055_PWR_MODE_NORMAL      0x00
+#define BNO055_SYS_TRIGGER_RST_SYS  0x20
+// Accel in mg, gyro in dps, euler in degrees, temp in celsius
+#define BNO055_UNIT_SEL_MG          0x01
+// accel, mag and gyro pass
+#define BNO055_ST_RESULT_OK         0x07
+
+// Fusion output rate in NDOF mode
+#define BNO055_RATE_HZ              100
+// After a new sample, the next one isn't looked for before this, then every poll
+#define BNO055_SAMPLE_HOLDOFF_US    (MICROS_PER_SEC / BNO055_RATE_HZ * 3 / 4)
+// accel, mag and gyro, 3 x int16 each
+#define BNO055_DATA_SIZE            18
+
+#define BNO055_ACCEL_LSB            0.001f     // 1mg per LSB
+#define BNO055_GYRO_LSB             (1 / 16.0f)
+#define BNO055_MAG_LSB              (1 / 16.0f)
+#define BNO055_EULER_LSB            (1 / 16.0f)
+
+typedef struct
+{
+    hal_i2c_config_t *i2c_cfg;
+    uint8_t addr;
+    time_micros_t next_sample;
+    // Raw data of the last sample returned, to tell new samples from repeats
+    uint8_t last_data[BNO055_DATA_SIZE];
+    bool available;
+} bno055_t;
+
+extern void bno055_init(bno055_t *bno, imu_raw_to_real_t *lsb);
+// Remaps the chip's axes to the board alignment, raw data and fusion both follow.
+// Call before bno055_start(). Returns false for mirrored alignments, the chip
+// only takes right handed remaps.
+extern bool bno055_set_alignment(bno055_t *bno, imu_board_align_t align);
+// Switches to NDOF fusion mode
+extern void bno055_start(bno055_t *bno);
+// Reads one sample if the chip has a new one, returns how many were read
+extern int bno055_read_sample(bno055_t *bno, imu_sensor_data_t *imu);
+extern bool bno055_read_orientation(bno055_t *bno, float orientation[3]);
+// Result of the power on self test
+extern bool bno055_self_test(bno055_t *bno);
+
+#endif /* !__BNO055_DEF_H__ */
@@ -0,0 +1,229 @@
+#include <hal/log.h>
+#include <hal/err.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "icm20948.h"
+#include "util/macros.h"
+
+const static char *TAG = "icm20948";
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// private utilities
+//
+////////////////////////////////////////////////////////////////////////////////
+static bool icm20948_handle_error(icm20948_t *icm, hal_err_t err, const char *what)
+{
+  hal_i2c_cmd_give(icm->i2c_cfg->i2c_bus);
+  if (err != HAL_ERR_NONE)
+  {
+    LOG_E(TAG, "%s: %d", what, err);
+    return false;
+  }
+  return true;
+}
+
+static void icm20948_write_raw(icm20948_t *icm, uint8_t reg, uint8_t data)
+{
+  uint8_t buffer[2] = {reg, data};
+
+  hal_i2c_cmd_take(icm->i2c_cfg->i2c_bus);
+  icm20948_handle_error(icm, hal_i2c_write(icm->i2c_cfg->i2c_bus, icm->addr, buffer, 2), "write");
+}
+
+static void icm20948_select_bank(icm20948_t *icm, uint8_t bank)
+{
+  // Bank 0 is the one used while sampling, don't rewrite it every read
+  if (icm->bank != bank)
+  {
+    icm20948_write_raw(icm, ICM20948_REG_BANK_SEL, ICM20948_BANK(bank));
+    icm->bank = bank;
+  }
+}
+
+static void icm20948_write_reg(icm20948_t *icm, uint8_t bank, uint8_t reg, uint8_t data)
+{
+  icm20948_select_bank(icm, bank);
+  icm20948_write_raw(icm, reg, data);
+}
+
+static bool icm20948_read_data(icm20948_t *icm, uint8_t bank, uint8_t reg, uint8_t *data, uint16_t len)
+{
+  icm20948_select_bank(icm, bank);
+  hal_i2c_cmd_take(icm->i2c_cfg->i2c_bus);
+  return icm20948_handle_error(icm, hal_i2c_write_then_read(icm->i2c_cfg->i2c_bus, icm->addr, &reg, 1, data, len), "read");
+}
+
+static uint8_t icm20948_read_reg(icm20948_t *icm, uint8_t bank, uint8_t reg)
+{
+  uint8_t ret = 0;
+
+  icm20948_read_data(icm, bank, reg, &ret, 1);
+  return ret;
+}
+
+// Single register access to the AK09916 through I2C master slave 4
+static uint8_t ak09916_transfer(icm20948_t *icm, uint8_t reg, bool read, uint8_t data)
+{
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV4_ADDR, (read ? ICM20948_I2C_SLV_READ : 0) | AK09916_I2C_ADDR);
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV4_REG, reg);
+  if (!read)
+  {
+    icm20948_write_reg(icm, 3, ICM20948_I2C_SLV4_DO, data);
+  }
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV4_CTRL, ICM20948_I2C_SLV_EN);
+  // Runs at the next sample, plenty of time even at the slowest ODR
+  vTaskDelay(MILLIS_TO_TICKS(10));
+  return read ? icm20948_read_reg(icm, 3, ICM20948_I2C_SLV4_DI) : 0;
+}
+
+static void icm20948_parse_sample(const uint8_t *data, imu_sensor_data_t *imu)
+{
+  imu->accel[0] = (int16_t)(data[0] << 8 | data[1]);
+  imu->accel[1] = (int16_t)(data[2] << 8 | data[3]);
+  imu->accel[2] = (int16_t)(data[4] << 8 | data[5]);
+
+  imu->gyro[0] = (int16_t)(data[6] << 8 | data[7]);
+  imu->gyro[1] = (int16_t)(data[8] << 8 | data[9]);
+  imu->gyro[2] = (int16_t)(data[10] << 8 | data[11]);
+
+  imu->temp = (data[12] << 8 | data[13]);
+
+  // ST1, HXL..HZH, TMPS, ST2
+  imu->mag_updated = false;
+  if ((data[14] & AK09916_ST1_DRDY) && !(data[22] & AK09916_ST2_HOFL))
+  {
+    int16_t mx = (int16_t)(data[16] << 8 | data[15]);
+    int16_t my = (int16_t)(data[18] << 8 | data[17]);
+    int16_t mz = (int16_t)(data[20] << 8 | data[19]);
+
+    // AK09916 axes are x, -y, -z of the accel. Rotate them into the AK8963
+    // frame (y, x, -z), so board alignment works the same as with the MPU9250.
+    imu->mag[0] = -my;
+    imu->mag[1] = mx;
+    imu->mag[2] = mz;
+    imu->mag_updated = true;
+  }
+}
+
+static void icm20948_fifo_reset(icm20948_t *icm)
+{
+  icm20948_write_reg(icm, 0, ICM20948_FIFO_RST, ICM20948_FIFO_RST_ALL);
+  icm20948_write_reg(icm, 0, ICM20948_FIFO_RST, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// public utilities
+//
+////////////////////////////////////////////////////////////////////////////////
+void icm20948_init(icm20948_t *icm, imu_raw_to_real_t *lsb)
+{
+  uint8_t v;
+
+  // Unknown after a warm boot, force the first select
+  icm->bank = 0xFF;
+
+  v = icm20948_read_reg(icm, 0, ICM20948_WHO_AM_I);
+  icm->available = (v == ICM20948_ID);
+
+  if (!icm->available)
+  {
+    LOG_I(TAG, "dont have icm20948 chip.");
+    return;
+  }
+
+  LOG_I(TAG, "icm20948 chip ID: %x", v);
+
+  icm20948_write_reg(icm, 0, ICM20948_PWR_MGMT_1, ICM20948_PWR_MGMT_1_RESET);
+  vTaskDelay(MILLIS_TO_TICKS(100));
+  icm->bank = 0xFF;
+  icm20948_write_reg(icm, 0, ICM20948_PWR_MGMT_1, ICM20948_PWR_MGMT_1_CLK_AUTO);
+  icm20948_write_reg(icm, 0, ICM20948_PWR_MGMT_2, 0x00);
+
+  icm20948_write_reg(icm, 2, ICM20948_GYRO_CONFIG_1, ICM20948_GYRO_FS_1000 | ICM20948_GYRO_DLPF_51HZ);
+  icm20948_write_reg(icm, 2, ICM20948_ACCEL_CONFIG, ICM20948_ACCEL_FS_8G | ICM20948_ACCEL_DLPF_50HZ);
+
+  // The AK09916 is only reachable through the I2C master
+  icm20948_write_reg(icm, 0, ICM20948_USER_CTRL, ICM20948_USER_CTRL_I2C_MST_EN);
+  icm20948_write_reg(icm, 3, ICM20948_I2C_MST_CTRL, ICM20948_I2C_MST_CLK_400KHZ);
+
+  v = ak09916_transfer(icm, AK09916_WIA2, true, 0);
+  LOG_I(TAG, "ak09916 chip ID: %x", v);
+  ak09916_transfer(icm, AK09916_CNTL2, false, AK09916_CNTL2_100HZ);
+
+  lsb->accel_lsb = 1.0f / ICM20948_ACCE_SENS_8;
+  lsb->gyro_lsb = 1.0f / ICM20948_GYRO_SENS_1000;
+  lsb->mag_lsb = AK09916_MAG_LSB;
+}
+
+uint16_t icm20948_fifo_enable(icm20948_t *icm, uint16_t sample_rate_hz)
+{
+  uint16_t div = ICM20948_INTERNAL_RATE_HZ / sample_rate_hz - 1;
+
+  icm20948_write_reg(icm, 2, ICM20948_GYRO_SMPLRT_DIV, div);
+  icm20948_write_reg(icm, 2, ICM20948_ACCEL_SMPLRT_DIV_1, div >> 8);
+  icm20948_write_reg(icm, 2, ICM20948_ACCEL_SMPLRT_DIV_2, div & 0xFF);
+
+  // Mag read into EXT_SLV_SENS_DATA on every sample, it goes into the FIFO with the rest
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV0_ADDR, ICM20948_I2C_SLV_READ | AK09916_I2C_ADDR);
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV0_REG, AK09916_ST1);
+  icm20948_write_reg(icm, 3, ICM20948_I2C_SLV0_CTRL, ICM20948_I2C_SLV_EN | ICM20948_FIFO_MAG_SIZE);
+
+  icm20948_write_reg(icm, 0, ICM20948_FIFO_EN_1, ICM20948_FIFO_EN_1_SLV0);
+  icm20948_write_reg(icm, 0, ICM20948_FIFO_EN_2, ICM20948_FIFO_EN_2_ACCEL | ICM20948_FIFO_EN_2_GYRO | ICM20948_FIFO_EN_2_TEMP);
+  icm20948_write_reg(icm, 0, ICM20948_USER_CTRL, ICM20948_USER_CTRL_I2C_MST_EN | ICM20948_USER_CTRL_FIFO_EN);
+  icm20948_fifo_reset(icm);
+
+  icm20948_write_reg(icm, 0, ICM20948_INT_PIN_CFG, ICM20948_INT_PIN_CFG_ANYRD_2CLEAR);
+  icm20948_write_reg(icm, 0, ICM20948_INT_ENABLE_1, ICM20948_INT_RAW_DATA_0_RDY_EN);
+
+  sample_rate_hz = ICM20948_INTERNAL_RATE_HZ / (div + 1);
+  LOG_I(TAG, "FIFO enabled at %dHz", sample_rate_hz);
+  return sample_rate_hz;
+}
+
+int icm20948_read_fifo(icm20948_t *icm, imu_sensor_data_t *samples, int max_samples)
+{
+  uint8_t data[ICM20948_FIFO_SAMPLE_SIZE * ICM20948_FIFO_MAX_BURST];
+  uint8_t count_data[2];
+
+  if (!icm20948_read_data(icm, 0, ICM20948_FIFO_COUNTH, count_data, 2))
+  {
+    return 0;
+  }
+  uint16_t count = ((count_data[0] & 0x1F) << 8) | count_data[1];
+
+  if (count >= ICM20948_FIFO_SIZE || count % ICM20948_FIFO_SAMPLE_SIZE != 0)
+  {
+    LOG_D(TAG, "FIFO overflow (%d bytes), resetting", count);
+    icm20948_fifo_reset(icm);
+    return -1;
+  }
+
+  int n = count / ICM20948_FIFO_SAMPLE_SIZE;
+  n = MIN(n, MIN(max_samples, ICM20948_FIFO_MAX_BURST));
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  if (!icm20948_read_data(icm, 0, ICM20948_FIFO_R_W, data, n * ICM20948_FIFO_SAMPLE_SIZE))
+  {
+    return 0;
+  }
+
+  for (int ii = 0; ii < n; ii++)
+  {
+    icm20948_parse_sample(&data[ii * ICM20948_FIFO_SAMPLE_SIZE], &samples[ii]);
+  }
+
+  return n;
+}
+
+bool icm20948_self_test(icm20948_t *icm)
+{
+  return icm20948_read_reg(icm, 0, ICM20948_WHO_AM_I) == ICM20948_ID;
+}
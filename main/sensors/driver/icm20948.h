@@ -0,0 +1,110 @@
+#ifndef __ICM_20948_DEF_H__
+#define __ICM_20948_DEF_H__
+
+#include "../imu.h"
+#include "io/hal_i2c.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ICM-20948: MPU9250 successor, registers are split in 4 banks selected by
+// REG_BANK_SEL. Its AK09916 mag sits behind the internal I2C master.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define ICM20948_I2C_ADDR             0x68
+#define ICM20948_ID                   0xEA
+
+#define ICM20948_REG_BANK_SEL         0x7F
+#define ICM20948_BANK(b)              ((b) << 4)
+
+/* Bank 0 */
+#define ICM20948_WHO_AM_I             0x00
+#define ICM20948_USER_CTRL            0x03
+#define ICM20948_PWR_MGMT_1           0x06
+#define ICM20948_PWR_MGMT_2           0x07
+#define ICM20948_INT_PIN_CFG          0x0F
+#define ICM20948_INT_ENABLE_1         0x11
+#define ICM20948_ACCEL_XOUT_H         0x2D
+#define ICM20948_FIFO_EN_1            0x66
+#define ICM20948_FIFO_EN_2            0x67
+#define ICM20948_FIFO_RST             0x68
+#define ICM20948_FIFO_MODE            0x69
+#define ICM20948_FIFO_COUNTH          0x70
+#define ICM20948_FIFO_R_W             0x72
+
+/* Bank 2 */
+#define ICM20948_GYRO_SMPLRT_DIV      0x00
+#define ICM20948_GYRO_CONFIG_1        0x01
+#define ICM20948_ACCEL_SMPLRT_DIV_1   0x10
+#define ICM20948_ACCEL_SMPLRT_DIV_2   0x11
+#define ICM20948_ACCEL_CONFIG         0x14
+
+/* Bank 3 */
+#define ICM20948_I2C_MST_CTRL         0x01
+#define ICM20948_I2C_SLV0_ADDR        0x03
+#define ICM20948_I2C_SLV0_REG         0x04
+#define ICM20948_I2C_SLV0_CTRL        0x05
+#define ICM20948_I2C_SLV4_ADDR        0x13
+#define ICM20948_I2C_SLV4_REG         0x14
+#define ICM20948_I2C_SLV4_CTRL        0x15
+#define ICM20948_I2C_SLV4_DO          0x16
+#define ICM20948_I2C_SLV4_DI          0x17
+
+#define ICM20948_PWR_MGMT_1_RESET     0x80
+#define ICM20948_PWR_MGMT_1_CLK_AUTO  0x01
+#define ICM20948_USER_CTRL_FIFO_EN    0x40
+#define ICM20948_USER_CTRL_I2C_MST_EN 0x20
+#define ICM20948_INT_PIN_CFG_ANYRD_2CLEAR 0x10
+#define ICM20948_INT_RAW_DATA_0_RDY_EN 0x01
+#define ICM20948_FIFO_EN_1_SLV0       0x01
+#define ICM20948_FIFO_EN_2_ACCEL      0x10
+#define ICM20948_FIFO_EN_2_GYRO       0x0E
+#define ICM20948_FIFO_EN_2_TEMP       0x01
+#define ICM20948_FIFO_RST_ALL         0x1F
+#define ICM20948_GYRO_FS_1000         (0x02 << 1)
+#define ICM20948_GYRO_DLPF_51HZ       ((0x03 << 3) | 0x01)
+#define ICM20948_ACCEL_FS_8G          (0x02 << 1)
+#define ICM20948_ACCEL_DLPF_50HZ      ((0x03 << 3) | 0x01)
+#define ICM20948_I2C_MST_CLK_400KHZ   0x07
+#define ICM20948_I2C_SLV_READ         0x80
+#define ICM20948_I2C_SLV_EN           0x80
+
+// Gyro and accel ODR is this divided by SMPLRT_DIV + 1
+#define ICM20948_INTERNAL_RATE_HZ     1125
+#define ICM20948_FIFO_SIZE            512
+// AK09916 ST1..ST2, read by the I2C master on every sample
+#define ICM20948_FIFO_MAG_SIZE        9
+// accel, gyro, temp and mag, in register order
+#define ICM20948_FIFO_SAMPLE_SIZE     (14 + ICM20948_FIFO_MAG_SIZE)
+#define ICM20948_FIFO_MAX_BURST       16
+
+#define ICM20948_GYRO_SENS_1000       ((float) 32.8)
+#define ICM20948_ACCE_SENS_8          ((float) 4096)
+
+#define AK09916_I2C_ADDR              0x0C
+#define AK09916_WIA2                  0x01
+#define AK09916_ID                    0x09
+#define AK09916_ST1                   0x10
+#define AK09916_CNTL2                 0x31
+#define AK09916_CNTL2_100HZ           0x08
+#define AK09916_ST1_DRDY              0x01
+#define AK09916_ST2_HOFL              0x08
+#define AK09916_MAG_LSB               0.15f     // 0.15uT per LSB
+
+typedef struct
+{
+    hal_i2c_config_t *i2c_cfg;
+    uint8_t addr;
+    uint8_t bank;
+    bool available;
+} icm20948_t;
+
+extern void icm20948_init(icm20948_t *icm, imu_raw_to_real_t *lsb);
+// Samples accel/gyro/temp/mag into the FIFO, returns the actual rate
+extern uint16_t icm20948_fifo_enable(icm20948_t *icm, uint16_t sample_rate_hz);
+// Same contract as mpu9250_read_fifo()
+extern int icm20948_read_fifo(icm20948_t *icm, imu_sensor_data_t *samples, int max_samples);
+// Checks the chip still answers with its ID
+extern bool icm20948_self_test(icm20948_t *icm);
+
+#endif /* !__ICM_20948_DEF_H__ */
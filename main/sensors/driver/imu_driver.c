@@ -0,0 +1,219 @@
+#include <hal/log.h>
+#include <hal/err.h>
+
+#include "imu_driver.h"
+#include "mpu9250.h"
+#include "icm20948.h"
+#include "bno055.h"
+#include "util/macros.h"
+
+const static char *TAG = "imu_driver";
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MPU9250
+//
+////////////////////////////////////////////////////////////////////////////////
+static mpu9250_t _mpu9250;
+
+static bool imu_driver_mpu9250_init(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb)
+{
+  _mpu9250.mpu9250_i2c_cfg.i2c_cfg = i2c_cfg;
+  _mpu9250.mpu9250_i2c_cfg.rst = HAL_GPIO_NONE;
+  _mpu9250.mpu9250_i2c_cfg.addr = MPU9250_I2C_ADDR;
+  _mpu9250.mpu9250_i2c_cfg.ak8963_addr = AK8963_I2C_ADDR;
+
+  mpu9250_init(&_mpu9250, MPU9250_Accelerometer_8G, MPU9250_Gyroscope_1000s, lsb);
+  return mpu9250_is_available(&_mpu9250);
+}
+
+static uint16_t imu_driver_mpu9250_start(uint16_t sample_rate_hz)
+{
+  mpu9250_fifo_enable(&_mpu9250, sample_rate_hz);
+  return MPU9250_INTERNAL_RATE_HZ / (MPU9250_INTERNAL_RATE_HZ / sample_rate_hz);
+}
+
+static int imu_driver_mpu9250_read_burst(imu_sensor_data_t *samples, int max_samples)
+{
+  return mpu9250_read_fifo(&_mpu9250, samples, max_samples);
+}
+
+static bool imu_driver_mpu9250_self_test(void)
+{
+  return mpu9250_self_test(&_mpu9250);
+}
+
+const imu_driver_t imu_driver_mpu9250 = {
+    .name = "MPU9250",
+    .addr = MPU9250_I2C_ADDR,
+    .id_reg = MPU9250_WHO_AM_I,
+    .id = MPU9250_ID,
+    .fused = false,
+    .fifo = true,
+    .init = imu_driver_mpu9250_init,
+    .set_alignment = NULL,
+    .start = imu_driver_mpu9250_start,
+    .read_burst = imu_driver_mpu9250_read_burst,
+    // The mag comes through the FIFO
+    .read_mag = NULL,
+    .read_orientation = NULL,
+    .self_test = imu_driver_mpu9250_self_test,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ICM-20948
+//
+////////////////////////////////////////////////////////////////////////////////
+static icm20948_t _icm20948;
+
+static bool imu_driver_icm20948_init(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb)
+{
+  _icm20948.i2c_cfg = i2c_cfg;
+  _icm20948.addr = ICM20948_I2C_ADDR;
+
+  icm20948_init(&_icm20948, lsb);
+  return _icm20948.available;
+}
+
+static uint16_t imu_driver_icm20948_start(uint16_t sample_rate_hz)
+{
+  return icm20948_fifo_enable(&_icm20948, sample_rate_hz);
+}
+
+static int imu_driver_icm20948_read_burst(imu_sensor_data_t *samples, int max_samples)
+{
+  return icm20948_read_fifo(&_icm20948, samples, max_samples);
+}
+
+static bool imu_driver_icm20948_self_test(void)
+{
+  return icm20948_self_test(&_icm20948);
+}
+
+const imu_driver_t imu_driver_icm20948 = {
+    .name = "ICM-20948",
+    .addr = ICM20948_I2C_ADDR,
+    .id_reg = ICM20948_WHO_AM_I,
+    .id = ICM20948_ID,
+    .fused = false,
+    .fifo = true,
+    .init = imu_driver_icm20948_init,
+    .set_alignment = NULL,
+    .start = imu_driver_icm20948_start,
+    .read_burst = imu_driver_icm20948_read_burst,
+    .read_mag = NULL,
+    .read_orientation = NULL,
+    .self_test = imu_driver_icm20948_self_test,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BNO055
+//
+////////////////////////////////////////////////////////////////////////////////
+static bno055_t _bno055;
+
+static bool imu_driver_bno055_init(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb)
+{
+  _bno055.i2c_cfg = i2c_cfg;
+  _bno055.addr = BNO055_I2C_ADDR;
+
+  bno055_init(&_bno055, lsb);
+  return _bno055.available;
+}
+
+static bool imu_driver_bno055_set_alignment(imu_board_align_t align)
+{
+  return bno055_set_alignment(&_bno055, align);
+}
+
+static uint16_t imu_driver_bno055_start(uint16_t sample_rate_hz)
+{
+  bno055_start(&_bno055);
+  return BNO055_RATE_HZ;
+}
+
+static int imu_driver_bno055_read_burst(imu_sensor_data_t *samples, int max_samples)
+{
+  return max_samples > 0 ? bno055_read_sample(&_bno055, &samples[0]) : 0;
+}
+
+static bool imu_driver_bno055_read_orientation(float orientation[3])
+{
+  return bno055_read_orientation(&_bno055, orientation);
+}
+
+static bool imu_driver_bno055_self_test(void)
+{
+  return bno055_self_test(&_bno055);
+}
+
+const imu_driver_t imu_driver_bno055 = {
+    .name = "BNO055",
+    .addr = BNO055_I2C_ADDR,
+    .id_reg = BNO055_CHIP_ID,
+    .id = BNO055_ID,
+    .fused = true,
+    .fifo = false,
+    .init = imu_driver_bno055_init,
+    .set_alignment = imu_driver_bno055_set_alignment,
+    .start = imu_driver_bno055_start,
+    .read_burst = imu_driver_bno055_read_burst,
+    .read_mag = NULL,
+    .read_orientation = imu_driver_bno055_read_orientation,
+    .self_test = imu_driver_bno055_self_test,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// probing
+//
+////////////////////////////////////////////////////////////////////////////////
+static const imu_driver_t *_drivers[] = {
+    &imu_driver_mpu9250,
+    &imu_driver_icm20948,
+    &imu_driver_bno055,
+};
+
+// Plain ID read, a missing part must not leave the bus in the driver's error state
+static bool imu_driver_check_id(hal_i2c_config_t *i2c_cfg, const imu_driver_t *driver)
+{
+  uint8_t reg = driver->id_reg;
+  uint8_t id = 0;
+
+  hal_i2c_cmd_take(i2c_cfg->i2c_bus);
+  hal_err_t err = hal_i2c_write_then_read(i2c_cfg->i2c_bus, driver->addr, &reg, 1, &id, 1);
+  hal_i2c_cmd_give(i2c_cfg->i2c_bus);
+
+  return err == HAL_ERR_NONE && id == driver->id;
+}
+
+const imu_driver_t *imu_driver_probe(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb)
+{
+  if (!i2c_cfg->is_init)
+  {
+    hal_i2c_init(i2c_cfg);
+  }
+
+  for (int ii = 0; ii < ARRAY_COUNT(_drivers); ii++)
+  {
+    const imu_driver_t *driver = _drivers[ii];
+
+    if (!imu_driver_check_id(i2c_cfg, driver))
+    {
+      continue;
+    }
+
+    LOG_I(TAG, "found %s", driver->name);
+
+    if (driver->init(i2c_cfg, lsb))
+    {
+      return driver;
+    }
+    LOG_E(TAG, "%s failed to initialize", driver->name);
+  }
+
+  LOG_I(TAG, "no IMU found");
+  return NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef __IMU_DRIVER_DEF_H__
+#define __IMU_DRIVER_DEF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../imu.h"
+#include "io/hal_i2c.h"
+
+// Most samples read_burst() is asked for at once
+#define IMU_DRIVER_MAX_BURST 16
+
+// Each supported part, imu_driver_probe() tries them in this order
+typedef struct imu_driver_s
+{
+    const char *name;
+    // Answers id on id_reg at addr, checked before init
+    uint8_t addr;
+    uint8_t id_reg;
+    uint8_t id;
+    // The part fuses orientation itself, read_orientation() replaces the filter
+    bool fused;
+    // Samples are queued in a FIFO at the rate start() returned. Otherwise
+    // read_burst() returns the current sample, taken at the read time, and 0
+    // until the part has a new one.
+    bool fifo;
+
+    bool (*init)(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb);
+    // Only for fused parts, NULL otherwise. Remaps the part's axes to the board
+    // alignment before start(), so raw data and orientation both follow it.
+    // Returns false if the part can't take that alignment.
+    bool (*set_alignment)(imu_board_align_t align);
+    // Starts sampling as close to sample_rate_hz as the part allows, returns the actual rate
+    uint16_t (*start)(uint16_t sample_rate_hz);
+    // Reads up to max_samples in one burst. Returns how many were read, -1 if samples were lost.
+    int (*read_burst)(imu_sensor_data_t *samples, int max_samples);
+    // Only for parts whose mag doesn't come with read_burst(), NULL otherwise
+    bool (*read_mag)(imu_sensor_data_t *imu);
+    // roll, pitch and yaw in degrees, only for fused parts
+    bool (*read_orientation)(float orientation[3]);
+    bool (*self_test)(void);
+} imu_driver_t;
+
+extern const imu_driver_t imu_driver_mpu9250;
+extern const imu_driver_t imu_driver_icm20948;
+extern const imu_driver_t imu_driver_bno055;
+
+// Returns the first known part answering on the bus, already initialized. NULL if there's none.
+extern const imu_driver_t *imu_driver_probe(hal_i2c_config_t *i2c_cfg, imu_raw_to_real_t *lsb);
+
+#endif /* !__IMU_DRIVER_DEF_H__ */
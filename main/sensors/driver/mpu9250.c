@@ -1,7 +1,9 @@
 #include <hal/log.h>
+#include <hal/err.h>
 #include "mpu9250.h"
 #include "mpu9250_i2c.h"
 #include "sdkconfig.h"
+#include "util/macros.h"
 
 const static char *TAG = "mpu9250";
 
@@ -57,31 +59,19 @@ static inline uint8_t mpu9250_read_reg(mpu9250_t *mpu9250, uint8_t reg)
 {
   uint8_t ret = 0;
 
-  if (mpu9250_i2c_write(&mpu9250->mpu9250_i2c_cfg, &reg, 1) == false)
+  if (mpu9250_i2c_read_reg(&mpu9250->mpu9250_i2c_cfg, reg, &ret, 1) == false)
   {
-    LOG_E(TAG, "mpu9250_read_reg: failed to mpu9250_i2c_write");
-    return ret;
-  }
-
-  if (mpu9250_i2c_read(&mpu9250->mpu9250_i2c_cfg, &ret, 1) == false)
-  {
-    LOG_E(TAG, "mpu9250_read_reg: failed to mpu9250_i2c_read");
+    LOG_E(TAG, "mpu9250_read_reg: failed to mpu9250_i2c_read_reg");
   }
 
   return ret;
 }
 
-static inline void mpu9250_read_data(mpu9250_t *mpu9250, uint8_t reg, uint8_t *data, uint8_t len)
+static inline void mpu9250_read_data(mpu9250_t *mpu9250, uint8_t reg, uint8_t *data, uint16_t len)
 {
-  if (mpu9250_i2c_write(&mpu9250->mpu9250_i2c_cfg, &reg, 1) == false)
+  if (mpu9250_i2c_read_reg(&mpu9250->mpu9250_i2c_cfg, reg, data, len) == false)
   {
-    LOG_E(TAG, "mpu9250_read_data: failed to mpu9250_i2c_write");
-    return;
-  }
-
-  if (mpu9250_i2c_read(&mpu9250->mpu9250_i2c_cfg, data, len) == false)
-  {
-    LOG_E(TAG, "mpu9250_read_data: failed to mpu9250_i2c_read");
+    LOG_E(TAG, "mpu9250_read_data: failed to mpu9250_i2c_read_reg");
   }
 }
 
@@ -89,15 +79,9 @@ static inline uint8_t ak8963_read_reg(mpu9250_t *mpu9250, uint8_t reg)
 {
   uint8_t ret = 0;
 
-  if (ak8963_i2c_write(&mpu9250->mpu9250_i2c_cfg, &reg, 1) == false)
+  if (ak8963_i2c_read_reg(&mpu9250->mpu9250_i2c_cfg, reg, &ret, 1) == false)
   {
-    LOG_E(TAG, "ak8963_read_reg: failed to mpu9250_i2c_write");
-    return ret;
-  }
-
-  if (ak8963_i2c_read(&mpu9250->mpu9250_i2c_cfg, &ret, 1) == false)
-  {
-    LOG_E(TAG, "ak8963_read_reg: failed to mpu9250_i2c_read");
+    LOG_E(TAG, "ak8963_read_reg: failed to ak8963_i2c_read_reg");
   }
   return ret;
 }
@@ -115,17 +99,11 @@ static inline void ak8963_write_reg(mpu9250_t *mpu9250, uint8_t reg, uint8_t dat
   }
 }
 
-static inline void ak8963_read_data(mpu9250_t *mpu9250, uint8_t reg, uint8_t *data, uint8_t len)
+static inline void ak8963_read_data(mpu9250_t *mpu9250, uint8_t reg, uint8_t *data, uint16_t len)
 {
-  if (ak8963_i2c_write(&mpu9250->mpu9250_i2c_cfg, &reg, 1) == false)
-  {
-    LOG_E(TAG, "ak8963_read_data: failed to mpu9250_i2c_write");
-    return;
-  }
-
-  if (ak8963_i2c_read(&mpu9250->mpu9250_i2c_cfg, data, len) == false)
+  if (ak8963_i2c_read_reg(&mpu9250->mpu9250_i2c_cfg, reg, data, len) == false)
   {
-    LOG_E(TAG, "ak8963_read_data: failed to mpu9250_i2c_read");
+    LOG_E(TAG, "ak8963_read_data: failed to ak8963_i2c_read_reg");
   }
 }
 
@@ -145,20 +123,30 @@ static void ak8963_init(mpu9250_t *mpu9250)
   LOG_I(TAG, "ak8963 control reg: %x", v);
 }
 
+// data starts at HXL and ends with ST2
+static void ak8963_parse_mag(const uint8_t *data, imu_sensor_data_t *imu)
+{
+  // Overflowed measurements are discarded
+  if (!(data[6] & AK8963_ST2_HOFL))
+  {
+    imu->mag[0] = (int16_t)(data[1] << 8 | data[0]);
+    imu->mag[1] = (int16_t)(data[3] << 8 | data[2]);
+    imu->mag[2] = (int16_t)(data[5] << 8 | data[4]);
+    imu->mag_updated = true;
+  }
+}
+
 static void ak8963_read_all(mpu9250_t *mpu9250, imu_sensor_data_t *imu)
 {
   uint8_t data[7];
 
-  if(ak8963_read_reg(mpu9250, AK8963_ST1) & 0x01) 
+  imu->mag_updated = false;
+
+  if(ak8963_read_reg(mpu9250, AK8963_ST1) & AK8963_ST1_DRDY) 
   {
     ak8963_read_data(mpu9250, AK8963_HXL, data, 7);
     //printf("[0][%d]    [1][%d]\r\n", data[0], data[1]);
-    uint8_t c = data[6];
-    if(!(c & 0x08)) { 
-      imu->mag[0] = (int16_t)(data[1] << 8 | data[0]);
-      imu->mag[1] = (int16_t)(data[3] << 8 | data[2]);
-      imu->mag[2] = (int16_t)(data[5] << 8 | data[4]);
-    }
+    ak8963_parse_mag(data, imu);
   }
 }
 
@@ -178,7 +166,7 @@ void mpu9250_init(mpu9250_t *mpu9250,
 
   v = mpu9250_read_reg(mpu9250, MPU9250_WHO_AM_I);
   
-  mpu9250->available = (v == 0x71);
+  mpu9250->available = (v == MPU9250_ID);
 
   if (!mpu9250->available)
   {
@@ -231,6 +219,96 @@ bool mpu9250_read_gyro_accel(mpu9250_t *mpu9250, imu_sensor_data_t *imu)
   return true;
 }
 
+static void mpu9250_parse_sample(const uint8_t *data, imu_sensor_data_t *imu)
+{
+  imu->accel[0] = (int16_t)(data[0] << 8 | data[1]);
+  imu->accel[1] = (int16_t)(data[2] << 8 | data[3]);
+  imu->accel[2] = (int16_t)(data[4] << 8 | data[5]);
+
+  imu->temp = (data[6] << 8 | data[7]);
+
+  imu->gyro[0] = (int16_t)(data[8] << 8 | data[9]);
+  imu->gyro[1] = (int16_t)(data[10] << 8 | data[11]);
+  imu->gyro[2] = (int16_t)(data[12] << 8 | data[13]);
+
+  // ST1 is read along with every sample, DRDY is only set once per new measurement
+  imu->mag_updated = false;
+  if (data[14] & AK8963_ST1_DRDY)
+  {
+    ak8963_parse_mag(&data[15], imu);
+  }
+}
+
+static void mpu9250_fifo_reset(mpu9250_t *mpu9250)
+{
+  mpu9250_write_reg(mpu9250, MPU9250_USER_CTRL, MPU9250_USER_CTRL_I2C_MST_EN | MPU9250_USER_CTRL_FIFO_RST);
+  mpu9250_write_reg(mpu9250, MPU9250_USER_CTRL, MPU9250_USER_CTRL_I2C_MST_EN | MPU9250_USER_CTRL_FIFO_EN);
+}
+
+void mpu9250_fifo_enable(mpu9250_t *mpu9250, uint16_t sample_rate_hz)
+{
+  // SMPLRT_DIV only applies with the DLPF on
+  mpu9250_write_reg(mpu9250, MPU9250_CONFIG, MPU9250_CONFIG_DLPF_41HZ);
+  mpu9250_write_reg(mpu9250, MPU9250_SMPLRT_DIV, MPU9250_INTERNAL_RATE_HZ / sample_rate_hz - 1);
+
+  // The AK8963 is already set up through the bypass, from now on the I2C master
+  // reads it into EXT_SENS_DATA at the sample rate and it's no longer directly reachable
+  mpu9250_write_reg(mpu9250, MPU9250_INT_PIN_CFG, MPU9250_INT_PIN_CFG_ANYRD_2CLEAR);
+  mpu9250_write_reg(mpu9250, MPU9250_I2C_MST_CTRL, MPU9250_I2C_MST_CLK_400KHZ);
+  mpu9250_write_reg(mpu9250, MPU9250_I2C_SLV0_ADDR, MPU9250_I2C_SLV_READ | mpu9250->mpu9250_i2c_cfg.ak8963_addr);
+  mpu9250_write_reg(mpu9250, MPU9250_I2C_SLV0_REG, AK8963_ST1);
+  mpu9250_write_reg(mpu9250, MPU9250_I2C_SLV0_CTRL, MPU9250_I2C_SLV_EN | MPU9250_FIFO_MAG_SIZE);
+
+  mpu9250_write_reg(mpu9250, MPU9250_FIFO_EN, MPU9250_FIFO_EN_ACCEL | MPU9250_FIFO_EN_TEMP | MPU9250_FIFO_EN_GYRO | MPU9250_FIFO_EN_SLV0);
+  mpu9250_fifo_reset(mpu9250);
+
+  // INT_PIN_CFG above clears INT on any read, so the status doesn't need reading
+  mpu9250_write_reg(mpu9250, MPU9250_INT_ENABLE, MPU9250_INT_RAW_RDY_EN);
+
+  LOG_I(TAG, "FIFO enabled at %dHz", sample_rate_hz);
+}
+
+// A whole burst must fit in the length mpu9250_read_data() takes and in the FIFO itself
+_Static_assert(MPU9250_FIFO_SAMPLE_SIZE * MPU9250_FIFO_MAX_BURST <= UINT16_MAX, "FIFO burst doesn't fit a read");
+_Static_assert(MPU9250_FIFO_SAMPLE_SIZE * MPU9250_FIFO_MAX_BURST <= MPU9250_FIFO_SIZE, "FIFO burst is larger than the FIFO");
+
+int mpu9250_read_fifo(mpu9250_t *mpu9250, imu_sensor_data_t *samples, int max_samples)
+{
+  uint8_t data[MPU9250_FIFO_SAMPLE_SIZE * MPU9250_FIFO_MAX_BURST];
+  uint8_t count_data[2];
+
+  if (mpu9250_i2c_read_reg(&mpu9250->mpu9250_i2c_cfg, MPU9250_FIFO_COUNTH, count_data, sizeof(count_data)) == false)
+  {
+    LOG_E(TAG, "mpu9250_read_fifo: failed to read the FIFO count");
+    return 0;
+  }
+  uint16_t count = ((count_data[0] & 0x1F) << 8) | count_data[1];
+
+  // Once it overflows, the oldest bytes are overwritten and samples aren't aligned anymore
+  if (count >= MPU9250_FIFO_SIZE || count % MPU9250_FIFO_SAMPLE_SIZE != 0)
+  {
+    LOG_D(TAG, "FIFO overflow (%d bytes), resetting", count);
+    mpu9250_fifo_reset(mpu9250);
+    return -1;
+  }
+
+  int n = count / MPU9250_FIFO_SAMPLE_SIZE;
+  n = MIN(n, MIN(max_samples, MPU9250_FIFO_MAX_BURST));
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  mpu9250_read_data(mpu9250, MPU9250_FIFO_R_W, data, n * MPU9250_FIFO_SAMPLE_SIZE);
+
+  for (int ii = 0; ii < n; ii++)
+  {
+    mpu9250_parse_sample(&data[ii * MPU9250_FIFO_SAMPLE_SIZE], &samples[ii]);
+  }
+
+  return n;
+}
+
 bool mpu9250_read_mag(mpu9250_t *mpu9250, imu_sensor_data_t *imu)
 {
   ak8963_read_all(mpu9250, imu);
@@ -279,4 +357,10 @@ mpu9250_convert_to_eng_units(mpu9250_t* mpu9250, imu_sensor_data_t* imu)
 bool mpu9250_is_available(mpu9250_t* mpu9250)
 {
   return mpu9250->available;
+}
+
+bool mpu9250_self_test(mpu9250_t* mpu9250)
+{
+  // The AK8963 is behind the I2C master by now, its data in the FIFO says it's alive
+  return mpu9250_read_reg(mpu9250, MPU9250_WHO_AM_I) == MPU9250_ID;
 }
\ No newline at end of file
@@ -25,6 +25,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #define MPU9250_I2C_ADDR        0x68      // or 110 100x. 400Khz interface
+#define MPU9250_ID              0x71
 
 /* MPU9250 registers */
 #define MPU9250_AUX_VDDIO             0x01
@@ -45,6 +46,11 @@
 #define MPU9250_GYRO_CONFIG           0x1B
 #define MPU9250_ACCEL_CONFIG          0x1C
 #define MPU9250_MOTION_THRESH         0x1F
+#define MPU9250_FIFO_EN               0x23
+#define MPU9250_I2C_MST_CTRL          0x24
+#define MPU9250_I2C_SLV0_ADDR         0x25
+#define MPU9250_I2C_SLV0_REG          0x26
+#define MPU9250_I2C_SLV0_CTRL         0x27
 #define MPU9250_INT_PIN_CFG           0x37
 #define MPU9250_INT_ENABLE            0x38
 #define MPU9250_INT_STATUS            0x3A
@@ -62,6 +68,7 @@
 #define MPU9250_GYRO_YOUT_L           0x46
 #define MPU9250_GYRO_ZOUT_H           0x47
 #define MPU9250_GYRO_ZOUT_L           0x48
+#define MPU9250_EXT_SENS_DATA_00      0x49
 #define MPU9250_MOT_DETECT_STATUS     0x61
 #define MPU9250_SIGNAL_PATH_RESET     0x68
 #define MPU9250_MOT_DETECT_CTRL       0x69
@@ -72,6 +79,31 @@
 #define MPU9250_FIFO_COUNTL           0x73
 #define MPU9250_FIFO_R_W              0x74
 #define MPU9250_WHO_AM_I              0x75
+
+#define MPU9250_CONFIG_DLPF_41HZ      0x03
+#define MPU9250_FIFO_EN_TEMP          0x80
+#define MPU9250_FIFO_EN_GYRO          0x70
+#define MPU9250_FIFO_EN_ACCEL         0x08
+#define MPU9250_FIFO_EN_SLV0          0x01
+#define MPU9250_USER_CTRL_FIFO_EN     0x40
+#define MPU9250_USER_CTRL_I2C_MST_EN  0x20
+#define MPU9250_USER_CTRL_FIFO_RST    0x04
+#define MPU9250_INT_PIN_CFG_ANYRD_2CLEAR 0x10
+#define MPU9250_INT_PIN_CFG_BYPASS_EN 0x02
+#define MPU9250_INT_RAW_RDY_EN        0x01
+#define MPU9250_INT_FIFO_OVERFLOW     0x10
+#define MPU9250_I2C_MST_CLK_400KHZ    0x0D
+#define MPU9250_I2C_SLV_READ          0x80
+#define MPU9250_I2C_SLV_EN            0x80
+#define MPU9250_FIFO_SIZE             512
+// AK8963 ST1..ST2, read by the I2C master into EXT_SENS_DATA on every sample
+#define MPU9250_FIFO_MAG_SIZE         8
+// accel, temp, gyro and mag, in register order: same layout as ACCEL_XOUT_H..EXT_SENS_DATA_07
+#define MPU9250_FIFO_SAMPLE_SIZE      (14 + MPU9250_FIFO_MAG_SIZE)
+// Most samples read in a single burst
+#define MPU9250_FIFO_MAX_BURST        16
+// Internal sample rate with the DLPF enabled, divided by SMPLRT_DIV + 1
+#define MPU9250_INTERNAL_RATE_HZ      1000
     
 /* Gyro sensitivities in °/s */
 #define MPU9250_GYRO_SENS_250       ((float) 131)
@@ -98,6 +130,9 @@
 #define AK8963_CNTL1                0x0a
 #define AK8963_ASTC                 0x0c
 
+#define AK8963_ST1_DRDY             0x01
+#define AK8963_ST2_HOFL             0x08
+
 #define AK8963_I2C_ADDR             0x0c
 #define AK8963_MAG_LSB              0.15f     // in 16 bit mode, 0.15uT per LSB
 
@@ -130,8 +165,17 @@ extern void mpu9250_init(mpu9250_t* mpu9250,
     MPU9250_Gyroscope_t gyro_sensitivity,
     imu_raw_to_real_t* lsb);
 extern bool mpu9250_is_available(mpu9250_t* mpu9250);
+// Checks the chip still answers with its ID
+extern bool mpu9250_self_test(mpu9250_t* mpu9250);
+// The AK8963 is only directly readable until mpu9250_fifo_enable() is called
 extern bool mpu9250_read_all(mpu9250_t* mpu9250, imu_sensor_data_t* data);
 extern bool mpu9250_read_mag(mpu9250_t* mpu9250, imu_sensor_data_t* imu);
 extern bool mpu9250_read_gyro_accel(mpu9250_t* mpu9250, imu_sensor_data_t* imu);
+// Samples accel/temp/gyro/mag into the FIFO at sample_rate_hz and raises INT on each sample.
+// mag_updated is set on the samples carrying a new AK8963 measurement.
+extern void mpu9250_fifo_enable(mpu9250_t* mpu9250, uint16_t sample_rate_hz);
+// Reads up to max_samples queued samples in one burst. Returns how many were read,
+// -1 if the FIFO overflowed (it's reset and the samples are lost).
+extern int mpu9250_read_fifo(mpu9250_t* mpu9250, imu_sensor_data_t* samples, int max_samples);
 
 #endif /* !__MPU_9250_DEF_H__ */
\ No newline at end of file
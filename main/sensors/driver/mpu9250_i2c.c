@@ -106,4 +106,18 @@ bool ak8963_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size)
     HAL_ERR_ASSERT_OK(hal_i2c_cmd_destroy(&cmd));
 
     return mpu9250_handl_error(cfg, err);;
+}
+
+bool mpu9250_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t* data, uint32_t size)
+{
+    hal_i2c_cmd_take(cfg->i2c_cfg->i2c_bus);
+    hal_err_t err = hal_i2c_write_then_read(cfg->i2c_cfg->i2c_bus, cfg->addr, &reg, 1, data, size);
+    return mpu9250_handl_error(cfg, err);
+}
+
+bool ak8963_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t* data, uint32_t size)
+{
+    hal_i2c_cmd_take(cfg->i2c_cfg->i2c_bus);
+    hal_err_t err = hal_i2c_write_then_read(cfg->i2c_cfg->i2c_bus, cfg->ak8963_addr, &reg, 1, data, size);
+    return mpu9250_handl_error(cfg, err);
 }
\ No newline at end of file
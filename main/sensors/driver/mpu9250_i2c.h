@@ -19,4 +19,7 @@ void mpu9250_i2c_init(mpu9250_i2c_config_t *cfg);
 bool mpu9250_i2c_read(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size);
 bool mpu9250_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size);
 bool ak8963_i2c_read(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size);
-bool ak8963_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size);
\ No newline at end of file
+bool ak8963_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t* data, uint32_t size);
+// Register address write and data read in a single transaction (repeated start)
+bool mpu9250_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t* data, uint32_t size);
+bool ak8963_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t* data, uint32_t size);
\ No newline at end of file
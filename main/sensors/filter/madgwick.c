@@ -24,7 +24,7 @@ void madgwick_init(madgwick_t *madgwick, float sample_freq)
 void madgwick_update(madgwick_t *madgwick,
                      float gx, float gy, float gz,
                      float ax, float ay, float az,
-                     float mx, float my, float mz)
+                     float mx, float my, float mz, float dt)
 {
     float recipNorm;
     float s0, s1, s2, s3;
@@ -35,7 +35,7 @@ void madgwick_update(madgwick_t *madgwick,
     // Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
     if ((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f))
     {
-        madgwick_updateIMU(madgwick, gx, gy, gz, ax, ay, az);
+        madgwick_updateIMU(madgwick, gx, gy, gz, ax, ay, az, dt);
         return;
     }
 
@@ -114,10 +114,10 @@ void madgwick_update(madgwick_t *madgwick,
     }
 
     // Integrate rate of change of quaternion to yield quaternion
-    Q0 += qDot1 * madgwick->invSampleFreq;
-    Q1 += qDot2 * madgwick->invSampleFreq;
-    Q2 += qDot3 * madgwick->invSampleFreq;
-    Q3 += qDot4 * madgwick->invSampleFreq;
+    Q0 += qDot1 * dt;
+    Q1 += qDot2 * dt;
+    Q2 += qDot3 * dt;
+    Q3 += qDot4 * dt;
 
     // Normalise quaternion
     recipNorm = invSqrt(Q0 * Q0 + Q1 * Q1 + Q2 * Q2 + Q3 * Q3);
@@ -129,7 +129,7 @@ void madgwick_update(madgwick_t *madgwick,
 
 void madgwick_updateIMU(madgwick_t *madgwick,
                         float gx, float gy, float gz,
-                        float ax, float ay, float az)
+                        float ax, float ay, float az, float dt)
 {
     float recipNorm;
     float s0, s1, s2, s3;
@@ -190,10 +190,10 @@ void madgwick_updateIMU(madgwick_t *madgwick,
     }
 
     // Integrate rate of change of quaternion to yield quaternion
-    Q0 += qDot1 * madgwick->invSampleFreq;
-    Q1 += qDot2 * madgwick->invSampleFreq;
-    Q2 += qDot3 * madgwick->invSampleFreq;
-    Q3 += qDot4 * madgwick->invSampleFreq;
+    Q0 += qDot1 * dt;
+    Q1 += qDot2 * dt;
+    Q2 += qDot3 * dt;
+    Q3 += qDot4 * dt;
 
     // Normalise quaternion
     recipNorm = invSqrt(Q0 * Q0 + Q1 * Q1 + Q2 * Q2 + Q3 * Q3);
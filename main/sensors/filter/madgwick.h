@@ -3,6 +3,7 @@
 
 typedef struct
 {
+    // Nominal rate, each update integrates over its own dt
     float sampleFreq;
     float invSampleFreq;
     float beta;
@@ -12,11 +13,11 @@ typedef struct
 extern void madgwick_init(madgwick_t *madgwick, float sample_freq);
 extern void madgwick_updateIMU(madgwick_t *madgwick,
                                float gx, float gy, float gz,
-                               float ax, float ay, float az);
+                               float ax, float ay, float az, float dt);
 extern void madgwick_update(madgwick_t *madgwick,
                             float gx, float gy, float gz,
                             float ax, float ay, float az,
-                            float mx, float my, float mz);
+                            float mx, float my, float mz, float dt);
 extern void madgwick_get_roll_pitch_yaw(madgwick_t *madgwick, float data[3], float mg);
 extern void madgwick_get_quaternion(madgwick_t *madgwick, float data[4]);
 
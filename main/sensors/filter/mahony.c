@@ -41,7 +41,7 @@ void mahony_init(mahony_t *mahony, float sampleFrequency)
 void mahony_update(mahony_t *mahony,
                    float gx, float gy, float gz,
                    float ax, float ay, float az,
-                   float mx, float my, float mz)
+                   float mx, float my, float mz, float dt)
 {
     float recipNorm;
     float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
@@ -53,7 +53,7 @@ void mahony_update(mahony_t *mahony,
     // Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
     if ((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f))
     {
-        mahony_updateIMU(mahony, gx, gy, gz, ax, ay, az);
+        mahony_updateIMU(mahony, gx, gy, gz, ax, ay, az, dt);
         return;
     }
 
@@ -111,9 +111,9 @@ void mahony_update(mahony_t *mahony,
         // Compute and apply integral feedback if enabled
         if (mahony->twoKi > 0.0f)
         {
-            mahony->integralFBx += mahony->twoKi * halfex * mahony->invSampleFreq; // integral error scaled by Ki
-            mahony->integralFBy += mahony->twoKi * halfey * mahony->invSampleFreq;
-            mahony->integralFBz += mahony->twoKi * halfez * mahony->invSampleFreq;
+            mahony->integralFBx += mahony->twoKi * halfex * dt; // integral error scaled by Ki
+            mahony->integralFBy += mahony->twoKi * halfey * dt;
+            mahony->integralFBz += mahony->twoKi * halfez * dt;
             gx += mahony->integralFBx; // apply integral feedback
             gy += mahony->integralFBy;
             gz += mahony->integralFBz;
@@ -132,9 +132,9 @@ void mahony_update(mahony_t *mahony,
     }
 
     // Integrate rate of change of quaternion
-    gx *= (0.5f * mahony->invSampleFreq); // pre-multiply common factors
-    gy *= (0.5f * mahony->invSampleFreq);
-    gz *= (0.5f * mahony->invSampleFreq);
+    gx *= (0.5f * dt); // pre-multiply common factors
+    gy *= (0.5f * dt);
+    gz *= (0.5f * dt);
     qa = mahony->q0;
     qb = mahony->q1;
     qc = mahony->q2;
@@ -153,7 +153,7 @@ void mahony_update(mahony_t *mahony,
 }
 
 void mahony_updateIMU(mahony_t *mahony, float gx, float gy, float gz,
-                      float ax, float ay, float az)
+                      float ax, float ay, float az, float dt)
 {
     float recipNorm;
     float halfvx, halfvy, halfvz;
@@ -190,9 +190,9 @@ void mahony_updateIMU(mahony_t *mahony, float gx, float gy, float gz,
         if (mahony->twoKi > 0.0f)
         {
             // integral error scaled by Ki
-            mahony->integralFBx += mahony->twoKi * halfex * mahony->invSampleFreq;
-            mahony->integralFBy += mahony->twoKi * halfey * mahony->invSampleFreq;
-            mahony->integralFBz += mahony->twoKi * halfez * mahony->invSampleFreq;
+            mahony->integralFBx += mahony->twoKi * halfex * dt;
+            mahony->integralFBy += mahony->twoKi * halfey * dt;
+            mahony->integralFBz += mahony->twoKi * halfez * dt;
             gx += mahony->integralFBx; // apply integral feedback
             gy += mahony->integralFBy;
             gz += mahony->integralFBz;
@@ -211,9 +211,9 @@ void mahony_updateIMU(mahony_t *mahony, float gx, float gy, float gz,
     }
 
     // Integrate rate of change of quaternion
-    gx *= (0.5f * mahony->invSampleFreq); // pre-multiply common factors
-    gy *= (0.5f * mahony->invSampleFreq);
-    gz *= (0.5f * mahony->invSampleFreq);
+    gx *= (0.5f * dt); // pre-multiply common factors
+    gy *= (0.5f * dt);
+    gz *= (0.5f * dt);
     qa = mahony->q0;
     qb = mahony->q1;
     qc = mahony->q2;
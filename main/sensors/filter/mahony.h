@@ -7,16 +7,16 @@ typedef struct
     float twoKi;                                 // 2 * integral gain (Ki)
     float q0, q1, q2, q3;                        // quaternion of sensor frame relative to auxiliary frame
     float integralFBx, integralFBy, integralFBz; // integral error terms scaled by Ki
-    float invSampleFreq;
+    float invSampleFreq;                         // nominal period, each update integrates over its own dt
 } mahony_t;
 
 extern void mahony_init(mahony_t *mahony, float sampleFrequency);
 extern void mahony_updateIMU(mahony_t *mahony, float gx, float gy, float gz,
-                             float ax, float ay, float az);
+                             float ax, float ay, float az, float dt);
 extern void mahony_update(mahony_t *mahony,
                           float gx, float gy, float gz,
                           float ax, float ay, float az,
-                          float mx, float my, float mz);
+                          float mx, float my, float mz, float dt);
 extern void mahony_get_roll_pitch_yaw(mahony_t *mahony, float data[3], float md);
 extern void mahony_get_quaternion(mahony_t *mahony, float data[4]);
 
@@ -50,9 +50,10 @@ invSqrt(float x)
 
 }
 #else
+// int32_t rather than long, which is 64 bits on the hosts tools/imu_replay.c runs on
 typedef union {
     float f;
-    long l;
+    int32_t l;
 } float_long_t;
 
 /*
@@ -74,13 +75,12 @@ invSqrt(float x)
 static inline float invSqrt(float x)
 {
     float halfx = 0.5f * x;
-    float y = x;
-    long i = *(long*) & y;
-    i = 0x5f3759df - (i >> 1);
-    y = *(float*) & i;
-    y = y * (1.5f - (halfx * y * y));
-    y = y * (1.5f - (halfx * y * y));
-    return y;
+    float_long_t y;
+    y.f = x;
+    y.l = 0x5f3759df - (y.l >> 1);
+    y.f = y.f * (1.5f - (halfx * y.f * y.f));
+    y.f = y.f * (1.5f - (halfx * y.f * y.f));
+    return y.f;
 }
 #endif
 
@@ -0,0 +1,125 @@
+#include <math.h>
+#include <string.h>
+
+#include "gyro_bias.h"
+
+/*
+   The gyro offset drifts with temperature, so the one found by the explicit
+   calibration slowly goes wrong, and Madgwick yaw with it. Whenever the
+   tracker stands still for a whole window, the gyro mean over it is the
+   current offset. The estimate follows those means with a low pass, so one
+   window only moves gyro_off by a fraction of its difference with the mean,
+   rounded to whole LSB. The fraction is carried over to the next window.
+*/
+
+// Sums are of the difference with the window's first sample, so the squares
+// of 1G readings don't eat the float's precision
+static int16_t _first_accel[3];
+static int16_t _first_gyro[3];
+static float _sum_accel[3];
+static float _sum_accel_sq[3];
+static float _sum_gyro[3];
+static float _sum_gyro_sq[3];
+static uint32_t _count;
+static time_micros_t _window_start;
+
+// Raw units, keeps the fraction gyro_off can't hold
+static float _bias[3];
+
+static void gyro_bias_reset_window(void)
+{
+    memset(_sum_accel, 0, sizeof(_sum_accel));
+    memset(_sum_accel_sq, 0, sizeof(_sum_accel_sq));
+    memset(_sum_gyro, 0, sizeof(_sum_gyro));
+    memset(_sum_gyro_sq, 0, sizeof(_sum_gyro_sq));
+    _count = 0;
+    _window_start = 0;
+}
+
+void gyro_bias_init(const int16_t gyro_off[3])
+{
+    for (int ii = 0; ii < 3; ii++)
+    {
+        _bias[ii] = gyro_off[ii];
+    }
+    gyro_bias_reset_window();
+}
+
+static float gyro_bias_variance(float sum, float sum_sq, uint32_t count)
+{
+    float mean = sum / count;
+    return sum_sq / count - mean * mean;
+}
+
+static bool gyro_bias_window_is_still(const imu_raw_to_real_t *lsb)
+{
+    // Raw units squared
+    const float max_accel_var = powf(GYRO_BIAS_MAX_ACCEL_STD / lsb->accel_lsb, 2);
+    const float max_gyro_var = powf(GYRO_BIAS_MAX_GYRO_STD / lsb->gyro_lsb, 2);
+    const float max_step = GYRO_BIAS_MAX_STEP / lsb->gyro_lsb;
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        if (gyro_bias_variance(_sum_accel[ii], _sum_accel_sq[ii], _count) > max_accel_var ||
+            gyro_bias_variance(_sum_gyro[ii], _sum_gyro_sq[ii], _count) > max_gyro_var ||
+            fabsf(_first_gyro[ii] + _sum_gyro[ii] / _count - _bias[ii]) > max_step)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool gyro_bias_update(const imu_sensor_data_t *raw, const imu_raw_to_real_t *lsb, bool moving, int16_t gyro_off[3])
+{
+    bool updated = false;
+
+    if (moving || raw->time == 0)
+    {
+        gyro_bias_reset_window();
+        return false;
+    }
+
+    if (_window_start == 0)
+    {
+        _window_start = raw->time;
+        memcpy(_first_accel, raw->accel, sizeof(_first_accel));
+        memcpy(_first_gyro, raw->gyro, sizeof(_first_gyro));
+    }
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        float accel = raw->accel[ii] - _first_accel[ii];
+        float gyro = raw->gyro[ii] - _first_gyro[ii];
+
+        _sum_accel[ii] += accel;
+        _sum_accel_sq[ii] += accel * accel;
+        _sum_gyro[ii] += gyro;
+        _sum_gyro_sq[ii] += gyro * gyro;
+    }
+    _count++;
+
+    if (raw->time - _window_start < GYRO_BIAS_WINDOW_US)
+    {
+        return false;
+    }
+
+    if (gyro_bias_window_is_still(lsb))
+    {
+        for (int ii = 0; ii < 3; ii++)
+        {
+            float mean = _first_gyro[ii] + _sum_gyro[ii] / _count;
+            _bias[ii] += GYRO_BIAS_GAIN * (mean - _bias[ii]);
+
+            int16_t off = lrintf(_bias[ii]);
+            if (off != gyro_off[ii])
+            {
+                gyro_off[ii] = off;
+                updated = true;
+            }
+        }
+    }
+
+    gyro_bias_reset_window();
+    return updated;
+}
@@ -0,0 +1,24 @@
+#ifndef __GYRO_BIAS_DEF_H__
+#define __GYRO_BIAS_DEF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "imu.h"
+
+// Samples are judged still or not over windows this long
+#define GYRO_BIAS_WINDOW_US (2 * 1000 * 1000)
+// Below these standard deviations the tracker is considered still
+#define GYRO_BIAS_MAX_ACCEL_STD 0.01f // G
+#define GYRO_BIAS_MAX_GYRO_STD 0.3f   // degrees per sec
+// A window further than this from the current offset is a slow rotation, not drift
+#define GYRO_BIAS_MAX_STEP 2.0f // degrees per sec
+// How much each still window moves the estimate, smooth enough for the filter not to notice
+#define GYRO_BIAS_GAIN 0.2f
+
+extern void gyro_bias_init(const int16_t gyro_off[3]);
+// Feeds one raw sample. moving discards the current window, e.g. while the servos run.
+// Returns true when gyro_off was updated.
+extern bool gyro_bias_update(const imu_sensor_data_t *raw, const imu_raw_to_real_t *lsb, bool moving, int16_t gyro_off[3]);
+
+#endif /* !__GYRO_BIAS_DEF_H__ */
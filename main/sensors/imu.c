@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
@@ -133,9 +134,18 @@ static void imu_apply_calibration(imu_t *imu)
     imu->adjusted.gyro[1] = (imu->raw.gyro[1] - imu->cal.gyro_off[1]);
     imu->adjusted.gyro[2] = (imu->raw.gyro[2] - imu->cal.gyro_off[2]);
 
-    imu->adjusted.mag[0] = (imu->raw.mag[0] - imu->cal.mag_bias[0]);
-    imu->adjusted.mag[1] = (imu->raw.mag[1] - imu->cal.mag_bias[1]);
-    imu->adjusted.mag[2] = (imu->raw.mag[2] - imu->cal.mag_bias[2]);
+    int32_t mag[3];
+    mag[0] = imu->raw.mag[0] - imu->cal.mag_bias[0];
+    mag[1] = imu->raw.mag[1] - imu->cal.mag_bias[1];
+    mag[2] = imu->raw.mag[2] - imu->cal.mag_bias[2];
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        imu->adjusted.mag[ii] = (imu->cal.mag_soft_iron[ii][0] * mag[0] +
+                                 imu->cal.mag_soft_iron[ii][1] * mag[1] +
+                                 imu->cal.mag_soft_iron[ii][2] * mag[2]) /
+                                MAG_CALIBRATION_ONE;
+    }
 
     imu->adjusted.temp = imu->raw.temp;
 }
@@ -168,12 +178,21 @@ static void imu_update_normal(imu_t *imu)
 {
     imu_apply_calibration(imu);
 
-    imu_apply_board_orientation(imu);
+    // A fused part remaps its own axes, see imu_driver_t.set_alignment
+    if (!imu->fused)
+    {
+        imu_apply_board_orientation(imu);
+    }
 
     imu_calc_sensor_value(imu);
 
     //LOG_I(TAG, "MAG[0]:%f | MAG[1]:%f | MAG[2]:%f", imu->data.mag[0], imu->data.mag[1], imu->data.mag[2]);
 
+    if (imu->fused)
+    {
+        return;
+    }
+
     //
     // remember
     // a) accel/mag is unitless. you can push in values in any unit
@@ -185,7 +204,8 @@ static void imu_update_normal(imu_t *imu)
     madgwick_update(&imu->filter,
                     imu->data.gyro[0], imu->data.gyro[1], imu->data.gyro[2],
                     imu->data.accel[0], imu->data.accel[1], imu->data.accel[2],
-                    imu->data.mag[0], imu->data.mag[1], imu->data.mag[2]);
+                    imu->data.mag[0], imu->data.mag[1], imu->data.mag[2],
+                    imu->dt);
     
     madgwick_get_roll_pitch_yaw(&imu->filter,
                                 imu->data.orientation,
@@ -194,7 +214,8 @@ static void imu_update_normal(imu_t *imu)
     mahony_update(&imu->filter,
                   imu->data.gyro[0], imu->data.gyro[1], imu->data.gyro[2],
                   imu->data.accel[0], imu->data.accel[1], imu->data.accel[2],
-                  imu->data.mag[0], imu->data.mag[1], imu->data.mag[2]);
+                  imu->data.mag[0], imu->data.mag[1], imu->data.mag[2],
+                  imu->dt);
 
     mahony_get_roll_pitch_yaw(&imu->filter,
                               imu->data.orientation,
@@ -220,6 +241,10 @@ void imu_init(imu_t *imu)
         imu->cal.accel_scale[1] =
             imu->cal.accel_scale[2] = 4096;
 
+    imu->cal.mag_soft_iron[0][0] =
+        imu->cal.mag_soft_iron[1][1] =
+            imu->cal.mag_soft_iron[2][2] = MAG_CALIBRATION_ONE;
+
     // FIXME
     // update_rate
     // sensor align
@@ -243,10 +268,30 @@ void imu_init(imu_t *imu)
     imu->enable = settings_get_key_bool(SETTING_KEY_IMU_ENABLE);
 }
 
+static void imu_update_dt(imu_t *imu)
+{
+    // The first sample, or one without a timestamp, gets the nominal period
+    if (imu->last_sample_time == 0 || imu->raw.time <= imu->last_sample_time)
+    {
+        imu->dt = imu->filter.invSampleFreq;
+    }
+    else
+    {
+        imu->dt = (imu->raw.time - imu->last_sample_time) / (float)MICROS_PER_SEC;
+        if (imu->dt > IMU_MAX_DT)
+        {
+            imu->dt = IMU_MAX_DT;
+        }
+    }
+    imu->last_sample_time = imu->raw.time;
+}
+
 void imu_update(imu_t *imu)
 {
     // raw sensor data is already read in .raw
 
+    imu_update_dt(imu);
+
     switch (imu->mode)
     {
     case imu_mode_normal:
@@ -262,7 +307,11 @@ void imu_update(imu_t *imu)
         break;
 
     case imu_mode_mag_calibrating:
-        mag_calibration_update(imu->raw.mag[0], imu->raw.mag[1], imu->raw.mag[2]);
+        // Repeating a reading would weigh it more than the others
+        if (imu->raw.mag_updated)
+        {
+            mag_calibration_update(imu->raw.mag[0], imu->raw.mag[1], imu->raw.mag[2]);
+        }
         break;
     }
 }
@@ -276,7 +325,7 @@ void imu_mag_calibration_start(imu_t *imu)
 void imu_mag_calibration_finish(imu_t *imu)
 {
     imu->mode = imu_mode_normal;
-    mag_calibration_finish(imu->cal.mag_bias);
+    mag_calibration_finish(imu->cal.mag_bias, imu->cal.mag_soft_iron);
     imu->cal_done_notifier->mSubject.Notify(imu->cal_done_notifier, imu);
 }
 
@@ -316,6 +365,34 @@ void imu_accel_calibration_finish(imu_t *imu)
     imu->cal_done_notifier->mSubject.Notify(imu->cal_done_notifier, imu);
 }
 
+void imu_board_align_axes(imu_board_align_t align, uint8_t source[3], bool negate[3])
+{
+    // Each output then holds the 1 based index of its input, with its sign
+    int16_t values[3] = {1, 2, 3};
+
+    alignReading(values, align);
+    for (int ii = 0; ii < 3; ii++)
+    {
+        negate[ii] = values[ii] < 0;
+        source[ii] = (negate[ii] ? -values[ii] : values[ii]) - 1;
+    }
+}
+
+void imu_set_fused_orientation(imu_t *imu, const float orientation[3])
+{
+    // As madgwick_get_roll_pitch_yaw() does it, but the chip's heading is
+    // already 0..360 so adding the declination can go past either end
+    float yaw = fmodf(orientation[2] + imu->cal.mag_declination, 360.0f);
+    if (yaw < 0.0f)
+    {
+        yaw += 360.0f;
+    }
+
+    imu->data.orientation[0] = orientation[0];
+    imu->data.orientation[1] = orientation[1];
+    imu->data.orientation[2] = yaw;
+}
+
 bool imu_is_available(imu_t *imu)
 {
     return imu->available;
@@ -5,10 +5,13 @@
 #include <stdint.h>
 #include "filter/madgwick.h"
 #include "filter/mahony.h"
+#include "util/time.h"
 
 #define USE_MADGWICK 1
 
 #define IMU_POLL_INTERVAL 2
+// Longer gaps between samples (e.g. the task stalled) integrate at most this
+#define IMU_MAX_DT 0.1f
 
 typedef struct _Notifier notifier_t;
 
@@ -40,6 +43,8 @@ typedef struct
     int16_t gyro[3];
     int16_t mag[3];
     int16_t temp;
+    time_micros_t time; // when the sample was taken
+    bool mag_updated;   // mag holds a new measurement
 } imu_sensor_data_t;
 
 typedef struct
@@ -48,6 +53,8 @@ typedef struct
     int16_t accel_scale[3];
     int16_t gyro_off[3];
     int16_t mag_bias[3];
+    // Soft iron correction applied after mag_bias, 4096 is 1.0
+    int16_t mag_soft_iron[3][3];
     float mag_declination;
 } imu_sensor_calib_data_t;
 
@@ -84,6 +91,8 @@ typedef struct
     imu_raw_to_real_t lsb;
 
     imu_data_t data;
+    time_micros_t last_sample_time;
+    float dt; // seconds between the last two samples
 
 #if USE_MADGWICK == 1
     madgwick_t filter;
@@ -93,6 +102,8 @@ typedef struct
     int32_t calibration_time;
     int8_t calibration_acc_step;
     float update_rate;
+    // data.orientation comes from the IMU itself, the filter isn't run
+    bool fused;
     bool enable;
     bool available;
 
@@ -102,6 +113,10 @@ typedef struct
 
 extern void imu_init(imu_t *imu);
 extern void imu_update(imu_t *imu);
+// The alignment as an axis remap: out[ii] = (negate[ii] ? -1 : 1) * in[source[ii]]
+extern void imu_board_align_axes(imu_board_align_t align, uint8_t source[3], bool negate[3]);
+// Orientation read from a fused part, gets the mag declination like the filter output
+extern void imu_set_fused_orientation(imu_t *imu, const float orientation[3]);
 extern bool imu_is_available(imu_t *imu);
 extern void imu_disable();
 
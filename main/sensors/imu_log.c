@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <hal/log.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "config/settings.h"
+#include "imu_log.h"
+
+static const char *TAG = "imu_log";
+
+typedef struct imu_log_s
+{
+    const setting_t *mode_setting;
+    imu_log_mode_e mode;
+    uint32_t seq;
+
+    // Datagram being filled in UDP mode
+    struct __attribute__((packed))
+    {
+        imu_log_header_t header;
+        imu_log_record_t records[IMU_LOG_UDP_RECORDS];
+    } block;
+
+    // Only allocated once RAM mode is used
+    imu_log_record_t *ring;
+    uint16_t ring_head;
+    uint16_t ring_count;
+
+    io_t output;
+    uint32_t dropped;
+} imu_log_t;
+
+static imu_log_t imu_log;
+// output is set by the WiFi task
+static SemaphoreHandle_t _mutex;
+
+void imu_log_init(void)
+{
+    memset(&imu_log, 0, sizeof(imu_log));
+    imu_log.mode_setting = settings_get_key(SETTING_KEY_IMU_LOG);
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void imu_log_set_output(io_write_f write, void *data)
+{
+    // The IMU is disabled
+    if (!_mutex)
+    {
+        return;
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    imu_log.output = (io_t){
+        .write = write,
+        .data = data,
+    };
+    xSemaphoreGive(_mutex);
+}
+
+static void imu_log_send(const imu_t *imu)
+{
+    imu_log_header_t *header = &imu_log.block.header;
+    size_t size = sizeof(*header) + header->count * sizeof(imu_log_record_t);
+
+    header->magic = IMU_LOG_MAGIC;
+    header->version = IMU_LOG_VERSION;
+    header->accel_lsb = imu->lsb.accel_lsb;
+    header->gyro_lsb = imu->lsb.gyro_lsb;
+    header->mag_lsb = imu->lsb.mag_lsb;
+    memcpy(header->accel_off, imu->cal.accel_off, sizeof(header->accel_off));
+    memcpy(header->accel_scale, imu->cal.accel_scale, sizeof(header->accel_scale));
+    memcpy(header->gyro_off, imu->cal.gyro_off, sizeof(header->gyro_off));
+    memcpy(header->mag_bias, imu->cal.mag_bias, sizeof(header->mag_bias));
+    memcpy(header->mag_soft_iron, imu->cal.mag_soft_iron, sizeof(header->mag_soft_iron));
+    header->mag_declination = imu->cal.mag_declination;
+    // A fused part's raw axes are already aligned by the part itself
+    header->accel_align = imu->fused ? imu_board_align_cw_0 : imu->accel_align;
+    header->gyro_align = imu->fused ? imu_board_align_cw_0 : imu->gyro_align;
+    header->mag_align = imu->fused ? imu_board_align_cw_0 : imu->mag_align;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    // Lost datagrams show up as seq gaps on the receiving side
+    if (io_write(&imu_log.output, &imu_log.block, size) != size)
+    {
+        imu_log.dropped += header->count;
+    }
+    xSemaphoreGive(_mutex);
+
+    header->count = 0;
+}
+
+static void imu_log_append(const imu_t *imu, const imu_log_record_t *record)
+{
+    imu_log_header_t *header = &imu_log.block.header;
+
+    if (header->count == 0)
+    {
+        header->seq = imu_log.seq;
+    }
+    imu_log.block.records[header->count++] = *record;
+    imu_log.seq++;
+
+    if (header->count == IMU_LOG_UDP_RECORDS)
+    {
+        imu_log_send(imu);
+    }
+}
+
+static void imu_log_dump_ring(const imu_t *imu)
+{
+    uint16_t start = (imu_log.ring_head + IMU_LOG_RAM_RECORDS - imu_log.ring_count) % IMU_LOG_RAM_RECORDS;
+
+    LOG_I(TAG, "Sending %u records captured in RAM", imu_log.ring_count);
+
+    for (int ii = 0; ii < imu_log.ring_count; ii++)
+    {
+        imu_log_append(imu, &imu_log.ring[(start + ii) % IMU_LOG_RAM_RECORDS]);
+    }
+    imu_log.ring_count = 0;
+}
+
+static void imu_log_mode_changed(const imu_t *imu, imu_log_mode_e mode)
+{
+    LOG_I(TAG, "Mode %d -> %d, %u records dropped so far", imu_log.mode, mode, imu_log.dropped);
+
+    if (mode == IMU_LOG_MODE_RAM && !imu_log.ring)
+    {
+        imu_log.ring = malloc(IMU_LOG_RAM_RECORDS * sizeof(imu_log_record_t));
+        if (!imu_log.ring)
+        {
+            // Stays in RAM mode without capturing, until the setting changes
+            LOG_E(TAG, "Can't allocate %d records", IMU_LOG_RAM_RECORDS);
+        }
+        imu_log.ring_head = 0;
+        imu_log.ring_count = 0;
+    }
+
+    if (imu_log.mode == IMU_LOG_MODE_RAM && mode == IMU_LOG_MODE_UDP && imu_log.ring_count > 0)
+    {
+        imu_log_dump_ring(imu);
+    }
+
+    if (imu_log.mode == IMU_LOG_MODE_UDP && imu_log.block.header.count > 0)
+    {
+        imu_log_send(imu);
+    }
+
+    imu_log.mode = mode;
+}
+
+void imu_log_push(const imu_t *imu, const imu_sensor_data_t *sample)
+{
+    imu_log_mode_e mode = setting_get_u8(imu_log.mode_setting);
+
+    if (mode != imu_log.mode)
+    {
+        imu_log_mode_changed(imu, mode);
+    }
+
+    if (imu_log.mode == IMU_LOG_MODE_OFF)
+    {
+        return;
+    }
+
+    imu_log_record_t record = {
+        .time = (uint32_t)sample->time,
+        .flags = sample->mag_updated ? IMU_LOG_RECORD_MAG_UPDATED : 0,
+    };
+    memcpy(record.accel, sample->accel, sizeof(record.accel));
+    memcpy(record.gyro, sample->gyro, sizeof(record.gyro));
+    memcpy(record.mag, sample->mag, sizeof(record.mag));
+
+    if (imu_log.mode == IMU_LOG_MODE_RAM)
+    {
+        if (!imu_log.ring)
+        {
+            return;
+        }
+        // Overwrites the oldest one when full
+        imu_log.ring[imu_log.ring_head] = record;
+        imu_log.ring_head = (imu_log.ring_head + 1) % IMU_LOG_RAM_RECORDS;
+        if (imu_log.ring_count < IMU_LOG_RAM_RECORDS)
+        {
+            imu_log.ring_count++;
+        }
+        return;
+    }
+
+    imu_log_append(imu, &record);
+}
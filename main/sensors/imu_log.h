@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io/io.h"
+#include "imu.h"
+#include "imu_log_format.h"
+
+// Records sent per datagram, ~800 bytes
+#define IMU_LOG_UDP_RECORDS 32
+// Last records kept in RAM mode, ~2.5s at 200Hz
+#define IMU_LOG_RAM_RECORDS 512
+
+// Indexed by SETTING_KEY_IMU_LOG
+typedef enum
+{
+    IMU_LOG_MODE_OFF,
+    // Streams records as they're sampled
+    IMU_LOG_MODE_UDP,
+    // Keeps the last IMU_LOG_RAM_RECORDS, sent out when switching to UDP
+    IMU_LOG_MODE_RAM,
+} imu_log_mode_e;
+
+void imu_log_init(void);
+// Where UDP mode sends its datagrams, NULL while there's no network
+void imu_log_set_output(io_write_f write, void *data);
+// Captures one raw sample with its timestamp. Call from the IMU task.
+void imu_log_push(const imu_t *imu, const imu_sensor_data_t *sample);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire/file format of the IMU capture, shared with tools/imu_replay.c so it
+// must not depend on anything else. Little endian, like the ESP32.
+//
+// A capture is a sequence of blocks: one imu_log_header_t followed by
+// header.count records. Each UDP datagram is exactly one block, so datagrams
+// can be appended to a file as they arrive.
+
+#define IMU_LOG_MAGIC 0x4C49 // "IL"
+#define IMU_LOG_VERSION 2
+
+#define IMU_LOG_RECORD_MAG_UPDATED (1 << 0)
+
+typedef struct __attribute__((packed)) imu_log_header_s
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t count;
+    // Of the first record, a gap with the previous block means records were lost
+    uint32_t seq;
+    // What the records need to go through before the filter, as in imu.c
+    float accel_lsb;
+    float gyro_lsb;
+    float mag_lsb;
+    int16_t accel_off[3];
+    int16_t accel_scale[3];
+    int16_t gyro_off[3];
+    int16_t mag_bias[3];
+    int16_t mag_soft_iron[3][3];
+    float mag_declination;
+    // imu_board_align_t, applied after the calibration
+    uint8_t accel_align;
+    uint8_t gyro_align;
+    uint8_t mag_align;
+} imu_log_header_t;
+
+typedef struct __attribute__((packed)) imu_log_record_s
+{
+    // Microseconds, wraps every ~71 minutes
+    uint32_t time;
+    int16_t accel[3];
+    int16_t gyro[3];
+    int16_t mag[3];
+    uint8_t flags;
+} imu_log_record_t;
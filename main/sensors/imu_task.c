@@ -1,4 +1,6 @@
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 #include <string.h>
 // #include "generic_list.h"
@@ -15,20 +17,58 @@
 #include "util/calc.h"
 #include <math.h>
 #include "imu_task.h"
-#include "driver/mpu9250.h"
+#include "driver/imu_driver.h"
+#include "imu_log.h"
+#include "gyro_bias.h"
+#include "sample_clock.h"
 
 #include "config/settings.h"
 
+#include "platform/dispatch.h"
 #include "platform/storage.h"
 #include "protocols/atp.h"
+#include "tracker/servo.h"
+#include "util/crc.h"
+#include "util/macros.h"
 
 // #include "sdkconfig.h"
 
+// Parts without a FIFO only hold the latest sample, so they're polled often
 #define IMU_POLL_INTERVAL 2
+// Samples are queued in the IMU FIFO at this rate, or as close as the part gets
+#define IMU_SAMPLE_RATE_HZ 200
+// Without the data ready interrupt, a FIFO is polled this often so each wake
+// drains a burst instead of mostly finding it empty. The MPU9250's holds 23
+// samples, about 115ms at IMU_SAMPLE_RATE_HZ.
+#define IMU_FIFO_POLL_INTERVAL_MS 20
+_Static_assert(IMU_FIFO_POLL_INTERVAL_MS * IMU_SAMPLE_RATE_HZ / 1000 * 2 <= IMU_DRIVER_MAX_BURST, "FIFO poll interval leaves no margin in a burst");
+// Poll the FIFO anyway if the data ready interrupt doesn't arrive
+#define IMU_DATA_READY_TIMEOUT_MS 20
+// How often the average I2C time per loop is logged
+#define IMU_BUS_STATS_INTERVAL 1000
+// The frame keeps shaking for a while after the servos stop
+#define IMU_GYRO_BIAS_SERVO_SETTLE_MS 1000
+// Save the estimated gyro offset once it moved this many LSB from the stored one,
+// but not more often than every IMU_GYRO_BIAS_SAVE_INTERVAL_MS to spare the flash
+#define IMU_GYRO_BIAS_SAVE_DELTA 3
+#define IMU_GYRO_BIAS_SAVE_INTERVAL_MS (10 * 60 * 1000)
 
 const static char *TAG = "imu_task";
 
 #define IMU_STORAGE_KEY "calibrations"
+// All the calibration is stored under this key as an imu_task_calibration_blob_t
+#define IMU_CALIBRATION_KEY "imu_cal"
+// Bump whenever imu_sensor_calib_data_t changes, older blobs are ignored then
+#define IMU_CALIBRATION_VERSION 1
+
+// Each value used to have its own key, migrated to IMU_CALIBRATION_KEY on boot
+static const char *_legacy_keys[] = {
+    "accel_off_x", "accel_off_y", "accel_off_z",
+    "accel_scale_x", "accel_scale_y", "accel_scale_z",
+    "gyro_off_x", "gyro_off_y", "gyro_off_z",
+    "mag_bias_x", "mag_bias_y", "mag_bias_z",
+};
+#define IMU_LEGACY_SOFT_IRON_KEY "mag_soft_iron"
 
 typedef enum
 {
@@ -39,152 +79,321 @@ typedef enum
     imu_task_perform_accel_calibration_finish,
 } imu_task_command_t;
 
-static SemaphoreHandle_t _mutex;
+// What readers get, published by the IMU task once per loop
+typedef struct
+{
+    imu_mode_t mode;
+    imu_sensor_data_t raw;
+    imu_sensor_data_t adjusted;
+    imu_data_t data;
+    imu_sensor_calib_data_t cal;
+} imu_task_snapshot_t;
+
+typedef struct PACKED
+{
+    uint8_t version;
+    imu_sensor_calib_data_t cal;
+    // crc8_dvb_s2 of everything above
+    uint8_t crc;
+} imu_task_calibration_blob_t;
+
+// _imu is only touched by the IMU task. Readers copy _snapshots[_snapshot_seq & 1]
+// while the next one is written into the other buffer, so they never wait on the bus.
+static imu_task_snapshot_t _snapshots[2];
+static volatile uint32_t _snapshot_seq = 0;
+// Copies that had to be retried because a publish completed during them
+static volatile uint32_t _snapshot_retries = 0;
 static imu_t _imu;
-static mpu9250_t _mpu9250;
+static hal_i2c_config_t *_i2c_cfg;
+static const imu_driver_t *_driver;
+static uint16_t _sample_rate_hz = IMU_SAMPLE_RATE_HZ;
+static sample_clock_t _sample_clock;
 static volatile uint32_t _loop_cnt = 0;
 static xQueueHandle _cmd_queue = NULL;
 static storage_t storage;
+static TaskHandle_t _task;
+static imu_sensor_data_t _samples[IMU_DRIVER_MAX_BURST];
+static const setting_t *_gyro_auto_bias;
+static int16_t _gyro_off_saved[3];
+static time_millis_t _gyro_off_save_time;
+// A background save is queued and hasn't read the calibration yet
+static bool _save_requested = false;
+// Keeps background saves in order, the newest calibration is always written last
+static SemaphoreHandle_t _save_mutex;
+
+static void imu_task_log_calibration(const imu_sensor_calib_data_t *cal)
+{
+    LOG_I(TAG, "accel_off_x:[%d] | accel_off_y:[%d] | accel_off_z:[%d]", cal->accel_off[0], cal->accel_off[1], cal->accel_off[2]);
+    LOG_I(TAG, "accel_scale_x:[%d] | accel_scale_y:[%d] | accel_scale_z:[%d]", cal->accel_scale[0], cal->accel_scale[1], cal->accel_scale[2]);
+    LOG_I(TAG, "gyro_off_x:[%d] | gyro_off_y:[%d] | gyro_off_z:[%d]", cal->gyro_off[0], cal->gyro_off[1], cal->gyro_off[2]);
+    LOG_I(TAG, "mag_bias_x:[%d] | mag_bias_y:[%d] | mag_bias_z:[%d]", cal->mag_bias[0], cal->mag_bias[1], cal->mag_bias[2]);
+    for (int ii = 0; ii < 3; ii++)
+    {
+        LOG_I(TAG, "mag_soft_iron[%d]:[%d, %d, %d]", ii, cal->mag_soft_iron[ii][0], cal->mag_soft_iron[ii][1], cal->mag_soft_iron[ii][2]);
+    }
+}
 
-static void imu_task_load_calibration(void)
+static uint8_t imu_task_calibration_crc(const imu_task_calibration_blob_t *blob)
 {
-    //esp_err_t err;
-    //nvs_handle nvs_handle;
-    static const imu_sensor_calib_data_t cal_default =
-        {
-            .accel_off = {0, 0, 0},
-            .accel_scale = {4096, 4096, 4096},
-            .gyro_off = {0, 0, 0},
-            .mag_bias = {0, 0, 0},
-            .mag_declination = 0.0f
-        };
+    return crc8_dvb_s2_bytes(blob, offsetof(imu_task_calibration_blob_t, crc));
+}
 
-    //err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    // if (err != ESP_OK)
-    // {
-    //     memcpy(&_imu.cal, &cal_default, sizeof(imu_sensor_calib_data_t));
-    //     ESP_LOGI(TAG, "nvs_open failed. going with all defaults");
-    //     return;
-    // }
+static bool imu_task_load_calibration_blob(imu_sensor_calib_data_t *cal)
+{
+    imu_task_calibration_blob_t blob;
+    size_t size = 0;
 
-    if (!storage_get_i16(&storage, "accel_off_x", &_imu.cal.accel_off[0]))
+    // Asking for the size first, reading a blob bigger than the buffer aborts
+    if (!storage_get_blob(&storage, IMU_CALIBRATION_KEY, NULL, &size))
     {
-        _imu.cal.accel_off[0] = cal_default.accel_off[0];
+        return false;
     }
 
-    if (!storage_get_i16(&storage, "accel_off_y", &_imu.cal.accel_off[1]))
+    if (size != sizeof(blob) || !storage_get_sized_blob(&storage, IMU_CALIBRATION_KEY, &blob, sizeof(blob)))
     {
-        _imu.cal.accel_off[1] = cal_default.accel_off[1];
+        LOG_E(TAG, "calibration has unknown size %u", (unsigned)size);
+        return false;
     }
 
-    if (!storage_get_i16(&storage, "accel_off_z", &_imu.cal.accel_off[2]))
+    if (blob.version != IMU_CALIBRATION_VERSION)
     {
-        _imu.cal.accel_off[2] = cal_default.accel_off[2];
+        LOG_E(TAG, "calibration has unknown version %u", blob.version);
+        return false;
     }
 
-    if (!storage_get_i16(&storage, "accel_scale_x", &_imu.cal.accel_scale[0]))
+    if (blob.crc != imu_task_calibration_crc(&blob))
     {
-        _imu.cal.accel_scale[0] = cal_default.accel_scale[0];
+        LOG_E(TAG, "calibration CRC mismatch");
+        return false;
     }
 
-    if (!storage_get_i16(&storage, "accel_scale_y", &_imu.cal.accel_scale[1]))
-    {
-        _imu.cal.accel_scale[1] = cal_default.accel_scale[1];
-    }
+    *cal = blob.cal;
+    return true;
+}
 
-    if (!storage_get_i16(&storage, "accel_scale_z", &_imu.cal.accel_scale[2]))
+// Values missing from the legacy keys keep what cal already has
+static bool imu_task_load_legacy_calibration(imu_sensor_calib_data_t *cal)
+{
+    int16_t *values[ARRAY_COUNT(_legacy_keys)] = {
+        &cal->accel_off[0], &cal->accel_off[1], &cal->accel_off[2],
+        &cal->accel_scale[0], &cal->accel_scale[1], &cal->accel_scale[2],
+        &cal->gyro_off[0], &cal->gyro_off[1], &cal->gyro_off[2],
+        &cal->mag_bias[0], &cal->mag_bias[1], &cal->mag_bias[2],
+    };
+    bool found = false;
+
+    for (int ii = 0; ii < ARRAY_COUNT(_legacy_keys); ii++)
     {
-        _imu.cal.accel_scale[2] = cal_default.accel_scale[2];
+        if (storage_get_i16(&storage, _legacy_keys[ii], values[ii]))
+        {
+            found = true;
+        }
     }
 
-    if (!storage_get_i16(&storage, "gyro_off_x", &_imu.cal.gyro_off[0]))
+    if (storage_get_sized_blob(&storage, IMU_LEGACY_SOFT_IRON_KEY, cal->mag_soft_iron, sizeof(cal->mag_soft_iron)))
     {
-        _imu.cal.gyro_off[0] = cal_default.gyro_off[0];
+        found = true;
     }
 
-    if (!storage_get_i16(&storage, "gyro_off_y", &_imu.cal.gyro_off[1]))
-    {
-        _imu.cal.gyro_off[1] = cal_default.gyro_off[1];
-    }
+    return found;
+}
 
-    if (!storage_get_i16(&storage, "gyro_off_z", &_imu.cal.gyro_off[2]))
+static void imu_task_erase_legacy_calibration(void)
+{
+    for (int ii = 0; ii < ARRAY_COUNT(_legacy_keys); ii++)
     {
-        _imu.cal.gyro_off[2] = cal_default.gyro_off[2];
+        storage_set_blob(&storage, _legacy_keys[ii], NULL, 0);
     }
+    storage_set_blob(&storage, IMU_LEGACY_SOFT_IRON_KEY, NULL, 0);
+}
 
-    if (!storage_get_i16(&storage, "mag_bias_x", &_imu.cal.mag_bias[0]))
-    {
-        _imu.cal.mag_bias[0] = cal_default.mag_bias[0];
-    }
+static void imu_task_publish(void)
+{
+    imu_task_snapshot_t *snapshot = &_snapshots[(_snapshot_seq + 1) & 1];
 
-    if (!storage_get_i16(&storage, "mag_bias_y", &_imu.cal.mag_bias[1]))
-    {
-        _imu.cal.mag_bias[1] = cal_default.mag_bias[1];
-    }
+    snapshot->mode = _imu.mode;
+    memcpy(&snapshot->raw, &_imu.raw, sizeof(snapshot->raw));
+    memcpy(&snapshot->adjusted, &_imu.adjusted, sizeof(snapshot->adjusted));
+    memcpy(&snapshot->data, &_imu.data, sizeof(snapshot->data));
+    memcpy(&snapshot->cal, &_imu.cal, sizeof(snapshot->cal));
+
+    // Readers on the other core must see the data before the new sequence
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    _snapshot_seq++;
+}
 
-    if (!storage_get_i16(&storage, "mag_bias_z", &_imu.cal.mag_bias[2]))
+static void imu_task_read_snapshot(imu_task_snapshot_t *snapshot)
+{
+    uint32_t seq;
+
+    for (;;)
     {
-        _imu.cal.mag_bias[2] = cal_default.mag_bias[2];
+        seq = _snapshot_seq;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        memcpy(snapshot, &_snapshots[seq & 1], sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        // After a publish the writer moves on to the buffer we just copied
+        if (seq == _snapshot_seq)
+        {
+            break;
+        }
+        _snapshot_retries++;
     }
+}
 
-    LOG_I(TAG, "accel_off_x:[%d] | accel_off_y:[%d] | accel_off_z:[%d]", _imu.cal.accel_off[0], _imu.cal.accel_off[1], _imu.cal.accel_off[2]);
-    LOG_I(TAG, "accel_scale_x:[%d] | accel_scale_y:[%d] | accel_scale_z:[%d]", _imu.cal.accel_scale[0], _imu.cal.accel_scale[1], _imu.cal.accel_scale[2]);
-    LOG_I(TAG, "gyro_off_x:[%d] | gyro_off_y:[%d] | gyro_off_z:[%d]", _imu.cal.gyro_off[0], _imu.cal.gyro_off[1], _imu.cal.gyro_off[2]);
-    LOG_I(TAG, "mag_bias_x:[%d] | mag_bias_y:[%d] | mag_bias_z:[%d]", _imu.cal.mag_bias[0], _imu.cal.mag_bias[1], _imu.cal.mag_bias[2]);
+static void imu_task_write_calibration(const imu_sensor_calib_data_t *cal)
+{
+    imu_task_calibration_blob_t blob = {
+        .version = IMU_CALIBRATION_VERSION,
+        .cal = *cal,
+    };
+    blob.crc = imu_task_calibration_crc(&blob);
+
+    // NVS only drops the old blob once the new one is written, a power cut leaves either of them
+    storage_set_blob(&storage, IMU_CALIBRATION_KEY, &blob, sizeof(blob));
+    storage_commit(&storage);
+}
 
+// Runs at idle priority, a flash write can take tens of ms and the IMU task
+// would miss samples waiting for it
+static void imu_task_save_calibration_dispatched(void *data)
+{
+    imu_task_snapshot_t snapshot;
+
+    xSemaphoreTake(_save_mutex, portMAX_DELAY);
+    // Cleared before reading the calibration, so a request coming in
+    // while this writes gets a save of its own
+    __atomic_store_n(&_save_requested, false, __ATOMIC_SEQ_CST);
+    imu_task_read_snapshot(&snapshot);
+    imu_task_write_calibration(&snapshot.cal);
+    imu_task_log_calibration(&snapshot.cal);
+    xSemaphoreGive(_save_mutex);
 }
 
+// Called by the IMU task, the save itself happens in the background
 static void imu_task_save_calibration(void)
 {
-    // esp_err_t err;
-    // nvs_handle nvs_handle;
-    // err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    // if (err != ESP_OK)
-    // {
-    //     ESP_LOGE(TAG, "nvs_open failed. saving calibration data failed");
-    // }
+    // The save reads the calibration from the published snapshot
+    imu_task_publish();
 
-    storage_set_i16(&storage, "accel_off_x", _imu.cal.accel_off[0]);
-    storage_set_i16(&storage, "accel_off_y", _imu.cal.accel_off[1]);
-    storage_set_i16(&storage, "accel_off_z", _imu.cal.accel_off[2]);
+    memcpy(_gyro_off_saved, _imu.cal.gyro_off, sizeof(_gyro_off_saved));
+    _gyro_off_save_time = time_millis_now();
 
-    LOG_I(TAG, "accel_off_x:[%d] | accel_off_y:[%d] | accel_off_z:[%d]", _imu.cal.accel_off[0], _imu.cal.accel_off[1], _imu.cal.accel_off[2]);
+    if (!__atomic_exchange_n(&_save_requested, true, __ATOMIC_SEQ_CST))
+    {
+        dispatch(imu_task_save_calibration_dispatched, NULL);
+    }
+}
 
-    storage_set_i16(&storage, "accel_scale_x", _imu.cal.accel_scale[0]);
-    storage_set_i16(&storage, "accel_scale_y", _imu.cal.accel_scale[1]);
-    storage_set_i16(&storage, "accel_scale_z", _imu.cal.accel_scale[2]);
+static void imu_task_load_calibration(void)
+{
+    static const imu_sensor_calib_data_t cal_default =
+        {
+            .accel_off = {0, 0, 0},
+            .accel_scale = {4096, 4096, 4096},
+            .gyro_off = {0, 0, 0},
+            .mag_bias = {0, 0, 0},
+            .mag_soft_iron = {{4096, 0, 0}, {0, 4096, 0}, {0, 0, 4096}},
+            .mag_declination = 0.0f
+        };
 
-    LOG_I(TAG, "accel_scale_x:[%d] | accel_scale_y:[%d] | accel_scale_z:[%d]", _imu.cal.accel_scale[0], _imu.cal.accel_scale[1], _imu.cal.accel_scale[2]);
+    if (!imu_task_load_calibration_blob(&_imu.cal))
+    {
+        _imu.cal = cal_default;
 
-    storage_set_i16(&storage, "gyro_off_x", _imu.cal.gyro_off[0]);
-    storage_set_i16(&storage, "gyro_off_y", _imu.cal.gyro_off[1]);
-    storage_set_i16(&storage, "gyro_off_z", _imu.cal.gyro_off[2]);
+        if (imu_task_load_legacy_calibration(&_imu.cal))
+        {
+            LOG_I(TAG, "migrating calibration from the legacy keys");
+            imu_task_write_calibration(&_imu.cal);
+            imu_task_erase_legacy_calibration();
+            storage_commit(&storage);
+        }
+    }
 
-    LOG_I(TAG, "gyro_off_x:[%d] | gyro_off_y:[%d] | gyro_off_z:[%d]", _imu.cal.gyro_off[0], _imu.cal.gyro_off[1], _imu.cal.gyro_off[2]);
+    imu_task_log_calibration(&_imu.cal);
 
-    storage_set_i16(&storage, "mag_bias_x", _imu.cal.mag_bias[0]);
-    storage_set_i16(&storage, "mag_bias_y", _imu.cal.mag_bias[1]);
-    storage_set_i16(&storage, "mag_bias_z", _imu.cal.mag_bias[2]);
+    memcpy(_gyro_off_saved, _imu.cal.gyro_off, sizeof(_gyro_off_saved));
+    _gyro_off_save_time = time_millis_now();
+}
 
-    LOG_I(TAG, "mag_bias_x:[%d] | mag_bias_y:[%d] | mag_bias_z:[%d]", _imu.cal.mag_bias[0], _imu.cal.mag_bias[1], _imu.cal.mag_bias[2]);
+// Call after each imu_update(), _imu.raw must be the sample just used
+static void imu_task_update_gyro_bias(void)
+{
+    time_millis_t last_move = servo_get_last_move();
+    bool still = _imu.mode == imu_mode_normal &&
+                 !_imu.fused &&
+                 setting_get_bool(_gyro_auto_bias) &&
+                 (last_move == 0 || time_millis_now() - last_move >= IMU_GYRO_BIAS_SERVO_SETTLE_MS);
 
-    storage_commit(&storage);
+    gyro_bias_update(&_imu.raw, &_imu.lsb, !still, _imu.cal.gyro_off);
+}
+
+static void imu_task_save_gyro_bias(void)
+{
+    if (_imu.mode != imu_mode_normal || time_millis_now() - _gyro_off_save_time < IMU_GYRO_BIAS_SAVE_INTERVAL_MS)
+    {
+        return;
+    }
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        if (abs(_imu.cal.gyro_off[ii] - _gyro_off_saved[ii]) >= IMU_GYRO_BIAS_SAVE_DELTA)
+        {
+            LOG_I(TAG, "gyro offset drifted, saving");
+            imu_task_save_calibration();
+            return;
+        }
+    }
+}
+
+#if defined(IMU_INT_GPIO)
+static void imu_task_data_ready_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_task, &woken);
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+static void imu_task_timestamp_samples(imu_sensor_data_t *samples, int n, time_micros_t now)
+{
+    if (n < 0 || !_driver->fifo)
+    {
+        // Samples were lost or there's no FIFO, start over from the read time
+        sample_clock_reset(&_sample_clock);
+    }
+
+    sample_clock_burst(&_sample_clock, n, now);
+    for (int ii = 0; ii < n; ii++)
+    {
+        samples[ii].time = sample_clock_next(&_sample_clock);
+    }
 }
 
 static void imu_task(void *pvParameters)
 {
-    const TickType_t xDelay = IMU_POLL_INTERVAL / portTICK_PERIOD_MS;
+#if !defined(IMU_INT_GPIO)
+    const TickType_t xDelay = MILLIS_TO_TICKS(_driver && _driver->fifo ? IMU_FIFO_POLL_INTERVAL_MS : IMU_POLL_INTERVAL);
+#endif
     uint32_t cmd;
     struct timeval cal_start_time,
         now;
-    int cnt = 0;
+    int n;
+    float orientation[3];
+    bool mag_updated;
     time_millis_t fq = time_millis_now();
 
     uint fq_hz = 0;
+    time_micros_t bus_start;
+    time_micros_t bus_time = 0;
+    uint32_t bus_loops = 0;
 
     LOG_I(TAG, "starting imu task");
 
-    _imu.available = mpu9250_is_available(&_mpu9250);
+    _imu.available = _driver != NULL;
 
     if (!_imu.available)
     {
@@ -192,9 +401,29 @@ static void imu_task(void *pvParameters)
         LOG_I(TAG, "imu_disable");
     }
 
+    _task = xTaskGetCurrentTaskHandle();
+    _imu.filter.invSampleFreq = 1.0f / _sample_rate_hz;
+#if USE_MADGWICK == 1
+    _imu.filter.sampleFreq = _sample_rate_hz;
+#endif
+
+#if defined(IMU_INT_GPIO)
+    if (_imu.available)
+    {
+        HAL_ERR_ASSERT_OK(hal_gpio_setup(IMU_INT_GPIO, HAL_GPIO_DIR_INPUT, HAL_GPIO_PULL_NONE));
+        HAL_ERR_ASSERT_OK(hal_gpio_set_isr(IMU_INT_GPIO, HAL_GPIO_INTR_POSEDGE, imu_task_data_ready_isr, NULL));
+    }
+#endif
+
     while (_imu.available)
     {
+#if defined(IMU_INT_GPIO)
+        // Sleep until the next sample, commands are picked up with it
+        ulTaskNotifyTake(pdTRUE, MILLIS_TO_TICKS(IMU_DATA_READY_TIMEOUT_MS));
+        if (xQueueReceive(_cmd_queue, &cmd, 0))
+#else
         if (xQueueReceive(_cmd_queue, &cmd, xDelay))
+#endif
         {
             switch (cmd)
             {
@@ -227,33 +456,63 @@ static void imu_task(void *pvParameters)
             }
         }
 
-        xSemaphoreTake(_mutex, portMAX_DELAY);
-
-        // mpu9250_read_all(&_mpu9250, &_imu.raw);
-
-        xSemaphoreTake(_mpu9250.mpu9250_i2c_cfg.i2c_cfg->xSemaphore, portMAX_DELAY);
+        xSemaphoreTake(_i2c_cfg->xSemaphore, portMAX_DELAY);
+        bus_start = time_micros_now();
         {
-            mpu9250_read_gyro_accel(&_mpu9250, &_imu.raw);
+            // Everything queued since the last loop, in one burst
+            n = _driver->read_burst(_samples, ARRAY_COUNT(_samples));
+            if (n > 0 && _driver->read_mag)
+            {
+                _driver->read_mag(&_samples[n - 1]);
+            }
+            if (n > 0 && _driver->fused && _driver->read_orientation(orientation))
+            {
+                imu_set_fused_orientation(&_imu, orientation);
+            }
+            imu_task_timestamp_samples(_samples, n, time_micros_now());
 
             //LOG_I(TAG, "ACC[0] %5d | ACC[1] %5d | ACC[2] %5d", _imu.raw.accel[0], _imu.raw.accel[1], _imu.raw.accel[2]);
             //LOG_I(TAG, "gyro[0] %5d | gyro[1] %5d | gyro[2] %5d", _imu.raw.gyro[0], _imu.raw.gyro[1], _imu.raw.gyro[2]);
+        }
+        bus_time += time_micros_now() - bus_start;
+        xSemaphoreGive(_i2c_cfg->xSemaphore);
 
-            if (cnt == 0) 
+        if (++bus_loops == IMU_BUS_STATS_INTERVAL)
+        {
+            LOG_D(TAG, "I2C %uus per loop, %u snapshot retries", (unsigned)(bus_time / bus_loops), _snapshot_retries);
+            bus_time = 0;
+            bus_loops = 0;
+        }
+
+        // The filter steps once per sample, integrating over the time between them
+        mag_updated = false;
+        for (int ii = 0; ii < n; ii++)
+        {
+            // The AK8963 only measures at 100Hz, other samples keep the last reading
+            if (_samples[ii].mag_updated)
             {
-                mpu9250_read_mag(&_mpu9250, &_imu.raw);
-                //int deg = 180 + atan2(_imu.raw.mag[1], _imu.raw.mag[0]) * 180 / PI;
-                //LOG_I(TAG, "mag[0] %5d | mag[1] %5d | mag[2] %5d | deg %3d", _imu.raw.mag[0], _imu.raw.mag[1], _imu.raw.mag[2], deg);
+                memcpy(_imu.raw.mag, _samples[ii].mag, sizeof(_imu.raw.mag));
+                mag_updated = true;
             }
-            cnt++;
-            if (cnt >= 25) cnt = 0;
+            memcpy(_imu.raw.accel, _samples[ii].accel, sizeof(_imu.raw.accel));
+            memcpy(_imu.raw.gyro, _samples[ii].gyro, sizeof(_imu.raw.gyro));
+            _imu.raw.temp = _samples[ii].temp;
+            _imu.raw.time = _samples[ii].time;
+            _imu.raw.mag_updated = _samples[ii].mag_updated;
+
+            imu_update(&_imu);
+            imu_log_push(&_imu, &_imu.raw);
+            imu_task_update_gyro_bias();
         }
-        xSemaphoreGive(_mpu9250.mpu9250_i2c_cfg.i2c_cfg->xSemaphore);
-
-        imu_update(&_imu);
+        imu_task_save_gyro_bias();
 
         ATP_SET_FLOAT(TAG_TRACKER_ROLL, _imu.data.orientation[0], time_micros_now());
         ATP_SET_FLOAT(TAG_TRACKER_PITCH, _imu.data.orientation[1], time_micros_now());
-        ATP_SET_FLOAT(TAG_TRACKER_YAW, _imu.data.orientation[2], time_micros_now());
+        // Heading is only worth publishing when the mag has actually moved it
+        if (mag_updated)
+        {
+            ATP_SET_FLOAT(TAG_TRACKER_YAW, _imu.data.orientation[2], time_micros_now());
+        }
         ATP_SET_U32(TAG_TRACKER_IMU_HZ, fq_hz, time_micros_now());
 
         if (_imu.mode != imu_mode_normal)
@@ -279,6 +538,7 @@ static void imu_task(void *pvParameters)
                 {
                     imu_gyro_calibration_finish(&_imu);
                     imu_task_save_calibration();
+                    gyro_bias_init(_imu.cal.gyro_off);
                 }
                 break;
 
@@ -297,14 +557,11 @@ static void imu_task(void *pvParameters)
             }
         }
 
-        xSemaphoreGive(_mutex);
-        _loop_cnt++;
+        imu_task_publish();
+        // Counts samples, so fq_hz is the rate actually reaching the filter
+        _loop_cnt += MAX(n, 0);
 
         fq_hz = (_loop_cnt * 1000 / (time_millis_now() - fq));
-        _imu.filter.invSampleFreq = 1.0f / fq_hz;
-#if USE_MADGWICK == 1
-        _imu.filter.sampleFreq = fq_hz;
-#endif
     }
 }
 
@@ -315,21 +572,38 @@ void imu_task_init(hal_i2c_config_t *i2c_cfg)
     if (settings_get_key_bool(SETTING_KEY_IMU_ENABLE))
     {
         storage_init(&storage, IMU_STORAGE_KEY);
+        _save_mutex = xSemaphoreCreateMutex();
 
-        _mpu9250.mpu9250_i2c_cfg.i2c_cfg = i2c_cfg;
-        _mpu9250.mpu9250_i2c_cfg.rst = HAL_GPIO_NONE;
-        _mpu9250.mpu9250_i2c_cfg.addr = MPU9250_I2C_ADDR;
-        _mpu9250.mpu9250_i2c_cfg.ak8963_addr = AK8963_I2C_ADDR;
+        _i2c_cfg = i2c_cfg;
 
         imu_init(&_imu);
+        imu_log_init();
 
         imu_task_load_calibration();
 
-        _mutex = xSemaphoreCreateMutex();
+        _gyro_auto_bias = settings_get_key(SETTING_KEY_IMU_GYRO_AUTO_BIAS);
+        gyro_bias_init(_imu.cal.gyro_off);
+
+        imu_task_publish();
 
         _cmd_queue = xQueueCreate(10, sizeof(uint32_t));
 
-        mpu9250_init(&_mpu9250, MPU9250_Accelerometer_8G, MPU9250_Gyroscope_1000s, &_imu.lsb);
+        _driver = imu_driver_probe(i2c_cfg, &_imu.lsb);
+        if (_driver)
+        {
+            if (!_driver->self_test())
+            {
+                LOG_E(TAG, "%s self test failed", _driver->name);
+            }
+            _imu.fused = _driver->fused;
+            // One chip, so the accel alignment stands for all three sensors
+            if (_driver->set_alignment && !_driver->set_alignment(_imu.accel_align))
+            {
+                LOG_E(TAG, "%s can't take alignment %d", _driver->name, _imu.accel_align);
+            }
+            _sample_rate_hz = _driver->start(IMU_SAMPLE_RATE_HZ);
+            sample_clock_init(&_sample_clock, _sample_rate_hz);
+        }
 
         xTaskCreatePinnedToCore(imu_task, "IMU_Task", 4096, NULL, 1, NULL, 0);
     }
@@ -340,14 +614,14 @@ void imu_task_get_raw_and_data(imu_mode_t *mode,
                                imu_sensor_data_t *calibrated,
                                imu_data_t *data)
 {
-    xSemaphoreTake(_mutex, portMAX_DELAY);
+    imu_task_snapshot_t snapshot;
 
-    *mode = _imu.mode;
-    memcpy(raw, &_imu.raw, sizeof(imu_sensor_data_t));
-    memcpy(calibrated, &_imu.adjusted, sizeof(imu_sensor_data_t));
-    memcpy(data, &_imu.data, sizeof(imu_data_t));
+    imu_task_read_snapshot(&snapshot);
 
-    xSemaphoreGive(_mutex);
+    *mode = snapshot.mode;
+    memcpy(raw, &snapshot.raw, sizeof(imu_sensor_data_t));
+    memcpy(calibrated, &snapshot.adjusted, sizeof(imu_sensor_data_t));
+    memcpy(data, &snapshot.data, sizeof(imu_data_t));
 }
 
 void imu_task_get_mag_calibration(imu_mode_t *mode,
@@ -355,32 +629,32 @@ void imu_task_get_mag_calibration(imu_mode_t *mode,
                                   int16_t calibrated[3],
                                   int16_t mag_bias[3])
 {
-    xSemaphoreTake(_mutex, portMAX_DELAY);
+    imu_task_snapshot_t snapshot;
 
-    *mode = _imu.mode;
+    imu_task_read_snapshot(&snapshot);
 
-    raw[0] = _imu.raw.mag[0];
-    raw[1] = _imu.raw.mag[1];
-    raw[2] = _imu.raw.mag[2];
+    *mode = snapshot.mode;
 
-    calibrated[0] = _imu.adjusted.mag[0];
-    calibrated[1] = _imu.adjusted.mag[1];
-    calibrated[2] = _imu.adjusted.mag[2];
+    raw[0] = snapshot.raw.mag[0];
+    raw[1] = snapshot.raw.mag[1];
+    raw[2] = snapshot.raw.mag[2];
 
-    mag_bias[0] = _imu.cal.mag_bias[0];
-    mag_bias[1] = _imu.cal.mag_bias[1];
-    mag_bias[2] = _imu.cal.mag_bias[2];
+    calibrated[0] = snapshot.adjusted.mag[0];
+    calibrated[1] = snapshot.adjusted.mag[1];
+    calibrated[2] = snapshot.adjusted.mag[2];
 
-    xSemaphoreGive(_mutex);
+    mag_bias[0] = snapshot.cal.mag_bias[0];
+    mag_bias[1] = snapshot.cal.mag_bias[1];
+    mag_bias[2] = snapshot.cal.mag_bias[2];
 }
 
 void imu_task_get_cal_state(imu_sensor_calib_data_t *cal)
 {
-    xSemaphoreTake(_mutex, portMAX_DELAY);
+    imu_task_snapshot_t snapshot;
 
-    memcpy(cal, &_imu.cal, sizeof(imu_sensor_calib_data_t));
+    imu_task_read_snapshot(&snapshot);
 
-    xSemaphoreGive(_mutex);
+    memcpy(cal, &snapshot.cal, sizeof(imu_sensor_calib_data_t));
 }
 
 uint32_t imu_task_get_loop_cnt(void)
@@ -388,6 +662,11 @@ uint32_t imu_task_get_loop_cnt(void)
     return _loop_cnt;
 }
 
+uint32_t imu_task_get_snapshot_retries(void)
+{
+    return _snapshot_retries;
+}
+
 void imu_task_do_mag_calibration(void)
 {
     imu_task_command_t cmd = imu_task_perform_mag_calibration;
@@ -2,7 +2,7 @@
 #define __IMU_TASK_DEF_H__
 
 #include "imu.h"
-#include "driver/mpu9250.h"
+#include "driver/imu_driver.h"
 
 extern void imu_task_init(hal_i2c_config_t *i2c_cfg);
 
@@ -19,6 +19,8 @@ extern void imu_task_get_raw_and_data(imu_mode_t* mode,
     imu_data_t* data);
 
 extern uint32_t imu_task_get_loop_cnt(void);
+// Times a reader had to copy the IMU state again because it was published meanwhile
+extern uint32_t imu_task_get_snapshot_retries(void);
 
 extern void imu_task_get_cal_state(imu_sensor_calib_data_t* cal);
 
@@ -1,13 +1,321 @@
 #include <math.h>
+#include <string.h>
 
 #include "mag_calibration.h"
 #include "sensor_calib.h"
+#include <hal/log.h>
+
+/*
+   Hard iron (the board and anything magnetized nearby) moves the center of the
+   sphere the mag traces while rotating. Soft iron (the motors and the frame)
+   squeezes it into an ellipsoid, which offsets alone can't undo, so heading
+   error would change with the pan angle. Samples are fitted to the general
+   ellipsoid
+
+      A x² + B y² + C z² + 2D xy + 2E xz + 2F yz + 2G x + 2H y + 2I z = 1
+
+   by least squares, accumulating the normal equations so memory doesn't grow
+   with the sample count. The center gives the offsets and the shape gives the
+   matrix mapping the ellipsoid back to a sphere:
+
+      actual = soft_iron * (raw - offset)
+
+   soft_iron has determinant 1, so the field keeps its average magnitude.
+*/
+
+#define ELLIPSOID_PARAMS 9
+
+static const char *TAG = "mag_calibration";
 
 static int32_t _mag_prev[3];
 static int16_t _mag_offset[3];
 
 static sensor_calib_t _cal_state;
 
+// Normal equations of the ellipsoid fit. Doubles, since sums of x⁴ over a
+// whole calibration don't fit in a float's precision.
+static double _XtX[ELLIPSOID_PARAMS][ELLIPSOID_PARAMS];
+static double _XtY[ELLIPSOID_PARAMS];
+// Samples are divided by the first one's magnitude to keep the sums near 1
+static double _norm;
+static uint32_t _samples;
+
+static void mag_calibration_push_ellipsoid(const int32_t mag[3])
+{
+    double row[ELLIPSOID_PARAMS];
+
+    if (_norm == 0)
+    {
+        _norm = sqrt((double)mag[0] * mag[0] + (double)mag[1] * mag[1] + (double)mag[2] * mag[2]);
+        if (_norm == 0)
+        {
+            return;
+        }
+    }
+
+    double x = mag[0] / _norm;
+    double y = mag[1] / _norm;
+    double z = mag[2] / _norm;
+
+    row[0] = x * x;
+    row[1] = y * y;
+    row[2] = z * z;
+    row[3] = 2 * x * y;
+    row[4] = 2 * x * z;
+    row[5] = 2 * y * z;
+    row[6] = 2 * x;
+    row[7] = 2 * y;
+    row[8] = 2 * z;
+
+    // Symmetric, the lower half is filled in when solving
+    for (int i = 0; i < ELLIPSOID_PARAMS; i++)
+    {
+        for (int j = i; j < ELLIPSOID_PARAMS; j++)
+        {
+            _XtX[i][j] += row[i] * row[j];
+        }
+        _XtY[i] += row[i];
+    }
+    _samples++;
+}
+
+// Gaussian elimination with partial pivoting, destroys A and b
+static bool mag_calibration_solve(double A[ELLIPSOID_PARAMS][ELLIPSOID_PARAMS], double b[ELLIPSOID_PARAMS], double x[ELLIPSOID_PARAMS])
+{
+    const int n = ELLIPSOID_PARAMS;
+
+    for (int col = 0; col < n; col++)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++)
+        {
+            if (fabs(A[row][col]) > fabs(A[pivot][col]))
+            {
+                pivot = row;
+            }
+        }
+        if (fabs(A[pivot][col]) < 1e-12)
+        {
+            return false;
+        }
+        if (pivot != col)
+        {
+            for (int k = 0; k < n; k++)
+            {
+                double tmp = A[col][k];
+                A[col][k] = A[pivot][k];
+                A[pivot][k] = tmp;
+            }
+            double tmp = b[col];
+            b[col] = b[pivot];
+            b[pivot] = tmp;
+        }
+        for (int row = col + 1; row < n; row++)
+        {
+            double f = A[row][col] / A[col][col];
+            for (int k = col; k < n; k++)
+            {
+                A[row][k] -= f * A[col][k];
+            }
+            b[row] -= f * b[col];
+        }
+    }
+
+    for (int row = n - 1; row >= 0; row--)
+    {
+        x[row] = b[row];
+        for (int k = row + 1; k < n; k++)
+        {
+            x[row] -= A[row][k] * x[k];
+        }
+        x[row] /= A[row][row];
+    }
+    return true;
+}
+
+static bool mag_calibration_invert3(const double m[3][3], double inv[3][3])
+{
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+    if (fabs(det) < 1e-12)
+    {
+        return false;
+    }
+
+    inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+    inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+    inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+    inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+    inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+    inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+    inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+    inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+    inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+    return true;
+}
+
+// Jacobi rotations, m = V diag(eig) Vᵀ. m is destroyed.
+static void mag_calibration_eigen3(double m[3][3], double eig[3], double V[3][3])
+{
+    memset(V, 0, sizeof(double) * 9);
+    V[0][0] = V[1][1] = V[2][2] = 1;
+
+    for (int sweep = 0; sweep < 50; sweep++)
+    {
+        double off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+        if (off < 1e-20)
+        {
+            break;
+        }
+
+        for (int p = 0; p < 2; p++)
+        {
+            for (int q = p + 1; q < 3; q++)
+            {
+                if (fabs(m[p][q]) < 1e-30)
+                {
+                    continue;
+                }
+                double theta = (m[q][q] - m[p][p]) / (2 * m[p][q]);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1);
+                double s = t * c;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    double mkp = m[k][p];
+                    double mkq = m[k][q];
+                    m[k][p] = c * mkp - s * mkq;
+                    m[k][q] = s * mkp + c * mkq;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    double mpk = m[p][k];
+                    double mqk = m[q][k];
+                    m[p][k] = c * mpk - s * mqk;
+                    m[q][k] = s * mpk + c * mqk;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    double vkp = V[k][p];
+                    double vkq = V[k][q];
+                    V[k][p] = c * vkp - s * vkq;
+                    V[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        eig[i] = m[i][i];
+    }
+}
+
+static bool mag_calibration_fit_ellipsoid(int16_t offsets[3], int16_t soft_iron[3][3])
+{
+    double p[ELLIPSOID_PARAMS];
+    double M[3][3], Minv[3][3], V[3][3];
+    double center[3], eig[3];
+
+    if (_samples < MAG_CALIBRATION_MIN_SAMPLES)
+    {
+        LOG_I(TAG, "%u samples, too few for the ellipsoid fit", _samples);
+        return false;
+    }
+
+    for (int i = 0; i < ELLIPSOID_PARAMS; i++)
+    {
+        for (int j = 0; j < i; j++)
+        {
+            _XtX[i][j] = _XtX[j][i];
+        }
+    }
+
+    if (!mag_calibration_solve(_XtX, _XtY, p))
+    {
+        LOG_I(TAG, "ellipsoid fit is singular, the rotation didn't cover enough directions");
+        return false;
+    }
+
+    M[0][0] = p[0];
+    M[1][1] = p[1];
+    M[2][2] = p[2];
+    M[0][1] = M[1][0] = p[3];
+    M[0][2] = M[2][0] = p[4];
+    M[1][2] = M[2][1] = p[5];
+
+    if (!mag_calibration_invert3(M, Minv))
+    {
+        return false;
+    }
+
+    // Moving the origin to the center leaves (u - c)ᵀ M (u - c) = 1 + cᵀ M c
+    double k = 1;
+    for (int i = 0; i < 3; i++)
+    {
+        center[i] = -(Minv[i][0] * p[6] + Minv[i][1] * p[7] + Minv[i][2] * p[8]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            k += center[i] * M[i][j] * center[j];
+        }
+    }
+
+    if (k <= 0)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            M[i][j] /= k;
+        }
+    }
+
+    mag_calibration_eigen3(M, eig, V);
+
+    // Any non positive eigenvalue means it's not an ellipsoid
+    if (eig[0] <= 0 || eig[1] <= 0 || eig[2] <= 0)
+    {
+        LOG_I(TAG, "fit is not an ellipsoid");
+        return false;
+    }
+
+    double eig_min = fmin(eig[0], fmin(eig[1], eig[2]));
+    double eig_max = fmax(eig[0], fmax(eig[1], eig[2]));
+    // Axes go with 1 / sqrt(eigenvalue)
+    if (sqrt(eig_max / eig_min) > MAG_CALIBRATION_MAX_AXIS_RATIO)
+    {
+        LOG_I(TAG, "ellipsoid axes ratio %.2f is too large", sqrt(eig_max / eig_min));
+        return false;
+    }
+
+    // soft_iron = V diag(sqrt(eig)) Vᵀ, scaled to determinant 1
+    double scale = pow(eig[0] * eig[1] * eig[2], -1.0 / 6);
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            double w = 0;
+            for (int n = 0; n < 3; n++)
+            {
+                w += V[i][n] * sqrt(eig[n]) * V[j][n];
+            }
+            soft_iron[i][j] = lrint(w * scale * MAG_CALIBRATION_ONE);
+        }
+        offsets[i] = lrint(center[i] * _norm);
+    }
+
+    return true;
+}
+
 void mag_calibration_init(void)
 {
     _mag_prev[0] =
@@ -15,6 +323,11 @@ void mag_calibration_init(void)
             _mag_prev[2] = 0;
 
     sensorCalibrationResetState(&_cal_state);
+
+    memset(_XtX, 0, sizeof(_XtX));
+    memset(_XtY, 0, sizeof(_XtY));
+    _norm = 0;
+    _samples = 0;
 }
 
 void mag_calibration_update(int16_t mx, int16_t my, int16_t mz)
@@ -37,6 +350,7 @@ void mag_calibration_update(int16_t mx, int16_t my, int16_t mz)
     if ((avgMag > 0.01f) && ((diffMag / avgMag) > (0.14f * 0.14f)))
     {
         sensorCalibrationPushSampleForOffsetCalculation(&_cal_state, mag_data);
+        mag_calibration_push_ellipsoid(mag_data);
 
         for (int axis = 0; axis < 3; axis++)
         {
@@ -45,10 +359,17 @@ void mag_calibration_update(int16_t mx, int16_t my, int16_t mz)
     }
 }
 
-void mag_calibration_finish(int16_t offsets[3])
+bool mag_calibration_finish(int16_t offsets[3], int16_t soft_iron[3][3])
 {
     float magZerof[3];
 
+    if (mag_calibration_fit_ellipsoid(offsets, soft_iron))
+    {
+        LOG_I(TAG, "ellipsoid fit from %u samples", _samples);
+        return true;
+    }
+
+    // Falls back to the sphere fit, offsets only
     sensorCalibrationSolveForOffset(&_cal_state, magZerof);
 
     for (int axis = 0; axis < 3; axis++)
@@ -59,4 +380,13 @@ void mag_calibration_finish(int16_t offsets[3])
     offsets[0] = _mag_offset[0];
     offsets[1] = _mag_offset[1];
     offsets[2] = _mag_offset[2];
-}
\ No newline at end of file
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            soft_iron[i][j] = i == j ? MAG_CALIBRATION_ONE : 0;
+        }
+    }
+    return false;
+}
@@ -1,10 +1,20 @@
 #ifndef __MAG_CALIBRATION_DEF_H__
 #define __MAG_CALIBRATION_DEF_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Fixed point of the soft iron matrix, as accel_scale
+#define MAG_CALIBRATION_ONE 4096
+// Samples needed before the ellipsoid fit is tried, offsets only otherwise
+#define MAG_CALIBRATION_MIN_SAMPLES 50
+// Longest/shortest ellipsoid axis accepted, more means the fit went wrong
+#define MAG_CALIBRATION_MAX_AXIS_RATIO 2.0f
+
 extern void mag_calibration_init(void);
 extern void mag_calibration_update(int16_t mx, int16_t my, int16_t mz);
-extern void mag_calibration_finish(int16_t offsets[3]);
+// soft_iron is applied after subtracting offsets, in MAG_CALIBRATION_ONE units.
+// Returns false when only the offsets could be found, soft_iron is identity then.
+extern bool mag_calibration_finish(int16_t offsets[3], int16_t soft_iron[3][3]);
 
-#endif /* !__MAG_CALIBRATION_DEF_H__ */
\ No newline at end of file
+#endif /* !__MAG_CALIBRATION_DEF_H__ */
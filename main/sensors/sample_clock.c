@@ -0,0 +1,48 @@
+#include "sample_clock.h"
+
+static time_micros_t sample_clock_time(const sample_clock_t *clock, uint32_t count)
+{
+    // From the anchor every time, so a period that isn't a whole number of
+    // microseconds doesn't add up rounding errors
+    return clock->anchor + (time_micros_t)count * MICROS_PER_SEC / clock->rate_hz;
+}
+
+void sample_clock_init(sample_clock_t *clock, uint16_t rate_hz)
+{
+    clock->rate_hz = rate_hz;
+    sample_clock_reset(clock);
+}
+
+void sample_clock_reset(sample_clock_t *clock)
+{
+    clock->anchor = 0;
+    clock->count = 0;
+}
+
+void sample_clock_burst(sample_clock_t *clock, int n, time_micros_t now)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+
+    if (clock->anchor != 0)
+    {
+        // The newest sample was taken just before now, a bit earlier if the read was late
+        time_micros_t newest = sample_clock_time(clock, clock->count + n - 1);
+        if (newest <= now + SAMPLE_CLOCK_MAX_ERROR_US && newest + SAMPLE_CLOCK_MAX_ERROR_US >= now)
+        {
+            return;
+        }
+    }
+
+    // The newest sample was taken just before the read, the older ones
+    // 1 / rate_hz apart
+    clock->anchor = now - (time_micros_t)(n - 1) * MICROS_PER_SEC / clock->rate_hz;
+    clock->count = 0;
+}
+
+time_micros_t sample_clock_next(sample_clock_t *clock)
+{
+    return sample_clock_time(clock, clock->count++);
+}
@@ -0,0 +1,31 @@
+#ifndef __SAMPLE_CLOCK_DEF_H__
+#define __SAMPLE_CLOCK_DEF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/time.h"
+
+// Further than this from the read time and the part's oscillator has drifted
+// away from ours, the clock is re-anchored
+#define SAMPLE_CLOCK_MAX_ERROR_US (100 * 1000)
+
+// Gives FIFO samples evenly spaced timestamps. Read times jitter with the
+// task scheduling, the samples themselves were taken at the part's own rate.
+typedef struct
+{
+    uint16_t rate_hz;
+    // Time of sample 0 and samples stamped since, 0 and 0 when not anchored
+    time_micros_t anchor;
+    uint32_t count;
+} sample_clock_t;
+
+extern void sample_clock_init(sample_clock_t *clock, uint16_t rate_hz);
+// Forgets the timeline, e.g. after the FIFO overflowed and was reset
+extern void sample_clock_reset(sample_clock_t *clock);
+// Call for each burst of n samples read at now, then sample_clock_next() n times
+extern void sample_clock_burst(sample_clock_t *clock, int n, time_micros_t now);
+// Time of the next sample of the burst, oldest first
+extern time_micros_t sample_clock_next(sample_clock_t *clock);
+
+#endif /* !__SAMPLE_CLOCK_DEF_H__ */
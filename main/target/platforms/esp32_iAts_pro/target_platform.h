@@ -93,6 +93,8 @@
 
 #if defined(USE_IMU)
     #define MPU9250
+    // MPU9250 INT pin. Without it the IMU task polls the FIFO every IMU_POLL_INTERVAL.
+    //#define IMU_INT_GPIO 25
 #endif
 
 #define BOARD_NAME "iAts_pro"
\ No newline at end of file
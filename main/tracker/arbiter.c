@@ -0,0 +1,156 @@
+#include <string.h>
+
+#include <hal/log.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "protocols/atp.h"
+#include "arbiter.h"
+
+static const char *TAG = "Tracker.Arbiter";
+
+static const char *arbiter_source_names[ARBITER_SOURCE_COUNT] = {
+    [PROTOCOL_IO_ATP] = "ATP",
+    [PROTOCOL_IO_BLUETOOTH] = "BLUETOOTH",
+    [PROTOCOL_IO_UART1] = "UART1",
+    [PROTOCOL_IO_UART2] = "UART2",
+};
+
+static SemaphoreHandle_t _mutex;
+
+void arbiter_init(arbiter_t *arbiter, atp_t *atp)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    memset(arbiter->fixes, 0, sizeof(arbiter->fixes));
+    arbiter->selected = ARBITER_SOURCE_NONE;
+    arbiter->switches = 0;
+    arbiter->atp = atp;
+
+    _mutex = xSemaphoreCreateMutex();
+}
+
+static bool arbiter_is_fresh(const position_fix_t *fix, time_micros_t now)
+{
+    if (fix->time == 0)
+    {
+        return false;
+    }
+    // Fixes from other tasks might be slightly newer than now
+    return fix->time >= now || now - fix->time < MILLIS_TO_MICROS(ARBITER_STALE_MS);
+}
+
+static int8_t arbiter_select(const arbiter_t *arbiter, time_micros_t now)
+{
+    int8_t best = ARBITER_SOURCE_NONE;
+
+    for (int ii = 0; ii < ARBITER_SOURCE_COUNT; ii++)
+    {
+        if (!arbiter_is_fresh(&arbiter->fixes[ii], now))
+        {
+            continue;
+        }
+        if (best == ARBITER_SOURCE_NONE || arbiter->fixes[ii].accuracy < arbiter->fixes[best].accuracy)
+        {
+            best = ii;
+        }
+    }
+
+    int8_t current = arbiter->selected;
+    if (best != current && current != ARBITER_SOURCE_NONE && arbiter_is_fresh(&arbiter->fixes[current], now))
+    {
+        // Don't flip between sources with similar accuracy, the positions
+        // reported by two links are never exactly the same.
+        if (arbiter->fixes[best].accuracy * ARBITER_SWITCH_RATIO > arbiter->fixes[current].accuracy)
+        {
+            return current;
+        }
+    }
+
+    return best;
+}
+
+static bool arbiter_publish(const position_fix_t *fix)
+{
+    bool changed = telemetry_set_i32(atp_get_telemetry_tag_val(TAG_PLANE_LATITUDE), fix->latitude, fix->time);
+    changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_PLANE_LONGITUDE), fix->longitude, fix->time);
+    changed |= telemetry_set_i32(atp_get_telemetry_tag_val(TAG_PLANE_ALTITUDE), fix->altitude, fix->time);
+    return changed;
+}
+
+static void arbiter_switch(arbiter_t *arbiter, int8_t selected)
+{
+    LOG_I(TAG, "Position source [%s] -> [%s]",
+          arbiter->selected == ARBITER_SOURCE_NONE ? "NONE" : arbiter_source_names[arbiter->selected],
+          selected == ARBITER_SOURCE_NONE ? "NONE" : arbiter_source_names[selected]);
+
+    arbiter->selected = selected;
+    arbiter->switches++;
+}
+
+static void arbiter_notify(arbiter_t *arbiter)
+{
+    arbiter->atp->tag_value_changed(arbiter->atp->tracker, TAG_PLANE_LATITUDE);
+    arbiter->atp->tag_value_changed(arbiter->atp->tracker, TAG_PLANE_LONGITUDE);
+}
+
+bool arbiter_update_fix(arbiter_t *arbiter, protocol_io_source_e source, const position_fix_t *fix)
+{
+    bool changed = false;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    arbiter->fixes[source] = *fix;
+
+    int8_t selected = arbiter_select(arbiter, fix->time);
+    if (selected != arbiter->selected)
+    {
+        arbiter_switch(arbiter, selected);
+    }
+
+    bool is_selected = selected == source;
+    if (is_selected)
+    {
+        changed = arbiter_publish(fix);
+    }
+
+    xSemaphoreGive(_mutex);
+
+    if (changed)
+    {
+        arbiter_notify(arbiter);
+    }
+
+    return is_selected;
+}
+
+void arbiter_update(arbiter_t *arbiter, time_micros_t now)
+{
+    bool changed = false;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    int8_t selected = arbiter_select(arbiter, now);
+    if (selected != arbiter->selected)
+    {
+        // The selected link went stale, fall back to the best remaining one
+        arbiter_switch(arbiter, selected);
+        if (selected != ARBITER_SOURCE_NONE)
+        {
+            changed = arbiter_publish(&arbiter->fixes[selected]);
+        }
+    }
+
+    xSemaphoreGive(_mutex);
+
+    if (changed)
+    {
+        arbiter_notify(arbiter);
+    }
+}
+
+int8_t arbiter_get_selected(const arbiter_t *arbiter)
+{
+    return arbiter->selected;
+}
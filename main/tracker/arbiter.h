@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/time.h"
+#include "protocols/protocol.h"
+
+// Fixes older than this are not used for tracking
+#define ARBITER_STALE_MS 1500
+// Horizontal accuracy assumed for protocols that don't report one
+#define ARBITER_ACCURACY_UNKNOWN_CM 1000
+// Another fresh source must be this many times more accurate to take over
+#define ARBITER_SWITCH_RATIO 2
+
+#define ARBITER_SOURCE_COUNT (PROTOCOL_IO_UART2 + 1)
+#define ARBITER_SOURCE_NONE -1
+
+typedef struct atp_s atp_t;
+
+typedef struct position_fix_s
+{
+    int32_t latitude;  // degrees * 1e7
+    int32_t longitude; // degrees * 1e7
+    int32_t altitude;  // cm
+    uint32_t accuracy; // cm, horizontal
+    time_micros_t time;
+} position_fix_t;
+
+typedef struct arbiter_s
+{
+    position_fix_t fixes[ARBITER_SOURCE_COUNT];
+    int8_t selected;
+    uint32_t switches;
+    atp_t *atp;
+} arbiter_t;
+
+void arbiter_init(arbiter_t *arbiter, atp_t *atp);
+// Stores the fix for its source and publishes it to the plane tags if the
+// source is the best one. Returns true iff the source is the selected one.
+bool arbiter_update_fix(arbiter_t *arbiter, protocol_io_source_e source, const position_fix_t *fix);
+// Drops stale sources and switches to the next best one, call once per tracker cycle
+void arbiter_update(arbiter_t *arbiter, time_micros_t now);
+int8_t arbiter_get_selected(const arbiter_t *arbiter);
@@ -0,0 +1,283 @@
+#include <hal/log.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "../components/c_library_v2/common/mavlink.h"
+#include "protocols/mavlink_router.h"
+#include "protocols/atp.h"
+#include "config/settings.h"
+#include "util/calc.h"
+#include "mavlink_tracker.h"
+#include "tracker.h"
+
+static const char *TAG = "Tracker.Mavlink";
+
+// Indexed by SETTING_KEY_PORT_MAVLINK_RATE
+static const uint8_t mavlink_tracker_rates[] = {0, 1, 2, 5, 10};
+
+// Acks are packed on MAVLINK_COMM_0 like everything else we send, so they're
+// sent from the tracker task and not from whichever task received the command
+static xQueueHandle _ack_queue = NULL;
+
+static mavlink_tracker_mode_e mavlink_tracker_get_mode(const tracker_t *t)
+{
+    switch (t->internal.status)
+    {
+    case TRACKER_STATUS_TRACKING:
+        return MAVLINK_TRACKER_MODE_AUTO;
+    case TRACKER_STATUS_MANUAL:
+        return MAVLINK_TRACKER_MODE_MANUAL;
+    default:
+        break;
+    }
+    return MAVLINK_TRACKER_MODE_INITIALISING;
+}
+
+static bool mavlink_tracker_request_mode(mavlink_tracker_t *mavlink_tracker, uint32_t custom_mode)
+{
+    switch (custom_mode)
+    {
+    case MAVLINK_TRACKER_MODE_MANUAL:
+    case MAVLINK_TRACKER_MODE_AUTO:
+        mavlink_tracker->requested_mode = custom_mode;
+        return true;
+    }
+    LOG_I(TAG, "Unsupported mode %u requested", custom_mode);
+    return false;
+}
+
+static void mavlink_tracker_queue_ack(const mavlink_message_t *msg, uint16_t command, uint8_t result)
+{
+    mavlink_command_ack_t ack = {
+        .command = command,
+        .result = result,
+        .target_system = msg->sysid,
+        .target_component = msg->compid,
+    };
+    // Never block the receiving task, the GCS retries unacked commands
+    if (!xQueueSend(_ack_queue, &ack, 0))
+    {
+        LOG_W(TAG, "Ack queue full, dropping ack for command %u", command);
+    }
+}
+
+static void mavlink_tracker_send_acks(void)
+{
+    mavlink_command_ack_t ack;
+    mavlink_message_t reply;
+
+    while (xQueueReceive(_ack_queue, &ack, 0))
+    {
+        mavlink_msg_command_ack_encode(MAVLINK_TRACKER_SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &reply, &ack);
+        mavlink_router_send(&reply);
+    }
+}
+
+static void mavlink_tracker_handle_message(void *data, const mavlink_message_t *msg)
+{
+    mavlink_tracker_t *mavlink_tracker = data;
+
+    switch (msg->msgid)
+    {
+    case MAVLINK_MSG_ID_SET_MODE:
+    {
+        mavlink_set_mode_t set_mode;
+        mavlink_msg_set_mode_decode(msg, &set_mode);
+        if (set_mode.target_system == MAVLINK_TRACKER_SYSTEM_ID)
+        {
+            mavlink_tracker_request_mode(mavlink_tracker, set_mode.custom_mode);
+        }
+        break;
+    }
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+    {
+        mavlink_command_long_t command;
+        mavlink_msg_command_long_decode(msg, &command);
+        // Only commands addressed to us, a broadcast DO_SET_MODE is meant for the
+        // vehicle and other broadcasts are answered by whoever supports them
+        if (command.target_system != MAVLINK_TRACKER_SYSTEM_ID)
+        {
+            break;
+        }
+        if (command.command == MAV_CMD_DO_SET_MODE)
+        {
+            bool accepted = mavlink_tracker_request_mode(mavlink_tracker, (uint32_t)command.param2);
+            mavlink_tracker_queue_ack(msg, command.command, accepted ? MAV_RESULT_ACCEPTED : MAV_RESULT_DENIED);
+        }
+        else
+        {
+            mavlink_tracker_queue_ack(msg, command.command, MAV_RESULT_UNSUPPORTED);
+        }
+        break;
+    }
+    case MAVLINK_MSG_ID_MANUAL_CONTROL:
+    {
+        mavlink_manual_control_t manual_control;
+        mavlink_msg_manual_control_decode(msg, &manual_control);
+        // Must be for us, otherwise the same sticks would also fly the vehicle
+        if (manual_control.target != MAVLINK_TRACKER_SYSTEM_ID)
+        {
+            break;
+        }
+        // INT16_MAX marks an axis the GCS doesn't send
+        mavlink_tracker->manual.pan = manual_control.r == INT16_MAX ? 0 : manual_control.r;
+        mavlink_tracker->manual.tilt = manual_control.x == INT16_MAX ? 0 : manual_control.x;
+        mavlink_tracker->manual.time = time_micros_now();
+        break;
+    }
+    }
+}
+
+static void mavlink_tracker_manual_control(mavlink_tracker_t *mavlink_tracker, time_micros_t now, float dt)
+{
+    tracker_t *t = mavlink_tracker->tracker;
+    servo_t *servo = t->servo;
+
+    if (t->internal.status != TRACKER_STATUS_MANUAL || now - mavlink_tracker->manual.time > MILLIS_TO_MICROS(MAVLINK_TRACKER_MANUAL_TIMEOUT_MS))
+    {
+        mavlink_tracker->manual.active = false;
+        return;
+    }
+
+    if (!mavlink_tracker->manual.active)
+    {
+        // Start from wherever the antenna is pointing now
+        mavlink_tracker->manual.pan_degree = servo->internal.pan.currtent_degree;
+        mavlink_tracker->manual.tilt_degree = servo->internal.tilt.currtent_degree;
+        mavlink_tracker->manual.active = true;
+    }
+
+    mavlink_tracker->manual.pan_degree += mavlink_tracker->manual.pan / 1000.0f * MAVLINK_TRACKER_MANUAL_RATE_DPS * dt;
+    mavlink_tracker->manual.tilt_degree += mavlink_tracker->manual.tilt / 1000.0f * MAVLINK_TRACKER_MANUAL_RATE_DPS * dt;
+
+    if (mavlink_tracker->manual.pan_degree < 0)
+    {
+        mavlink_tracker->manual.pan_degree += 360;
+    }
+    else if (mavlink_tracker->manual.pan_degree >= 360)
+    {
+        mavlink_tracker->manual.pan_degree -= 360;
+    }
+    mavlink_tracker->manual.tilt_degree = constrain(mavlink_tracker->manual.tilt_degree, 0, 90);
+
+    uint16_t pan = (uint16_t)mavlink_tracker->manual.pan_degree % 360;
+    uint16_t tilt = (uint16_t)mavlink_tracker->manual.tilt_degree;
+
+    if (pan != servo->internal.pan.currtent_degree)
+    {
+        servo->internal.pan.currtent_degree = pan;
+        servo_pulsewidth_control(&servo->internal.pan, &servo->internal.ease_config);
+    }
+
+    if (tilt != servo->internal.tilt.currtent_degree)
+    {
+        servo->internal.tilt.currtent_degree = tilt;
+        servo_pulsewidth_control(&servo->internal.tilt, &servo->internal.ease_config);
+    }
+}
+
+static void mavlink_tracker_send_heartbeat(mavlink_tracker_t *mavlink_tracker)
+{
+    tracker_t *t = mavlink_tracker->tracker;
+    mavlink_tracker_mode_e mode = mavlink_tracker_get_mode(t);
+    mavlink_message_t msg;
+
+    mavlink_heartbeat_t heartbeat = {
+        .type = MAV_TYPE_ANTENNA_TRACKER,
+        .autopilot = MAV_AUTOPILOT_ARDUPILOTMEGA,
+        .base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED | MAV_MODE_FLAG_SAFETY_ARMED |
+                     (mode == MAVLINK_TRACKER_MODE_AUTO ? MAV_MODE_FLAG_AUTO_ENABLED : MAV_MODE_FLAG_MANUAL_INPUT_ENABLED),
+        .custom_mode = mode,
+        .system_status = mode == MAVLINK_TRACKER_MODE_INITIALISING ? MAV_STATE_STANDBY : MAV_STATE_ACTIVE,
+        .mavlink_version = 3,
+    };
+    mavlink_msg_heartbeat_encode(MAVLINK_TRACKER_SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &msg, &heartbeat);
+    mavlink_router_send(&msg);
+}
+
+static void mavlink_tracker_send_state(mavlink_tracker_t *mavlink_tracker)
+{
+    tracker_t *t = mavlink_tracker->tracker;
+    uint16_t pan = servo_get_degree(&t->servo->internal.pan);
+    uint16_t tilt = servo_get_degree(&t->servo->internal.tilt);
+    uint32_t time_boot_ms = time_millis_now();
+    mavlink_message_t msg;
+
+    // The antenna is the "vehicle": yaw is where it points, pitch its elevation
+    mavlink_attitude_t attitude = {
+        .time_boot_ms = time_boot_ms,
+        .roll = radians(get_tracker_roll()),
+        .pitch = radians(tilt),
+        .yaw = radians(pan > 180 ? (int)pan - 360 : pan),
+    };
+    mavlink_msg_attitude_encode(MAVLINK_TRACKER_SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &msg, &attitude);
+    mavlink_router_send(&msg);
+
+    mavlink_global_position_int_t global_position = {
+        .time_boot_ms = time_boot_ms,
+        .lat = telemetry_get_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LATITUDE)),
+        .lon = telemetry_get_i32(atp_get_telemetry_tag_val(TAG_TRACKER_LONGITUDE)),
+        // cm to mm
+        .alt = telemetry_get_i32(atp_get_telemetry_tag_val(TAG_TRACKER_ALTITUDE)) * 10,
+        .hdg = pan * 100,
+    };
+    mavlink_msg_global_position_int_encode(MAVLINK_TRACKER_SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &msg, &global_position);
+    mavlink_router_send(&msg);
+}
+
+void mavlink_tracker_init(mavlink_tracker_t *mavlink_tracker, tracker_t *tracker)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    memset(mavlink_tracker, 0, sizeof(*mavlink_tracker));
+    mavlink_tracker->tracker = tracker;
+    mavlink_tracker->rate_setting = settings_get_key(SETTING_KEY_PORT_MAVLINK_RATE);
+    mavlink_tracker->requested_mode = -1;
+
+    if (!_ack_queue)
+    {
+        _ack_queue = xQueueCreate(MAVLINK_TRACKER_ACK_QUEUE_SIZE, sizeof(mavlink_command_ack_t));
+    }
+
+    mavlink_router_set_local(MAVLINK_TRACKER_SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, mavlink_tracker_handle_message, mavlink_tracker);
+
+    LOG_I(TAG, "Initialized as system %d", MAVLINK_TRACKER_SYSTEM_ID);
+}
+
+void mavlink_tracker_update(mavlink_tracker_t *mavlink_tracker, time_micros_t now)
+{
+    tracker_t *t = mavlink_tracker->tracker;
+    float dt = mavlink_tracker->last_update ? (now - mavlink_tracker->last_update) / 1e6f : 0;
+    mavlink_tracker->last_update = now;
+
+    int8_t mode = mavlink_tracker->requested_mode;
+    if (mode >= 0)
+    {
+        mavlink_tracker->requested_mode = -1;
+        LOG_I(TAG, "GCS set mode %d", mode);
+        t->internal.status_changed(t, mode == MAVLINK_TRACKER_MODE_MANUAL ? TRACKER_STATUS_MANUAL : TRACKER_STATUS_TRACKING);
+    }
+
+    mavlink_tracker_manual_control(mavlink_tracker, now, dt);
+    // Commands are answered even when streaming is off
+    mavlink_tracker_send_acks();
+
+    uint8_t rate = mavlink_tracker_rates[setting_get_u8(mavlink_tracker->rate_setting)];
+    if (rate == 0)
+    {
+        return;
+    }
+
+    if (now >= mavlink_tracker->next_heartbeat)
+    {
+        mavlink_tracker_send_heartbeat(mavlink_tracker);
+        mavlink_tracker->next_heartbeat = now + MILLIS_TO_MICROS(MAVLINK_TRACKER_HEARTBEAT_MS);
+    }
+
+    if (now >= mavlink_tracker->next_stream)
+    {
+        mavlink_tracker_send_state(mavlink_tracker);
+        mavlink_tracker->next_stream = now + SECS_TO_MICROS(1) / rate;
+    }
+}
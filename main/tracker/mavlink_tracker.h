@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/time.h"
+
+// Vehicles are usually system 1 and GCSs 255
+#define MAVLINK_TRACKER_SYSTEM_ID 2
+#define MAVLINK_TRACKER_HEARTBEAT_MS 1000
+// Manual control stops moving the servos if the GCS stops sending it
+#define MAVLINK_TRACKER_MANUAL_TIMEOUT_MS 500
+// Pan/tilt speed at full stick deflection
+#define MAVLINK_TRACKER_MANUAL_RATE_DPS 60
+// COMMAND_ACKs waiting for the tracker task to send them
+#define MAVLINK_TRACKER_ACK_QUEUE_SIZE 4
+
+// Same numbers as ArduPilot's AntennaTracker, so GCSs know their names
+typedef enum
+{
+    MAVLINK_TRACKER_MODE_MANUAL = 0,
+    MAVLINK_TRACKER_MODE_STOP = 1,
+    MAVLINK_TRACKER_MODE_AUTO = 10,
+    MAVLINK_TRACKER_MODE_INITIALISING = 16,
+} mavlink_tracker_mode_e;
+
+typedef struct tracker_s tracker_t;
+typedef struct setting_s setting_t;
+
+typedef struct mavlink_tracker_s
+{
+    tracker_t *tracker;
+    const setting_t *rate_setting;
+    time_micros_t next_heartbeat;
+    time_micros_t next_stream;
+    time_micros_t last_update;
+
+    // Written by the router from the IO/WiFi tasks, applied by the tracker task
+    volatile int8_t requested_mode;
+    struct
+    {
+        volatile int16_t pan;
+        volatile int16_t tilt;
+        volatile time_micros_t time;
+        bool active;
+        float pan_degree;
+        float tilt_degree;
+    } manual;
+} mavlink_tracker_t;
+
+void mavlink_tracker_init(mavlink_tracker_t *mavlink_tracker, tracker_t *tracker);
+// Streams our state and applies the commands received from GCSs. Call from the tracker task.
+void mavlink_tracker_update(mavlink_tracker_t *mavlink_tracker, time_micros_t now);
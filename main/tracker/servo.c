@@ -5,6 +5,9 @@
 
 // static const char *TAG = "servo";
 
+// Read by the IMU task, a 32 bit store is atomic
+static volatile time_millis_t _last_move = 0;
+
 void servo_init(servo_t *servo)
 {
     servo_pwm_initialize(servo);
@@ -53,6 +56,7 @@ void servo_pulsewidth_out(servo_status_t *status, uint16_t pulsewidth)
 {
     if (status->last_pulsewidth != pulsewidth) {
         servo_pwm_out(status, pulsewidth);
+        _last_move = time_millis_now();
     }
     status->last_pulsewidth = pulsewidth;
 }
@@ -139,6 +143,11 @@ uint16_t servo_ease_cal(ease_config_t *ease_config, servo_status_t *status)
     return easing_pulsewidth;
 }
 
+time_millis_t servo_get_last_move(void)
+{
+    return _last_move;
+}
+
 uint16_t servo_get_degree(servo_status_t *status)
 {
     return status->currtent_degree;
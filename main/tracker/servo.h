@@ -6,6 +6,7 @@
 #include "soc/mcpwm_reg.h"
 #include "soc/mcpwm_struct.h"
 #include "util/ease.h"
+#include "util/time.h"
 
 #include "target/target.h"
 // #include "ui/ui.h"
@@ -35,4 +36,6 @@ uint16_t servo_get_course_to_degree(servo_t *servo);
 uint16_t servo_get_degree(servo_status_t *status);
 uint32_t servo_get_pulsewidth(servo_status_t *status);
 uint32_t servo_get_easing_sleep(servo_status_t *status);
-uint8_t servo_get_per_pulsewidth(servo_status_t *status);
\ No newline at end of file
+uint8_t servo_get_per_pulsewidth(servo_status_t *status);
+// When either servo's output last changed, 0 if never
+time_millis_t servo_get_last_move(void);
\ No newline at end of file
@@ -13,9 +13,14 @@
 static const char *TAG = "Tarcker";
 static servo_t servo;
 static atp_t atp;
+static arbiter_t arbiter;
+static mavlink_tracker_t mavlink_tracker;
 static location_estimate_t estimate[MAX_ESTIMATE_COUNT];
 static uint8_t estimate_index;
 
+// Go back to protocol detection if an autodetected input stays silent this long
+#define TRACKER_AUTODETECT_SILENCE_MS 10000
+
 static int PROTOCOL_BAUDRATE[] = { PROTOCOL_BAUDRATE_1200, PROTOCOL_BAUDRATE_2400, PROTOCOL_BAUDRATE_4800, PROTOCOL_BAUDRATE_9600, PROTOCOL_BAUDRATE_19200, PROTOCOL_BAUDRATE_38400, PROTOCOL_BAUDRATE_57600,PROTOCOL_BAUDRATE_115200 };
 // static Observer telemetry_vals_observer;
 
@@ -72,6 +77,36 @@ static void tracker_flag_changed(void *t, uint8_t f, uint8_t v)
     if (f == TRACKER_FLAG_HOMESETED) tracker->home->seted = tracker->internal.flag & TRACKER_FLAG_HOMESETED;
 }
 
+static void tracker_rtt_update(tracker_rtt_t *rtt)
+{
+    uint32_t sent = __atomic_exchange_n(&rtt->sent, 0, __ATOMIC_SEQ_CST);
+    if (sent == 0)
+    {
+        return;
+    }
+
+    // Unsigned difference, so the 32 bit microseconds can wrap
+    uint32_t us = (uint32_t)time_micros_now() - sent;
+    rtt->last_us = us;
+    if (rtt->samples == 0)
+    {
+        rtt->min_us = rtt->max_us = rtt->avg_us = us;
+    }
+    else
+    {
+        rtt->min_us = MIN(rtt->min_us, us);
+        rtt->max_us = MAX(rtt->max_us, us);
+        rtt->avg_us = (rtt->avg_us * 7 + us) / 8;
+    }
+    rtt->samples++;
+
+    if (rtt->samples % TRACKER_RTT_LOG_INTERVAL == 0)
+    {
+        LOG_I(TAG, "RTT: last %ums, avg %ums, min %ums, max %ums, lost %u/%u", rtt->last_us / 1000, rtt->avg_us / 1000,
+              rtt->min_us / 1000, rtt->max_us / 1000, rtt->lost, rtt->samples + rtt->lost);
+    }
+}
+
 static void tracker_telemetry_changed(void *t, uint8_t tag)
 {
     tracker_t *tracker = (tracker_t *)t;
@@ -84,6 +119,7 @@ static void tracker_telemetry_changed(void *t, uint8_t tag)
             tracker->internal.flag_changed(tracker, TRACKER_FLAG_SERVER_CONNECTED, 1);
         }
         tracker->last_ack = time_millis_now();
+        tracker_rtt_update(&tracker->rtt);
         break;
     case TAG_PLANE_LONGITUDE:
         if (!(tracker->internal.flag & TRACKER_FLAG_PLANESETED))
@@ -110,6 +146,12 @@ static void tracker_telemetry_changed(void *t, uint8_t tag)
     }
 }
 
+static bool tracker_plane_fix(void *t, uint8_t source, const position_fix_t *fix)
+{
+    tracker_t *tracker = (tracker_t *)t;
+    return arbiter_update_fix(tracker->arbiter, source, fix);
+}
+
 static void tracker_settings_handler(const setting_t *setting, void *user_data)
 {
     tracker_t *t = (tracker_t *)user_data;
@@ -290,55 +332,64 @@ static void tracker_settings_handler(const setting_t *setting, void *user_data)
     }
 }
 
+static bool tracker_send_atp_cmd(tracker_t *t, uint8_t cmd)
+{
+    t->atp->enc_frame->atp_cmd = cmd;
+    uint8_t *buff = atp_frame_encode(t->atp->enc_frame);
+    if (t->atp->enc_frame->buffer_index > 0)
+    {
+        if (cmd == CMD_HEARTBEAT)
+        {
+            // Never 0, that means no heartbeat is waiting
+            uint32_t sent = (uint32_t)time_micros_now() | 1;
+            if (__atomic_exchange_n(&t->rtt.sent, sent, __ATOMIC_SEQ_CST) != 0 && (t->internal.flag & TRACKER_FLAG_SERVER_CONNECTED))
+            {
+                t->rtt.lost++;
+            }
+        }
+        t->atp->atp_send(buff, t->atp->enc_frame->buffer_index);
+        return true;
+    }
+    return false;
+}
+
 static bool tracker_check_atp_cmd(tracker_t *t)
 {
     if (!(t->internal.flag & TRACKER_FLAG_WIFI_CONNECTED))
         return false;
 
     time_millis_t now = time_millis_now();
+    bool sent = false;
 
+    // Everything sent here goes out in a single datagram on flush
     if (!(t->internal.flag & TRACKER_FLAG_SERVER_CONNECTED))
     {
-        if (now > t->last_heartbeat + 1000)
+        if (now > t->last_heartbeat + 1000 && tracker_send_atp_cmd(t, CMD_HEARTBEAT))
         {
-            //printf("!TRACKER_FLAG_SERVER_CONNECTED\n");
-            t->atp->enc_frame->atp_cmd = CMD_HEARTBEAT;
-            uint8_t *buff = atp_frame_encode(t->atp->enc_frame);
-            if (t->atp->enc_frame->buffer_index > 0)
-            {
-                t->atp->atp_send(buff, t->atp->enc_frame->buffer_index);
-                t->last_heartbeat = now;
-                return true;
-            }
+            t->last_heartbeat = now;
+            sent = true;
         }
     }
     else
     {
-        if (now > t->last_heartbeat + 5000)
+        if (now > t->last_heartbeat + 5000 && tracker_send_atp_cmd(t, CMD_HEARTBEAT))
         {
-            //printf("TRTACKER_FLAG_SERVER_CONNECTED\n");
-            t->atp->enc_frame->atp_cmd = CMD_HEARTBEAT;
-            uint8_t *buff = atp_frame_encode(t->atp->enc_frame);
-            if (t->atp->enc_frame->buffer_index > 0)
-            {
-                t->atp->atp_send(buff, t->atp->enc_frame->buffer_index);
-                t->last_heartbeat = now;
-                return true;
-            }
+            t->last_heartbeat = now;
+            sent = true;
         }
-        else if (t->atp->atp_cmd->cmds[0] > 0)
+
+        for (int ii = 0; ii < ARRAY_COUNT(t->atp->atp_cmd->cmds) && t->atp->atp_cmd->cmds[0] > 0; ii++)
         {
-            t->atp->enc_frame->atp_cmd = atp_popup_cmd();;
-            uint8_t *buff = atp_frame_encode(t->atp->enc_frame);
-            if (t->atp->enc_frame->buffer_index > 0)
-            {
-                t->atp->atp_send(buff, t->atp->enc_frame->buffer_index);
-                return true;
-            }
+            sent |= tracker_send_atp_cmd(t, atp_popup_cmd());
         }
     }
 
-    return false;
+    if (sent && t->atp->atp_flush)
+    {
+        t->atp->atp_flush();
+    }
+
+    return sent;
 }
 
 static bool tracker_check_atp_ctr(tracker_t *t)
@@ -386,6 +437,10 @@ static void tracker_reconfigure_input(tracker_t *t, uart_t *uart)
         input_mavlink_config_t mavlink;
         input_ltm_config_t ltm;
         input_nmea_config_t nmea;
+        input_smartport_config_t smartport;
+        input_ubx_config_t ubx;
+        input_autodetect_config_t autodetect;
+        input_bridge_config_t bridge;
     } input_config;
 
     if (uart->input != NULL)
@@ -432,11 +487,55 @@ static void tracker_reconfigure_input(tracker_t *t, uart_t *uart)
         break;
     case PROTOCOL_PELCO_D:
         break;
+    case PROTOCOL_SMARTPORT:
+        LOG_I(TAG, "Set [UART%d] to [SMARTPORT] for input.", uart->com);
+        input_smartport_init(&uart->inputs.smartport);
+        uart->input = (input_t *)&uart->inputs.smartport;
+        input_config.smartport.tx = uart->gpio_tx;
+        input_config.smartport.rx = uart->gpio_rx;
+        // SmartPort always runs at 57600
+        input_config.smartport.baudrate = SMARTPORT_BAUDRATE;
+        uart->input_config = &input_config.smartport;
+        break;
+    case PROTOCOL_UBX:
+        LOG_I(TAG, "Set [UART%d] to [UBX] for input.", uart->com);
+        input_ubx_init(&uart->inputs.ubx);
+        uart->input = (input_t *)&uart->inputs.ubx;
+        input_config.ubx.tx = uart->gpio_tx;
+        input_config.ubx.rx = uart->gpio_rx;
+        input_config.ubx.baudrate = uart->baudrate;
+        uart->input_config = &input_config.ubx;
+        break;
+    case PROTOCOL_AUTO:
+        LOG_I(TAG, "Set [UART%d] to [AUTO] for input.", uart->com);
+        input_autodetect_init(&uart->inputs.autodetect);
+        uart->input = (input_t *)&uart->inputs.autodetect;
+        input_config.autodetect.tx = uart->gpio_tx;
+        input_config.autodetect.rx = uart->gpio_rx;
+        input_config.autodetect.baudrate = uart->baudrate;
+        input_config.autodetect.com = uart->com;
+        uart->input_config = &input_config.autodetect;
+        break;
+    case PROTOCOL_BRIDGE:
+#if defined(USE_WIFI)
+        LOG_I(TAG, "Set [UART%d] to [BRIDGE] for input.", uart->com);
+        input_bridge_init(&uart->inputs.bridge);
+        uart->input = (input_t *)&uart->inputs.bridge;
+        input_config.bridge.tx = uart->gpio_tx;
+        input_config.bridge.rx = uart->gpio_rx;
+        input_config.bridge.baudrate = uart->baudrate;
+        input_config.bridge.com = uart->com;
+        uart->input_config = &input_config.bridge;
+#endif
+        break;
     }
 
+    uart->last_frame_recv = time_micros_now();
+
     if (uart->input != NULL)
     {
         uart->input->home_source = uart->com == settings_get_key_u8(SETTING_KEY_HOME_SOURCE);
+        uart->input->source = PROTOCOL_IO_UART1 + uart->com - 1;
         input_open(&t->atp, uart->input, uart->input_config);
     }
 }
@@ -479,6 +578,14 @@ static void tracker_reconfigure_output(tracker_t *t, uart_t *uart)
         output_config.pelco_d.baudrate = uart->baudrate;
         uart->output_config = &output_config.pelco_d;
         break;
+    case PROTOCOL_SMARTPORT:
+        break;
+    case PROTOCOL_UBX:
+        break;
+    case PROTOCOL_AUTO:
+        break;
+    case PROTOCOL_BRIDGE:
+        break;
     }
 
     if (uart->output != NULL)
@@ -487,6 +594,48 @@ static void tracker_reconfigure_output(tracker_t *t, uart_t *uart)
     }
 }
 
+static void tracker_uart_autodetect_init(uart_t *uart)
+{
+    uart->autodetect = uart->protocol == PROTOCOL_AUTO;
+
+    if (uart->autodetect)
+    {
+        // Start straight with whatever was detected last time, detection
+        // kicks in again if it turns out to be silent.
+        protocol_e protocol;
+        int baudrate;
+        if (input_autodetect_load(uart->com, &protocol, &baudrate))
+        {
+            LOG_I(TAG, "[UART%d] last detected protocol %d at %d", uart->com, protocol, baudrate);
+            uart->protocol = protocol;
+            uart->baudrate = baudrate;
+        }
+    }
+}
+
+static void tracker_uart_autodetect(uart_t *uart, time_micros_t now)
+{
+    if (uart->protocol == PROTOCOL_AUTO)
+    {
+        protocol_e protocol;
+        int baudrate;
+        if (input_autodetect_get_result(&uart->inputs.autodetect, &protocol, &baudrate))
+        {
+            uart->protocol = protocol;
+            uart->baudrate = baudrate;
+            uart->invalidate_input = true;
+        }
+        return;
+    }
+
+    if (now - uart->last_frame_recv > MILLIS_TO_MICROS(TRACKER_AUTODETECT_SILENCE_MS))
+    {
+        LOG_I(TAG, "No data on [UART%d], restart protocol detection", uart->com);
+        uart->protocol = PROTOCOL_AUTO;
+        uart->invalidate_input = true;
+    }
+}
+
 void tracker_init(tracker_t *t)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
@@ -523,11 +672,14 @@ void tracker_init(tracker_t *t)
     t->internal.status_changed(t, TRACKER_STATUS_BOOTING);
     t->last_heartbeat = time_millis_now();
     t->last_ack = time_millis_now();
+    memset(&t->rtt, 0, sizeof(t->rtt));
 
     t->servo = &servo;
     t->atp = &atp;
     t->atp->tracker = t;
     t->atp->tag_value_changed = t->internal.telemetry_changed;
+    t->atp->plane_fix = tracker_plane_fix;
+    t->arbiter = &arbiter;
 
     t->uart1.com = 1;
     t->uart1.input_config = NULL;
@@ -542,6 +694,7 @@ void tracker_init(tracker_t *t)
     t->uart1.baudrate = PROTOCOL_BAUDRATE[settings_get_key_u8(SETTING_KEY_PORT_UART1_BAUDRATE)];
     t->uart1.protocol = settings_get_key_u8(SETTING_KEY_PORT_UART1_PROTOCOL);
     t->uart1.io_type = settings_get_key_u8(SETTING_KEY_PORT_UART1_TYPE);
+    tracker_uart_autodetect_init(&t->uart1);
 
     t->uart2.com = 2;
     t->uart2.input_config = NULL;
@@ -556,6 +709,7 @@ void tracker_init(tracker_t *t)
     t->uart2.baudrate = PROTOCOL_BAUDRATE[settings_get_key_u8(SETTING_KEY_PORT_UART2_BAUDRATE)];
     t->uart2.protocol = settings_get_key_u8(SETTING_KEY_PORT_UART2_PROTOCOL);
     t->uart2.io_type = settings_get_key_u8(SETTING_KEY_PORT_UART2_TYPE);
+    tracker_uart_autodetect_init(&t->uart2);
 
     memset(&estimate, 0, sizeof(location_estimate_t) * MAX_ESTIMATE_COUNT);
     estimate_index = 0;
@@ -564,6 +718,8 @@ void tracker_init(tracker_t *t)
 
     servo_init(&servo);
     atp_init(&atp);
+    arbiter_init(&arbiter, &atp);
+    mavlink_tracker_init(&mavlink_tracker, t);
 }
 
 void tracker_uart_update(tracker_t *t, uart_t *uart)
@@ -583,7 +739,15 @@ void tracker_uart_update(tracker_t *t, uart_t *uart)
     if (LIKELY(uart->input != NULL))
     {
         time_micros_t now = time_micros_now();
-        uart->input->vtable.update(uart->input, t->atp, now);
+        if (uart->input->vtable.update(uart->input, t->atp, now))
+        {
+            uart->last_frame_recv = now;
+        }
+
+        if (UNLIKELY(uart->autodetect))
+        {
+            tracker_uart_autodetect(uart, now);
+        }
     }
 
     if (LIKELY(uart->output != NULL))
@@ -612,6 +776,11 @@ void tracker_task(void *arg)
     {
         now = time_millis_now();
 
+        // Fail over to another position source if the selected one went stale
+        arbiter_update(t->arbiter, time_micros_now());
+
+        mavlink_tracker_update(&mavlink_tracker, time_micros_now());
+
         //pan
         if (now > servo.internal.pan.next_tick)
         {
@@ -6,10 +6,16 @@
 #include "input/input_mavlink.h"
 #include "input/input_ltm.h"
 #include "input/input_nmea.h"
+#include "input/input_smartport.h"
+#include "input/input_ubx.h"
+#include "input/input_autodetect.h"
+#include "input/input_bridge.h"
 #include "output/output_pelco_d.h"
 #include "telemetry.h"
 #include "servo.h"
 #include "observer.h"
+#include "arbiter.h"
+#include "mavlink_tracker.h"
 #include "protocols/protocol.h"
 #include "sensors/imu.h"
 // #include "protocols/atp.h"
@@ -76,11 +82,19 @@ typedef struct uart_s
     int baudrate;
     protocol_e protocol;
     protocol_io_type_e io_type;
+    bool autodetect;
+    time_micros_t last_frame_recv;
 
+    // Per port storage for every input and output, so reconfiguring a
+    // port never touches the heap.
     union {
         input_mavlink_t mavlink;
         input_ltm_t ltm;
         input_nmea_t nmea;
+        input_smartport_t smartport;
+        input_ubx_t ubx;
+        input_autodetect_t autodetect;
+        input_bridge_t bridge;
     } inputs;
 
     union {
@@ -103,10 +117,29 @@ typedef struct location_estimate_s
     time_millis_t location_time;
 } location_estimate_t;
 
+// Heartbeat to ACK round trip over ATP
+#define TRACKER_RTT_LOG_INTERVAL 10
+
+typedef struct tracker_rtt_s
+{
+    // Low 32 bits of when the heartbeat waiting for an ACK was sent, 0 if none.
+    // Written by the tracker task and taken by the WiFi receive task, so it's
+    // only accessed atomically, which a 64 bit value can't be on the ESP32.
+    uint32_t sent;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t samples;
+    // Heartbeats that got no ACK before the next one
+    uint32_t lost;
+} tracker_rtt_t;
+
 typedef struct tracker_s
 {
     time_millis_t last_heartbeat;
     time_millis_t last_ack;
+    tracker_rtt_t rtt;
 
     struct
     {
@@ -135,6 +168,7 @@ typedef struct tracker_s
     
     servo_t *servo;
     atp_t *atp;
+    arbiter_t *arbiter;
     imu_t *imu;
 } tracker_t;
 
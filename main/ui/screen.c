@@ -784,7 +784,22 @@ static void screen_draw_main(screen_t *s)
     if (s->internal.tracker->internal.flag & TRACKER_FLAG_WIFI_CONNECTED)
     {
         u8g2_DrawXBM(&u8g2, icon_index, 0, SMALL_WIFI_WIDTH, SMALL_WIFI_HEIGHT, SMALL_WIFI_ICON);
-        icon_index += SMALL_WIFI_WIDTH + 4;
+        icon_index += SMALL_WIFI_WIDTH + 1;
+#ifdef USE_WIFI
+        // Clients connected to us in AP mode, signal strength as station
+        u8g2_SetFont(&u8g2, u8g2_font_profont10_tf);
+        if (s->internal.wifi->ap_mode)
+        {
+            snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%d", s->internal.wifi->stations);
+        }
+        else
+        {
+            snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%d", s->internal.wifi->rssi);
+        }
+        u8g2_DrawStr(&u8g2, icon_index, 0, buf);
+        icon_index += u8g2_GetStrWidth(&u8g2, buf);
+#endif
+        icon_index += 3;
     }
 
     if (s->internal.tracker->internal.flag & TRACKER_FLAG_HOMESETED)
@@ -953,11 +968,22 @@ static void screen_draw_wait_connect(screen_t *s)
     u8g2_SetFontPosBottom(&u8g2);
     u8g2_SetFont(&u8g2, u8g2_font_profont10_tf);
 
-    snprintf(buf, SCREEN_DRAW_BUF_SIZE, "SSID:%s", (char *)&s->internal.wifi->config->sta.ssid);
-    u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT / 2 + 5, buf);
+    if (s->internal.wifi->ap_mode)
+    {
+        snprintf(buf, SCREEN_DRAW_BUF_SIZE, "AP:%s", (char *)&s->internal.wifi->config->ap.ssid);
+        u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT / 2 + 5, buf);
+
+        snprintf(buf, SCREEN_DRAW_BUF_SIZE, "PWD:%s", (char *)&s->internal.wifi->config->ap.password);
+        u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT, buf);
+    }
+    else
+    {
+        snprintf(buf, SCREEN_DRAW_BUF_SIZE, "SSID:%s", (char *)&s->internal.wifi->config->sta.ssid);
+        u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT / 2 + 5, buf);
 
-    snprintf(buf, SCREEN_DRAW_BUF_SIZE, "PWD:%s", (char *)&s->internal.wifi->config->sta.password);
-    u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT, buf);
+        snprintf(buf, SCREEN_DRAW_BUF_SIZE, "PWD:%s", (char *)&s->internal.wifi->config->sta.password);
+        u8g2_DrawStr(&u8g2, WIFI_WIDTH + 6, WIFI_HEIGHT, buf);
+    }
 
     //draw connecting
     if (TIME_CYCLE_EVERY_MS(600, 2) == 0)
@@ -1105,6 +1131,14 @@ static void screen_draw_debug_info(screen_t *s)
     screen_draw_label_value(s, "W.Status:", buf, SCREEN_W(s), y, 3);
     y += 8;
 
+#ifdef USE_WIFI
+    // Heartbeat round trip, shows what the power save setting costs
+    tracker_rtt_t *rtt = &s->internal.tracker->rtt;
+    snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%u/%ums PS:%d", rtt->avg_us / 1000, rtt->max_us / 1000, settings_get_key_u8(SETTING_KEY_WIFI_POWER_SAVE));
+    screen_draw_label_value(s, "W.RTT:", buf, SCREEN_W(s), y, 3);
+    y += 8;
+#endif
+
     snprintf(buf, SCREEN_DRAW_BUF_SIZE, VERSION);
     screen_draw_label_value(s, "Version:", buf, SCREEN_W(s), y, 3);
     y += 8;
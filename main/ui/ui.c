@@ -508,6 +508,24 @@ static void ui_settings_handler(const setting_t *setting, void *user_data)
         return;
     }
 
+    if (SETTING_IS(setting, SETTING_KEY_WIFI_POWER_SAVE))
+    {
+        if (ui->internal.wifi->enable)
+        {
+            wifi_update_power_save(ui->internal.wifi);
+        }
+        return;
+    }
+
+    if (SETTING_IS(setting, SETTING_KEY_WIFI_MODE) || SETTING_IS(setting, SETTING_KEY_WIFI_AP_CHANNEL) || SETTING_IS(setting, SETTING_KEY_WIFI_STATIC_IP))
+    {
+        if (ui->internal.wifi->enable)
+        {
+            wifi_restart(ui->internal.wifi);
+        }
+        return;
+    }
+
     if (SETTING_IS(setting, SETTING_KEY_WIFI_SMART_CONFIG))
     {
         if (ui->internal.wifi->enable)
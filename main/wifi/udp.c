@@ -4,25 +4,42 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 
+#include "protocols/atp.h"
+#include "protocols/mavlink_router.h"
+#include "util/macros.h"
 #include "udp.h"
 
 static const char *TAG = "Udp";
 
 static udp_t udp;
+// Sessions are updated by the receive task and read by the tracker task
+static SemaphoreHandle_t _mutex;
 // static int socket_obj = 0;
 
 static struct sockaddr_in server_addr;
 static struct sockaddr_in remote_addr;
 static unsigned int socklen;
+// Where MAVLink goes, broadcast until a GCS talks to us
+static struct sockaddr_in mavlink_addr;
+static struct sockaddr_in imu_log_addr;
+static udp_bridge_t bridges[UDP_BRIDGE_COUNT];
+static udp_tx_t tx;
 
 void wifi_udp_init() 
 {
 	udp.socket_obj_client = 0;
 	udp.socket_obj_server = 0;
+	udp.socket_obj_mavlink = 0;
+	udp.socket_obj_imu_log = 0;
 	udp.server_port = UDP_PORT;
 	udp.server_ip = 0;
-	udp.remote_ip = 0;
+	memset(udp.sessions, 0, sizeof(udp.sessions));
+	udp.controller = UDP_SESSION_NONE;
+	memset(&tx, 0, sizeof(tx));
+
+	_mutex = xSemaphoreCreateMutex();
 }
 
 static int get_socket_error_code(int socket) 
@@ -124,6 +141,18 @@ void wifi_udp_close()
     {
         close(udp.socket_obj_client);
     }
+
+	if (udp.socket_obj_mavlink != 0)
+    {
+        close(udp.socket_obj_mavlink);
+        udp.socket_obj_mavlink = 0;
+    }
+
+	if (udp.socket_obj_imu_log != 0)
+    {
+        close(udp.socket_obj_imu_log);
+        udp.socket_obj_imu_log = 0;
+    }
 }
 
 void wifi_udp_set_server_ip(uint32_t *ip)
@@ -133,16 +162,171 @@ void wifi_udp_set_server_ip(uint32_t *ip)
 	server_addr.sin_port = htons(UDP_PORT);
 }
 
+static void wifi_udp_session_expire(time_micros_t now)
+{
+	for (int ii = 0; ii < UDP_SESSION_MAX; ii++)
+	{
+		udp_session_t *session = &udp.sessions[ii];
+		if (session->active && now - session->last_seen > MILLIS_TO_MICROS(UDP_SESSION_TIMEOUT_MS))
+		{
+			struct in_addr addr = { .s_addr = session->ip };
+			LOG_I(TAG, "Client %s timed out", inet_ntoa(addr));
+			session->active = false;
+			if (udp.controller == ii)
+			{
+				udp.controller = UDP_SESSION_NONE;
+			}
+		}
+	}
+}
+
+static int wifi_udp_session_seen(uint32_t ip, time_micros_t now)
+{
+	int oldest = UDP_SESSION_NONE;
+	int free = UDP_SESSION_NONE;
+
+	for (int ii = 0; ii < UDP_SESSION_MAX; ii++)
+	{
+		udp_session_t *session = &udp.sessions[ii];
+		if (!session->active)
+		{
+			if (free == UDP_SESSION_NONE)
+			{
+				free = ii;
+			}
+			continue;
+		}
+		if (session->ip == ip)
+		{
+			session->last_seen = now;
+			return ii;
+		}
+		if (ii != udp.controller && (oldest == UDP_SESSION_NONE || session->last_seen < udp.sessions[oldest].last_seen))
+		{
+			oldest = ii;
+		}
+	}
+
+	// Table full, make room by dropping the quietest viewer
+	int idx = free != UDP_SESSION_NONE ? free : oldest;
+	if (idx == UDP_SESSION_NONE)
+	{
+		return UDP_SESSION_NONE;
+	}
+
+	udp.sessions[idx] = (udp_session_t){
+		.active = true,
+		.ip = ip,
+		.subscriptions = UDP_SESSION_SUBSCRIBE_TELEMETRY,
+		.connected = now,
+		.last_seen = now,
+	};
+
+	struct in_addr addr = { .s_addr = ip };
+	LOG_I(TAG, "Client %s connected", inet_ntoa(addr));
+
+	return idx;
+}
+
+static bool wifi_udp_is_control_frame(const char *buffer, int length)
+{
+	if (length < 3 || buffer[0] != TP_PACKET_LEAD || buffer[1] != TP_PACKET_START)
+	{
+		return false;
+	}
+
+	switch ((uint8_t)buffer[2])
+	{
+	case CMD_SET_AIRPLANE:
+	case CMD_SET_TRACKER:
+	case CMD_SET_PARAM:
+	case CMD_SET_HOME:
+	case CMD_CONTROL:
+		return true;
+	}
+	return false;
+}
+
 int wifi_udp_send(char *buffer, int length) 
-{	int result = sendto(udp.socket_obj_client, buffer, length, 0,
-			(struct sockaddr *) &server_addr, sizeof(server_addr));
-	// LOG_I(TAG, "Send Data: %d", result);
+{
+	int result = -1;
+	int sent = 0;
+
+	xSemaphoreTake(_mutex, portMAX_DELAY);
+
+	wifi_udp_session_expire(time_micros_now());
+
+	for (int ii = 0; ii < UDP_SESSION_MAX; ii++)
+	{
+		udp_session_t *session = &udp.sessions[ii];
+		if (session->active && (session->subscriptions & UDP_SESSION_SUBSCRIBE_TELEMETRY))
+		{
+			struct sockaddr_in addr = server_addr;
+			addr.sin_addr.s_addr = session->ip;
+			result = sendto(udp.socket_obj_client, buffer, length, 0, (struct sockaddr *) &addr, sizeof(addr));
+			sent++;
+		}
+	}
 
-	LOG_D(TAG, "Send to : %s:%u -> %d", inet_ntoa(server_addr.sin_addr), ntohs(server_addr.sin_port), length);
+	xSemaphoreGive(_mutex);
+
+	if (sent == 0)
+	{
+		// Nobody connected yet, broadcast so apps can find us
+		result = sendto(udp.socket_obj_client, buffer, length, 0, (struct sockaddr *) &server_addr, sizeof(server_addr));
+	}
+
+	LOG_D(TAG, "Send %d bytes to %d clients", length, sent);
 
 	return result;
 }
 
+void wifi_udp_flush(void)
+{
+	if (tx.length == 0)
+	{
+		return;
+	}
+
+	uint8_t *buffer = tx.buffers[tx.current];
+	int length = tx.length;
+
+	tx.datagrams++;
+	tx.frames_sent += tx.frames;
+	tx.current ^= 1;
+	tx.length = 0;
+	tx.frames = 0;
+
+	wifi_udp_send((char *)buffer, length);
+
+	if (tx.datagrams % UDP_TX_STATS_INTERVAL == 0)
+	{
+		LOG_I(TAG, "TX: %u datagrams, %u frames, %u.%02u frames/datagram", tx.datagrams, tx.frames_sent,
+			tx.frames_sent / tx.datagrams, (tx.frames_sent * 100 / tx.datagrams) % 100);
+	}
+}
+
+void wifi_udp_queue(const void *buffer, int length)
+{
+	if (tx.length + length > UDP_TX_BUFFER_SIZE)
+	{
+		wifi_udp_flush();
+	}
+
+	if (length > UDP_TX_BUFFER_SIZE)
+	{
+		// Too big to coalesce anyway
+		wifi_udp_send((char *)buffer, length);
+		tx.datagrams++;
+		tx.frames_sent++;
+		return;
+	}
+
+	memcpy(&tx.buffers[tx.current][tx.length], buffer, length);
+	tx.length += length;
+	tx.frames++;
+}
+
 int wifi_udp_receive(char *buffer, int length) 
 {
 	int len = 0;
@@ -152,22 +336,262 @@ int wifi_udp_receive(char *buffer, int length)
 	// start recive
 	len = recvfrom(udp.socket_obj_server, buffer, length, 0, (struct sockaddr *) &remote_addr, &socklen);
 	
-	// print recived data
-	if (len > 0) 
+	if (len <= 0) 
 	{
-		if (udp.remote_ip == 0 || udp.remote_ip != remote_addr.sin_addr.s_addr || remote_addr.sin_addr.s_addr != server_addr.sin_addr.s_addr)
+		return len;
+	}
+
+	time_micros_t now = time_micros_now();
+	bool control = wifi_udp_is_control_frame(buffer, len);
+
+	xSemaphoreTake(_mutex, portMAX_DELAY);
+
+	wifi_udp_session_expire(now);
+	int idx = wifi_udp_session_seen(remote_addr.sin_addr.s_addr, now);
+
+	if (control && idx != UDP_SESSION_NONE)
+	{
+		udp.sessions[idx].subscriptions |= UDP_SESSION_SUBSCRIBE_CONTROL;
+		if (udp.controller == UDP_SESSION_NONE)
 		{
-			udp.remote_ip = remote_addr.sin_addr.s_addr;
-			server_addr.sin_addr.s_addr = remote_addr.sin_addr.s_addr;
-			LOG_I(TAG, "Remote ip: %d.%d.%d.%d", (uint8_t)(udp.remote_ip), (uint8_t)(udp.remote_ip >> 8), (uint8_t)(udp.remote_ip >> 16), (uint8_t)(udp.remote_ip >> 24));
+			udp.controller = idx;
+			LOG_I(TAG, "Controller: %s", inet_ntoa(remote_addr.sin_addr));
 		}
-
-		LOG_D(TAG, "Receive Data: %d", len);
 	}
 
-	// if (len <= 0 && LOG_LOCAL_LEVEL >= ESP_LOG_DEBUG) {
-	// 	show_socket_error_reason(udp.socket_obj_server);
-	// }
+	bool accepted = !control || (idx != UDP_SESSION_NONE && idx == udp.controller);
+
+	xSemaphoreGive(_mutex);
+
+	LOG_D(TAG, "Receive Data: %d", len);
+
+	if (!accepted)
+	{
+		LOG_D(TAG, "Dropping control frame from %s, not the controller", inet_ntoa(remote_addr.sin_addr));
+		return 0;
+	}
 
     return len;
-}
\ No newline at end of file
+}
+
+int wifi_udp_wait(uint32_t timeout_ms)
+{
+	fd_set fds;
+	int max_fd = 0;
+
+	FD_ZERO(&fds);
+	if (udp.socket_obj_server > 0)
+	{
+		FD_SET(udp.socket_obj_server, &fds);
+		max_fd = udp.socket_obj_server;
+	}
+	if (udp.socket_obj_mavlink > 0)
+	{
+		FD_SET(udp.socket_obj_mavlink, &fds);
+		max_fd = MAX(max_fd, udp.socket_obj_mavlink);
+	}
+
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = (timeout_ms % 1000) * 1000,
+	};
+
+	if (select(max_fd + 1, &fds, NULL, NULL, &tv) <= 0)
+	{
+		return 0;
+	}
+
+	int readable = 0;
+	if (udp.socket_obj_server > 0 && FD_ISSET(udp.socket_obj_server, &fds))
+	{
+		readable |= UDP_READABLE_SERVER;
+	}
+	if (udp.socket_obj_mavlink > 0 && FD_ISSET(udp.socket_obj_mavlink, &fds))
+	{
+		readable |= UDP_READABLE_MAVLINK;
+	}
+	return readable;
+}
+
+//create the MAVLink socket, used for both directions. return ESP_OK:success ESP_FAIL:error
+esp_err_t wifi_create_udp_mavlink(uint32_t ip)
+{
+    if (udp.socket_obj_mavlink != 0)
+    {
+        close(udp.socket_obj_mavlink);
+    }
+
+	LOG_I(TAG, "Create MAVLink Udp port : %d", MAVLINK_ROUTER_UDP_LOCAL_PORT);
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock < 0) {
+		show_socket_error_reason(sock);
+		return ESP_FAIL;
+	}
+
+	struct sockaddr_in local_addr;
+	local_addr.sin_family = AF_INET;
+	local_addr.sin_port = htons(MAVLINK_ROUTER_UDP_LOCAL_PORT);
+	local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	setnonblocking(sock);
+
+	if (bind(sock, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) {
+		show_socket_error_reason(sock);
+		close(sock);
+		return ESP_FAIL;
+	}
+
+	mavlink_addr.sin_family = AF_INET;
+	mavlink_addr.sin_port = htons(MAVLINK_ROUTER_UDP_REMOTE_PORT);
+	mavlink_addr.sin_addr.s_addr = ip;
+
+	udp.socket_obj_mavlink = sock;
+
+	return ESP_OK;
+}
+
+int wifi_udp_mavlink_send(void *data, const void *buf, size_t size)
+{
+	if (udp.socket_obj_mavlink == 0)
+	{
+		return -1;
+	}
+
+	return sendto(udp.socket_obj_mavlink, buf, size, 0, (struct sockaddr *) &mavlink_addr, sizeof(mavlink_addr));
+}
+
+int wifi_udp_mavlink_receive(char *buffer, int length)
+{
+	struct sockaddr_in addr;
+	unsigned int addr_len = sizeof(addr);
+
+	int len = recvfrom(udp.socket_obj_mavlink, buffer, length, 0, (struct sockaddr *) &addr, &addr_len);
+
+	if (len > 0 && (addr.sin_addr.s_addr != mavlink_addr.sin_addr.s_addr || addr.sin_port != mavlink_addr.sin_port))
+	{
+		// Reply to whoever talked to us last
+		mavlink_addr = addr;
+		LOG_I(TAG, "MAVLink remote: %s:%u", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+	}
+
+	return len;
+}
+
+//create the IMU log socket, send only. return ESP_OK:success ESP_FAIL:error
+esp_err_t wifi_create_udp_imu_log(uint32_t ip)
+{
+    if (udp.socket_obj_imu_log != 0)
+    {
+        close(udp.socket_obj_imu_log);
+        udp.socket_obj_imu_log = 0;
+    }
+
+	LOG_I(TAG, "Create IMU log Udp port : %d", UDP_IMU_LOG_PORT);
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock < 0) {
+		show_socket_error_reason(sock);
+		return ESP_FAIL;
+	}
+
+	// Dropping records is better than stalling the IMU task
+	setnonblocking(sock);
+
+	imu_log_addr.sin_family = AF_INET;
+	imu_log_addr.sin_port = htons(UDP_IMU_LOG_PORT);
+	imu_log_addr.sin_addr.s_addr = ip;
+
+	udp.socket_obj_imu_log = sock;
+
+	return ESP_OK;
+}
+
+int wifi_udp_imu_log_send(void *data, const void *buf, size_t size)
+{
+	if (udp.socket_obj_imu_log == 0)
+	{
+		return -1;
+	}
+
+	return sendto(udp.socket_obj_imu_log, buf, size, 0, (struct sockaddr *) &imu_log_addr, sizeof(imu_log_addr));
+}
+
+static int wifi_udp_bridge_read(void *data, void *buf, size_t size, time_ticks_t timeout)
+{
+	udp_bridge_t *bridge = data;
+	struct sockaddr_in addr;
+	unsigned int addr_len = sizeof(addr);
+
+	int len = recvfrom(bridge->socket, buf, size, 0, (struct sockaddr *) &addr, &addr_len);
+
+	if (len > 0 && (addr.sin_addr.s_addr != bridge->remote_addr.sin_addr.s_addr || addr.sin_port != bridge->remote_addr.sin_port))
+	{
+		bridge->remote_addr = addr;
+		LOG_I(TAG, "Bridge remote: %s:%u", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+	}
+
+	return len;
+}
+
+static int wifi_udp_bridge_write(void *data, const void *buf, size_t size)
+{
+	udp_bridge_t *bridge = data;
+
+	return sendto(bridge->socket, buf, size, 0, (struct sockaddr *) &bridge->remote_addr, sizeof(bridge->remote_addr));
+}
+
+bool wifi_udp_bridge_open(uint8_t com, io_t *io)
+{
+	udp_bridge_t *bridge = &bridges[com - 1];
+	int port = UDP_BRIDGE_PORT + com - 1;
+
+	wifi_udp_bridge_close(com);
+
+	LOG_I(TAG, "Create bridge Udp port : %d", port);
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock < 0) {
+		show_socket_error_reason(sock);
+		return false;
+	}
+
+	int broadcast = 1;
+	setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+
+	struct sockaddr_in local_addr;
+	local_addr.sin_family = AF_INET;
+	local_addr.sin_port = htons(port);
+	local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	setnonblocking(sock);
+
+	if (bind(sock, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) {
+		show_socket_error_reason(sock);
+		close(sock);
+		return false;
+	}
+
+	bridge->socket = sock;
+	bridge->remote_addr.sin_family = AF_INET;
+	bridge->remote_addr.sin_port = htons(port);
+	bridge->remote_addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+	*io = IO_MAKE(wifi_udp_bridge_read, wifi_udp_bridge_write, NULL, bridge);
+
+	return true;
+}
+
+void wifi_udp_bridge_close(uint8_t com)
+{
+	udp_bridge_t *bridge = &bridges[com - 1];
+
+	if (bridge->socket != 0)
+	{
+		close(bridge->socket);
+		bridge->socket = 0;
+	}
+}
@@ -2,8 +2,56 @@
 
 #include <esp_err.h>
 #include <sys/socket.h>
+
+#include "io/io.h"
+#include "util/time.h"
+
 #define UDP_PORT 8898
+// Transparent UART bridges, UART1 on UDP_BRIDGE_PORT and UART2 on the next one
+#define UDP_BRIDGE_PORT 8899
+#define UDP_BRIDGE_COUNT 2
+// Raw IMU capture broadcast, see sensors/imu_log_format.h
+#define UDP_IMU_LOG_PORT 8897
+
+// ATP clients (apps) talking to us at the same time
+#define UDP_SESSION_MAX 4
+// A client is forgotten after this long without sending anything
+#define UDP_SESSION_TIMEOUT_MS 15000
+#define UDP_SESSION_NONE -1
+
+// ATP frames queued in one tracker tick are sent together in one datagram
+#define UDP_TX_BUFFER_SIZE 512
+// Log the coalescing stats every this many datagrams
+#define UDP_TX_STATS_INTERVAL 100
 
+typedef struct udp_tx_s
+{
+    // Filled while the other one is being sent
+    uint8_t buffers[2][UDP_TX_BUFFER_SIZE];
+    uint8_t current;
+    uint16_t length;
+    uint8_t frames;
+
+    uint32_t datagrams;
+    uint32_t frames_sent;
+} udp_tx_t;
+
+typedef enum
+{
+    // Gets heartbeats, telemetry and replies
+    UDP_SESSION_SUBSCRIBE_TELEMETRY = 1 << 0,
+    // Has sent set/control commands, so it wants to be the controller
+    UDP_SESSION_SUBSCRIBE_CONTROL = 1 << 1,
+} udp_session_subscription_e;
+
+typedef struct udp_session_s
+{
+    bool active;
+    uint32_t ip;
+    uint8_t subscriptions;
+    time_micros_t connected;
+    time_micros_t last_seen;
+} udp_session_t;
 
 typedef struct udp_s
 {
@@ -11,13 +59,47 @@ typedef struct udp_s
     uint32_t server_ip;
     int socket_obj_client;
     int socket_obj_server;
-    uint32_t remote_ip;
+    int socket_obj_mavlink;
+    int socket_obj_imu_log;
+
+    udp_session_t sessions[UDP_SESSION_MAX];
+    // Only this session may change the tracker's state
+    int8_t controller;
 } udp_t;
 
+typedef enum
+{
+    UDP_READABLE_SERVER = 1 << 0,
+    UDP_READABLE_MAVLINK = 1 << 1,
+} udp_readable_e;
+
+typedef struct udp_bridge_s
+{
+    int socket;
+    // Broadcast until someone sends us something
+    struct sockaddr_in remote_addr;
+} udp_bridge_t;
+
 void wifi_udp_init();
 esp_err_t wifi_create_udp_server();
 esp_err_t wifi_create_udp_client();
 void wifi_udp_close();
 void wifi_udp_set_server_ip(uint32_t *ip);
 int wifi_udp_send(char *buffer, int length);
-int wifi_udp_receive(char *buffer, int length);
\ No newline at end of file
+int wifi_udp_receive(char *buffer, int length);
+// Appends a frame to the current datagram, sending it first if the frame doesn't fit
+void wifi_udp_queue(const void *buffer, int length);
+// Sends whatever was queued, call once per tick
+void wifi_udp_flush(void);
+// Blocks until the server or MAVLink socket has data or the timeout expires.
+// Returns the udp_readable_e flags of the readable sockets, 0 on timeout.
+int wifi_udp_wait(uint32_t timeout_ms);
+esp_err_t wifi_create_udp_mavlink(uint32_t ip);
+int wifi_udp_mavlink_send(void *data, const void *buf, size_t size);
+int wifi_udp_mavlink_receive(char *buffer, int length);
+// Send only, broadcasts to UDP_IMU_LOG_PORT
+esp_err_t wifi_create_udp_imu_log(uint32_t ip);
+int wifi_udp_imu_log_send(void *data, const void *buf, size_t size);
+// Opens the bridge socket for the given UART (1 based), returning an io_t for it
+bool wifi_udp_bridge_open(uint8_t com, io_t *io);
+void wifi_udp_bridge_close(uint8_t com);
@@ -20,6 +20,11 @@
 #include "udp.h"
 #include "config/settings.h"
 #include "tracker/observer.h"
+#include "protocols/mavlink_router.h"
+#include "util/macros.h"
+#if defined(USE_IMU)
+#include "sensors/imu_log.h"
+#endif
 
 
 static const char *TAG = "Wifi";
@@ -30,9 +35,59 @@ static volatile char buffer_received[BUFFER_LENGHT];
 
 static const char *ip;
 
+// Last AP we were associated with, reconnecting to it directly skips the scan
+static struct
+{
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t attempts;
+} last_ap;
+
 static void wifi_send(void *buffer, int len)
 {
-    wifi_udp_send(buffer, len);
+    wifi_udp_queue(buffer, len);
+}
+
+static void wifi_flush(void)
+{
+    wifi_udp_flush();
+}
+
+static void wifi_update_link(wifi_t *wifi)
+{
+    int8_t rssi = DEFAULT_RSSI;
+    uint8_t stations = 0;
+
+    if (wifi->ap_mode)
+    {
+        wifi_sta_list_t list;
+        if (esp_wifi_ap_get_sta_list(&list) == ESP_OK)
+        {
+            stations = list.num;
+            for (int ii = 0; ii < list.num; ii++)
+            {
+                rssi = MAX(rssi, list.sta[ii].rssi);
+            }
+        }
+    }
+    else
+    {
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+        {
+            stations = 1;
+            rssi = ap.rssi;
+        }
+    }
+
+    if (stations != wifi->stations)
+    {
+        LOG_I(TAG, "Associated: %d, RSSI: %d", stations, rssi);
+    }
+
+    wifi->stations = stations;
+    wifi->rssi = rssi;
 }
 
 static void task_receive(void *arg)
@@ -50,32 +105,67 @@ static void task_receive(void *arg)
     LOG_I(TAG, "Broadcast Address: %s", ip4addr_ntoa(&broadcast_addr));
     wifi_udp_set_server_ip(&broadcast_addr.addr);
 
+    if (wifi_create_udp_mavlink(broadcast_addr.addr) == ESP_OK)
+    {
+        mavlink_router_set_link(MAVLINK_LINK_UDP, wifi_udp_mavlink_send, NULL);
+    }
+
+#if defined(USE_IMU)
+    if (wifi_create_udp_imu_log(broadcast_addr.addr) == ESP_OK)
+    {
+        imu_log_set_output(wifi_udp_imu_log_send, NULL);
+    }
+#endif
+
     char *buffer = (char *)&buffer_received;
-    buffer = (char*)malloc(BUFFER_LENGHT);
     int len = 0;
+    time_millis_t next_watchdog = 0;
     wifi->reciving = true;
 
     while (wifi->status == WIFI_STATUS_CONNECTED || wifi->status == WIFI_STATUS_UDP_CONNECTED)
-    {    
-        len = wifi_udp_receive(buffer, BUFFER_LENGHT);
-        if (len > 0)
+    {
+        time_millis_t now = time_millis_now();
+        if (now >= next_watchdog)
         {
-            LOG_D(TAG, "Recving data length -> %d", len);
-            wifi->callback(wifi->t, buffer, 0, len);
+            wifi_update_link(wifi);
+            next_watchdog = now + WIFI_WATCHDOG_INTERVAL_MS;
         }
-        else
+
+        // Sleep until something arrives, waking up now and then to notice disconnections
+        int readable = wifi_udp_wait(WIFI_RECEIVE_TIMEOUT_MS);
+
+        if (readable & UDP_READABLE_SERVER)
         {
-            vTaskDelay(MILLIS_TO_TICKS(10));
+            // 0 means the datagram was dropped, keep draining
+            while ((len = wifi_udp_receive(buffer, BUFFER_LENGHT)) >= 0)
+            {
+                if (len > 0)
+                {
+                    LOG_D(TAG, "Recving data length -> %d", len);
+                    wifi->callback(wifi->t, buffer, 0, len);
+                }
+            }
+        }
+
+        if (readable & UDP_READABLE_MAVLINK)
+        {
+            while ((len = wifi_udp_mavlink_receive(buffer, BUFFER_LENGHT)) > 0)
+            {
+                mavlink_router_receive(MAVLINK_LINK_UDP, (uint8_t *)buffer, len);
+            }
         }
     }
     
+    mavlink_router_set_link(MAVLINK_LINK_UDP, NULL, NULL);
+#if defined(USE_IMU)
+    imu_log_set_output(NULL, NULL);
+#endif
     wifi->reciving = false;
     LOG_I(TAG, "Stop receive task.");
 
     // ESP_ERROR_CHECK(esp_wifi_disconnect());
     // LOG_I(TAG, "Stop wifi connect.");
 
-    free(buffer);
     vTaskDelete(NULL);
 }
 
@@ -115,6 +205,158 @@ static void sc_callback(smartconfig_status_t status, void *pdata)
     }
 }
 
+static void wifi_start_ap(wifi_t *wifi)
+{
+    const char *ssid = setting_get_string(settings_get_key(SETTING_KEY_WIFI_SSID));
+    const char *password = setting_get_string(settings_get_key(SETTING_KEY_WIFI_PWD));
+
+    wifi_config_t wifi_config = {
+        .ap = {
+            .channel = settings_get_key_u8(SETTING_KEY_WIFI_AP_CHANNEL),
+            .max_connection = WIFI_AP_MAX_CONNECTIONS,
+            .authmode = WIFI_AUTH_WPA_WPA2_PSK,
+        },
+    };
+
+    if (strlen(ssid) == 0)
+    {
+        ssid = WIFI_AP_DEFAULT_SSID;
+    }
+
+    // WPA2 needs at least 8 characters
+    if (strlen(password) < 8)
+    {
+        password = "";
+        wifi_config.ap.authmode = WIFI_AUTH_OPEN;
+    }
+
+    strncpy((char *)&wifi_config.ap.ssid, ssid, sizeof(wifi_config.ap.ssid) - 1);
+    strncpy((char *)&wifi_config.ap.password, password, sizeof(wifi_config.ap.password) - 1);
+    wifi_config.ap.ssid_len = strlen((char *)&wifi_config.ap.ssid);
+
+    LOG_I(TAG, "Starting AP SSID:%s Channel:%d", wifi_config.ap.ssid, wifi_config.ap.channel);
+
+    memcpy(wifi->config, &wifi_config, sizeof(wifi_config_t));
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_AP, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+void wifi_update_power_save(wifi_t *wifi)
+{
+    static const wifi_ps_type_t ps_types[] = {
+        [WIFI_POWER_SAVE_NONE] = WIFI_PS_NONE,
+        [WIFI_POWER_SAVE_MIN] = WIFI_PS_MIN_MODEM,
+        [WIFI_POWER_SAVE_MAX] = WIFI_PS_MAX_MODEM,
+    };
+
+    uint8_t power_save = settings_get_key_u8(SETTING_KEY_WIFI_POWER_SAVE);
+
+    // Only stations sleep, an AP has to stay awake for its clients
+    esp_err_t err = esp_wifi_set_ps(ps_types[power_save]);
+    LOG_I(TAG, "Power save: %d (%s)", power_save, err == ESP_OK ? "ok" : "failed");
+}
+
+static void wifi_start_mode(wifi_t *wifi)
+{
+    wifi->ap_mode = settings_get_key_u8(SETTING_KEY_WIFI_MODE) == WIFI_MODE_SETTING_AP;
+    wifi->stations = 0;
+    wifi->rssi = DEFAULT_RSSI;
+
+    if (wifi->ap_mode)
+    {
+        wifi_start_ap(wifi);
+        return;
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_update_power_save(wifi);
+}
+
+static bool wifi_get_saved_addr(const char *key, ip4_addr_t *addr)
+{
+    const char *str = setting_get_string(settings_get_key(key));
+    return ip4addr_aton(str, addr) && addr->addr != 0;
+}
+
+static void wifi_set_static_ip(void)
+{
+    tcpip_adapter_ip_info_t ip_info;
+
+    // Reuse the lease DHCP gave us last time, if there's a complete one
+    if (!settings_get_key_bool(SETTING_KEY_WIFI_STATIC_IP) ||
+        !wifi_get_saved_addr(SETTING_KEY_WIFI_IP, &ip_info.ip) ||
+        !wifi_get_saved_addr(SETTING_KEY_WIFI_NETMASK, &ip_info.netmask) ||
+        !wifi_get_saved_addr(SETTING_KEY_WIFI_GATEWAY, &ip_info.gw))
+    {
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+        return;
+    }
+
+    LOG_I(TAG, "Static IP:%s", setting_get_string(settings_get_key(SETTING_KEY_WIFI_IP)));
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+    ESP_ERROR_CHECK(tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info));
+}
+
+// Only called for station leases, the AP address is always the default one
+static void wifi_save_ip_info(const tcpip_adapter_ip_info_t *ip_info)
+{
+    setting_set_string(settings_get_key(SETTING_KEY_WIFI_IP), ip4addr_ntoa(&ip_info->ip));
+    setting_set_string(settings_get_key(SETTING_KEY_WIFI_NETMASK), ip4addr_ntoa(&ip_info->netmask));
+    setting_set_string(settings_get_key(SETTING_KEY_WIFI_GATEWAY), ip4addr_ntoa(&ip_info->gw));
+}
+
+static void wifi_reconnect(void)
+{
+    wifi_config_t cfg;
+    ESP_ERROR_CHECK(esp_wifi_get_config(ESP_IF_WIFI_STA, &cfg));
+
+    if (last_ap.valid && last_ap.attempts < WIFI_FAST_RECONNECT_ATTEMPTS)
+    {
+        last_ap.attempts++;
+        cfg.sta.bssid_set = true;
+        memcpy(cfg.sta.bssid, last_ap.bssid, sizeof(cfg.sta.bssid));
+        cfg.sta.channel = last_ap.channel;
+    }
+    else
+    {
+        // Maybe the AP moved to another channel, scan for it
+        last_ap.valid = false;
+        cfg.sta.bssid_set = false;
+        cfg.sta.channel = 0;
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &cfg));
+
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        LOG_I(TAG, "Reconnect failed: %d", err);
+    }
+}
+
+static void wifi_start_receive(wifi_t *wifi, uint32_t ip_addr)
+{
+    wifi->ip = ip_addr;
+
+    wifi->status_change(wifi, WIFI_STATUS_CONNECTED);
+
+    // After a quick reconnect the previous task might not have noticed the drop
+    if (wifi->reciving)
+    {
+        ip4_addr_t broadcast_addr = {
+            .addr = (u32_t)(wifi->ip | 0xff000000)
+        };
+        wifi_udp_set_server_ip(&broadcast_addr.addr);
+        return;
+    }
+
+    LOG_I(TAG, "Create Wifi receive task at Core:%d", xPortGetCoreID());
+    xTaskCreatePinnedToCore(task_receive, "RECEIVE", 4096, wifi, 1, NULL, xPortGetCoreID());
+}
+
 static esp_err_t event_handler(void *ctx, system_event_t *event)
 {
     wifi_t *wifi = ctx;
@@ -148,7 +390,7 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
             strcpy((char *)&wifi_config.sta.ssid, ssid);
             strcpy((char *)&wifi_config.sta.password, password);
             
-            LOG_I(TAG, "Connecting to ap SSID:%s PWD:%s", wifi_config.sta.ssid, wifi_config.sta.password);
+            LOG_I(TAG, "Connecting to ap SSID:%s", wifi_config.sta.ssid);
 
             memcpy(wifi->config, &wifi_config, sizeof(wifi_config_t));
 
@@ -163,20 +405,38 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
             ESP_ERROR_CHECK(esp_smartconfig_start(sc_callback));
         }
         break;
+    case SYSTEM_EVENT_STA_CONNECTED:
+        LOG_I(TAG, "SYSTEM_EVENT_STA_CONNECTED Channel:%d", event->event_info.connected.channel);
+        memcpy(last_ap.bssid, event->event_info.connected.bssid, sizeof(last_ap.bssid));
+        last_ap.channel = event->event_info.connected.channel;
+        last_ap.attempts = 0;
+        last_ap.valid = true;
+        wifi_set_static_ip();
+        break;
     case SYSTEM_EVENT_STA_GOT_IP:
-        wifi->ip = event->event_info.got_ip.ip_info.ip.addr;
+    {
         wifi_config_t cfg;
         ESP_ERROR_CHECK(esp_wifi_get_config(ESP_IF_WIFI_STA, &cfg));
         memcpy(wifi->config, &cfg, sizeof(wifi_config_t));
 
-        const char *ip_str = ip4addr_ntoa(&event->event_info.got_ip.ip_info.ip);
-        // strcpy(ip, ip_str);
-        setting_set_string(settings_get_key(SETTING_KEY_WIFI_IP), ip_str);
-
-        LOG_I(TAG, "SSID:%s PWD:%s IP:%s", wifi->config->sta.ssid, wifi->config->sta.password, ip_str);
-        wifi->status_change(wifi, WIFI_STATUS_CONNECTED);
-        LOG_I(TAG, "Create Wifi receive task at Core:%d", xPortGetCoreID());
-        xTaskCreatePinnedToCore(task_receive, "RECEIVE", 4096, wifi, 1, NULL, xPortGetCoreID());
+        LOG_I(TAG, "SSID:%s IP:%s", wifi->config->sta.ssid, ip4addr_ntoa(&event->event_info.got_ip.ip_info.ip));
+        wifi_save_ip_info(&event->event_info.got_ip.ip_info);
+        wifi_start_receive(wifi, event->event_info.got_ip.ip_info.ip.addr);
+        break;
+    }
+    case SYSTEM_EVENT_AP_START:
+    {
+        LOG_I(TAG, "SYSTEM_EVENT_AP_START");
+        tcpip_adapter_ip_info_t ip_info;
+        ESP_ERROR_CHECK(tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_AP, &ip_info));
+        wifi_start_receive(wifi, ip_info.ip.addr);
+        break;
+    }
+    case SYSTEM_EVENT_AP_STACONNECTED:
+    case SYSTEM_EVENT_AP_STADISCONNECTED:
+        LOG_I(TAG, "Client %s, AID:%d", event->event_id == SYSTEM_EVENT_AP_STACONNECTED ? "connected" : "disconnected",
+              event->event_id == SYSTEM_EVENT_AP_STACONNECTED ? event->event_info.sta_connected.aid : event->event_info.sta_disconnected.aid);
+        wifi_update_link(wifi);
         break;
     case SYSTEM_EVENT_STA_DISCONNECTED:
         LOG_I(TAG, "SYSTEM_EVENT_STA_DISCONNECTED");
@@ -190,10 +450,8 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
         {
             if (wifi->enable)
             {
-                ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-	            ESP_ERROR_CHECK(esp_wifi_start());
-                ESP_ERROR_CHECK(esp_wifi_connect());
                 wifi->status_change(wifi, WIFI_STATUS_DISCONNECTED);
+                wifi_reconnect();
             }
             else
             {
@@ -202,11 +460,12 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
         }
         break;
     case SYSTEM_EVENT_STA_STOP:
-        LOG_I(TAG, "SYSTEM_EVENT_STA_STOP");
+    case SYSTEM_EVENT_AP_STOP:
+        LOG_I(TAG, "%s", event->event_id == SYSTEM_EVENT_STA_STOP ? "SYSTEM_EVENT_STA_STOP" : "SYSTEM_EVENT_AP_STOP");
         if (wifi->enable)
         {
-            ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-	        ESP_ERROR_CHECK(esp_wifi_start());
+            // Also how mode changes are applied, see wifi_restart()
+            wifi_start_mode(wifi);
         }
         else
         {
@@ -270,6 +529,7 @@ void wifi_init(wifi_t *wifi)
     wifi->config = (wifi_config_t*)malloc(sizeof(wifi_config_t));
     wifi->buffer_received = (char *)&buffer_received;
     wifi->send = wifi_send;
+    wifi->flush = wifi_flush;
     wifi->status_change_notifier = (notifier_t *)Notifier_Create(sizeof(notifier_t));
 
     const setting_t *wifi_enable_setting = settings_get_key(SETTING_KEY_WIFI_ENABLE);
@@ -288,8 +548,7 @@ void wifi_init(wifi_t *wifi)
 
 void wifi_start(wifi_t *wifi)
 {
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-	ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_start_mode(wifi);
 }
 
 void wifi_stop(wifi_t *wifi)
@@ -298,6 +557,13 @@ void wifi_stop(wifi_t *wifi)
     ESP_ERROR_CHECK(esp_wifi_stop());
 }
 
+void wifi_restart(wifi_t *wifi)
+{
+    // The STOP event starts it again
+    last_ap.valid = false;
+    ESP_ERROR_CHECK(esp_wifi_stop());
+}
+
 void wifi_smartconfig_stop(wifi_t *wifi)
 {
 	ESP_ERROR_CHECK(esp_smartconfig_stop());
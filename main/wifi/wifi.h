@@ -5,6 +5,15 @@
 #define DEFAULT_RSSI -127
 #define CHAR_DOT '.'
 #define BUFFER_LENGHT 512
+// How often the receive task checks the connection while no data arrives
+#define WIFI_RECEIVE_TIMEOUT_MS 500
+// How often the link state (association, RSSI) is refreshed
+#define WIFI_WATCHDOG_INTERVAL_MS 1000
+// Reconnect straight to the last AP/channel this many times before scanning again
+#define WIFI_FAST_RECONNECT_ATTEMPTS 5
+// Used in AP mode when no SSID is configured
+#define WIFI_AP_DEFAULT_SSID "iATS_Pro"
+#define WIFI_AP_MAX_CONNECTIONS 4
 
 typedef struct _Notifier notifier_t;
 
@@ -18,8 +27,26 @@ typedef enum
     WIFI_STATUS_UDP_CONNECTED = 5,
 } iats_wifi_status_e;
 
+typedef enum
+{
+    WIFI_MODE_SETTING_STATION = 0,
+    WIFI_MODE_SETTING_AP = 1,
+} wifi_mode_setting_e;
+
+// Indexed by SETTING_KEY_WIFI_POWER_SAVE
+typedef enum
+{
+    // Radio always on, lowest latency
+    WIFI_POWER_SAVE_NONE = 0,
+    // Wakes up every DTIM, the ESP-IDF default
+    WIFI_POWER_SAVE_MIN = 1,
+    // Wakes up every listen interval, adds the most latency
+    WIFI_POWER_SAVE_MAX = 2,
+} wifi_power_save_e;
+
 typedef void (*pTr_Analysis)(void *t, void *data, int offset, int len);
 typedef void (*pTr_Send)(void *buffer, int len);
+typedef void (*pTr_Flush)(void);
 typedef void (*pTr_wifi_status_change)(void *w, uint8_t s);
 
 typedef struct wifi_s
@@ -30,10 +57,17 @@ typedef struct wifi_s
     char *buffer_received;
     uint32_t ip;
 
+    bool ap_mode;
+    // Station: RSSI of the AP. AP: RSSI of the strongest client.
+    int8_t rssi;
+    // Clients associated with us in AP mode, 1 when connected as station
+    uint8_t stations;
+
     wifi_config_t *config;
     void *t;
     pTr_Analysis callback;
     pTr_Send send;
+    pTr_Flush flush;
     pTr_wifi_status_change status_change;
 
     notifier_t *status_change_notifier;
@@ -48,5 +82,9 @@ typedef struct wifi_s
 void wifi_init(wifi_t *wifi);
 void wifi_start(wifi_t *wifi);
 void wifi_stop(wifi_t *wifi);
+// Stops WiFi and lets it start again with the current mode settings
+void wifi_restart(wifi_t *wifi);
+// Applies SETTING_KEY_WIFI_POWER_SAVE, can be called while connected
+void wifi_update_power_save(wifi_t *wifi);
 void wifi_smartconfig_stop(wifi_t *wifi);
 // void task_wifi(void *arg);
\ No newline at end of file
@@ -0,0 +1,526 @@
+// Runs the UART to UDP bridge (main/input/input_bridge.c) on the host over
+// loopback UDP, with a simulated UART feeding it at the configured baud rate,
+// and measures its latency and throughput in both directions.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/host -I main -o bridge_loopback_bench
+//      tools/bridge_loopback_bench.c main/io/io.c main/input/input.c main/input/input_bridge.c
+//
+// then:
+//   ./bridge_loopback_bench [-b baudrate] [-t seconds] [-p poll_us]
+//
+// Without -b, 115200 and 921600 are both run. -p sleeps between bridge updates,
+// the IO task polls without sleeping. Downlink latency is from the stop bit of
+// a byte to the datagram carrying it being received.
+// Exits with 1 if any byte is lost, reordered or corrupted in either direction,
+// or if the average downlink latency exceeds the batch timeout by more than
+// LATENCY_MARGIN_US.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input/input_bridge.h"
+#include "io/serial.h"
+#include "util/macros.h"
+#include "wifi/udp.h"
+
+#define DEFAULT_SECONDS 3
+// Bench to bridge datagrams, like a GCS sending commands
+#define UPLINK_INTERVAL_US 20000
+#define UPLINK_SIZE 64
+// Time given to the last batch to arrive after the UART stops
+#define DRAIN_US 50000
+#define LATENCY_MARGIN_US 1000
+
+static const int _default_baudrates[] = {115200, 921600};
+
+static inline uint8_t pattern_byte(uint32_t index)
+{
+    return (uint8_t)(index ^ (index >> 8) ^ (index >> 16));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// simulated UART
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Bytes arrive one per 10 bits (8N1) from start, the driver's RX buffer
+// drops whatever doesn't fit, as the ESP32 one does
+struct serial_port_s
+{
+    bool open;
+    int baud_rate;
+    int rx_buffer_size;
+    bool running;
+    time_micros_t start;
+    uint32_t produced;
+    uint32_t read;
+    uint32_t overrun;
+
+    // Uplink, checked as it's written
+    uint32_t uplink_seq;
+    uint32_t uplink_bytes;
+    uint32_t uplink_datagrams;
+    uint32_t uplink_errors;
+    uint64_t uplink_latency_total_us;
+    uint32_t uplink_latency_max_us;
+};
+
+static serial_port_t _port;
+
+static time_micros_t uart_byte_time(const serial_port_t *port, uint32_t index)
+{
+    return port->start + (uint64_t)(index + 1) * 10 * 1000000 / port->baud_rate;
+}
+
+static void uart_advance(serial_port_t *port, time_micros_t now)
+{
+    if (!port->running || now < port->start)
+    {
+        return;
+    }
+    uint32_t produced = (now - port->start) * port->baud_rate / 10 / 1000000;
+    port->produced = produced;
+    if (port->produced - port->read > (uint32_t)port->rx_buffer_size)
+    {
+        uint32_t dropped = port->produced - port->read - port->rx_buffer_size;
+        port->overrun += dropped;
+        port->read += dropped;
+    }
+}
+
+serial_port_t *serial_port_open(const serial_port_config_t *config)
+{
+    memset(&_port, 0, sizeof(_port));
+    _port.open = true;
+    _port.baud_rate = config->baud_rate;
+    _port.rx_buffer_size = config->rx_buffer_size;
+    return &_port;
+}
+
+void serial_port_destroy(serial_port_t **port)
+{
+    if (*port)
+    {
+        (*port)->open = false;
+        *port = NULL;
+    }
+}
+
+int serial_port_read(serial_port_t *port, void *buf, size_t size, time_ticks_t timeout)
+{
+    uint8_t *p = buf;
+    uart_advance(port, time_micros_now());
+
+    uint32_t n = port->produced - port->read;
+    if (n > size)
+    {
+        n = size;
+    }
+    for (uint32_t ii = 0; ii < n; ii++)
+    {
+        p[ii] = pattern_byte(port->read + ii);
+    }
+    port->read += n;
+    return n;
+}
+
+// Each datagram is written in one call: sequence, send time, then the pattern
+int serial_port_write(serial_port_t *port, const void *buf, size_t size)
+{
+    const uint8_t *p = buf;
+    uint32_t seq;
+    time_micros_t sent;
+
+    if (size != UPLINK_SIZE)
+    {
+        port->uplink_errors++;
+        return size;
+    }
+    memcpy(&seq, p, sizeof(seq));
+    memcpy(&sent, p + sizeof(seq), sizeof(sent));
+    for (size_t ii = sizeof(seq) + sizeof(sent); ii < size; ii++)
+    {
+        if (p[ii] != pattern_byte(seq + ii))
+        {
+            port->uplink_errors++;
+            return size;
+        }
+    }
+    if (seq != port->uplink_seq)
+    {
+        port->uplink_errors++;
+    }
+    port->uplink_seq = seq + 1;
+
+    uint32_t latency = time_micros_now() - sent;
+    port->uplink_bytes += size;
+    port->uplink_datagrams++;
+    port->uplink_latency_total_us += latency;
+    if (latency > port->uplink_latency_max_us)
+    {
+        port->uplink_latency_max_us = latency;
+    }
+    return size;
+}
+
+io_flags_t serial_port_io_flags(serial_port_t *port)
+{
+    return 0;
+}
+
+char *gpio_toa(hal_gpio_t gpio)
+{
+    return "GPIO";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// bridge socket
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// As udp.c does it, but bound to an ephemeral loopback port so the bench can
+// run next to anything else. The remote follows the last sender like there.
+static udp_bridge_t _bridge;
+static uint16_t _bridge_port;
+
+static int bridge_read(void *data, void *buf, size_t size, time_ticks_t timeout)
+{
+    udp_bridge_t *bridge = data;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    int len = recvfrom(bridge->socket, buf, size, 0, (struct sockaddr *)&addr, &addr_len);
+    if (len > 0)
+    {
+        bridge->remote_addr = addr;
+    }
+    return len;
+}
+
+static int bridge_write(void *data, const void *buf, size_t size)
+{
+    udp_bridge_t *bridge = data;
+
+    if (bridge->remote_addr.sin_port == 0)
+    {
+        return -1;
+    }
+    return sendto(bridge->socket, buf, size, 0, (struct sockaddr *)&bridge->remote_addr, sizeof(bridge->remote_addr));
+}
+
+static int loopback_socket(uint16_t *port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(sock, (struct sockaddr *)&addr, &addr_len) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    // Room for a whole run of datagrams if the bench falls behind
+    int rcvbuf = 1 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    *port = ntohs(addr.sin_port);
+    return sock;
+}
+
+bool wifi_udp_bridge_open(uint8_t com, io_t *io)
+{
+    wifi_udp_bridge_close(com);
+
+    int sock = loopback_socket(&_bridge_port);
+    if (sock < 0)
+    {
+        perror("bridge socket");
+        return false;
+    }
+    _bridge.socket = sock;
+    memset(&_bridge.remote_addr, 0, sizeof(_bridge.remote_addr));
+
+    *io = IO_MAKE(bridge_read, bridge_write, NULL, &_bridge);
+    return true;
+}
+
+void wifi_udp_bridge_close(uint8_t com)
+{
+    if (_bridge.socket != 0)
+    {
+        close(_bridge.socket);
+        _bridge.socket = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// bench
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    int socket;
+    struct sockaddr_in bridge_addr;
+    uint32_t uplink_seq;
+    time_micros_t next_uplink;
+
+    uint32_t received;
+    uint32_t datagrams;
+    uint32_t errors;
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+} client_t;
+
+static void client_send_uplink(client_t *client, time_micros_t now)
+{
+    uint8_t buf[UPLINK_SIZE];
+    uint32_t seq = client->uplink_seq++;
+
+    memcpy(buf, &seq, sizeof(seq));
+    memcpy(buf + sizeof(seq), &now, sizeof(now));
+    for (size_t ii = sizeof(seq) + sizeof(now); ii < sizeof(buf); ii++)
+    {
+        buf[ii] = pattern_byte(seq + ii);
+    }
+    sendto(client->socket, buf, sizeof(buf), 0, (struct sockaddr *)&client->bridge_addr, sizeof(client->bridge_addr));
+}
+
+static void client_receive(client_t *client, const serial_port_t *port)
+{
+    uint8_t buf[INPUT_BRIDGE_BATCH_SIZE * 2];
+    int len;
+
+    while ((len = recv(client->socket, buf, sizeof(buf), 0)) > 0)
+    {
+        time_micros_t now = time_micros_now();
+
+        for (int ii = 0; ii < len; ii++)
+        {
+            if (buf[ii] != pattern_byte(client->received + ii))
+            {
+                client->errors++;
+                break;
+            }
+        }
+        // Every byte is counted, the first ones of a batch waited the longest
+        for (int ii = 0; ii < len; ii++)
+        {
+            uint32_t latency = now - uart_byte_time(port, client->received + ii);
+            client->latency_total_us += latency;
+            if (latency > client->latency_max_us)
+            {
+                client->latency_max_us = latency;
+            }
+        }
+        client->received += len;
+        client->datagrams++;
+    }
+}
+
+static void sleep_us(uint32_t us)
+{
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static bool run(int baudrate, int seconds, uint32_t poll_us)
+{
+    input_bridge_t bridge;
+    input_bridge_config_t config = {
+        .baudrate = baudrate,
+        .rx = 16,
+        .tx = 17,
+        .com = 1,
+    };
+    client_t client;
+    uint16_t client_port;
+    bool ok = true;
+
+    memset(&client, 0, sizeof(client));
+    client.socket = loopback_socket(&client_port);
+    if (client.socket < 0)
+    {
+        perror("client socket");
+        return false;
+    }
+
+    memset(&bridge, 0, sizeof(bridge));
+    input_bridge_init(&bridge);
+    input_open(NULL, &bridge.input, &config);
+    if (!bridge.udp_open)
+    {
+        close(client.socket);
+        return false;
+    }
+    client.bridge_addr.sin_family = AF_INET;
+    client.bridge_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    client.bridge_addr.sin_port = htons(_bridge_port);
+
+    // The bridge only learns where to send once something arrives, so the
+    // UART starts after the first uplink datagram got through
+    client_send_uplink(&client, time_micros_now());
+    time_micros_t deadline = time_micros_now() + SECS_TO_MICROS(1);
+    while (_port.uplink_datagrams == 0 && time_micros_now() < deadline)
+    {
+        input_update(&bridge.input, time_micros_now());
+    }
+    if (_port.uplink_datagrams == 0)
+    {
+        printf("  FAIL: the first uplink datagram never reached the UART\n");
+        input_close(&bridge.input, &config);
+        close(client.socket);
+        return false;
+    }
+
+    time_micros_t now = time_micros_now();
+    _port.start = now;
+    _port.running = true;
+    client.next_uplink = now + UPLINK_INTERVAL_US;
+    time_micros_t stop = now + SECS_TO_MICROS(seconds);
+
+    while ((now = time_micros_now()) < stop + DRAIN_US)
+    {
+        if (_port.running && now >= stop)
+        {
+            uart_advance(&_port, stop);
+            _port.running = false;
+        }
+        input_update(&bridge.input, now);
+        client_receive(&client, &_port);
+        if (_port.running && now >= client.next_uplink)
+        {
+            client_send_uplink(&client, now);
+            client.next_uplink += UPLINK_INTERVAL_US;
+        }
+        if (poll_us > 0)
+        {
+            sleep_us(poll_us);
+        }
+    }
+    client_receive(&client, &_port);
+
+    uint32_t offered = (uint64_t)baudrate / 10;
+    uint32_t avg_latency = client.received > 0 ? client.latency_total_us / client.received : 0;
+    uint32_t avg_uplink = _port.uplink_datagrams > 0 ? _port.uplink_latency_total_us / _port.uplink_datagrams : 0;
+
+    printf("%7d baud | down: %u B/s of %u offered, %u B in %u datagrams (%.0f B each), latency avg %uus max %uus"
+           " | up: %u datagrams, latency avg %uus max %uus\n",
+           baudrate,
+           (uint32_t)((uint64_t)client.received / seconds),
+           offered,
+           client.received,
+           client.datagrams,
+           client.datagrams > 0 ? (double)client.received / client.datagrams : 0.0,
+           avg_latency,
+           client.latency_max_us,
+           _port.uplink_datagrams,
+           avg_uplink,
+           _port.uplink_latency_max_us);
+
+    if (client.errors > 0 || _port.uplink_errors > 0)
+    {
+        printf("  FAIL: %u downlink and %u uplink datagrams corrupted or out of order\n", client.errors, _port.uplink_errors);
+        ok = false;
+    }
+    if (_port.overrun > 0)
+    {
+        printf("  FAIL: %u bytes overran the UART RX buffer\n", _port.overrun);
+        ok = false;
+    }
+    if (client.received != _port.produced)
+    {
+        printf("  FAIL: %u of %u bytes arrived\n", client.received, _port.produced);
+        ok = false;
+    }
+    if (_port.uplink_datagrams != client.uplink_seq)
+    {
+        printf("  FAIL: %u of %u uplink datagrams arrived\n", _port.uplink_datagrams, client.uplink_seq);
+        ok = false;
+    }
+    if (avg_latency > INPUT_BRIDGE_BATCH_TIMEOUT_US + LATENCY_MARGIN_US + poll_us)
+    {
+        printf("  FAIL: average latency over %uus\n", INPUT_BRIDGE_BATCH_TIMEOUT_US + LATENCY_MARGIN_US + poll_us);
+        ok = false;
+    }
+
+    input_close(&bridge.input, &config);
+    close(client.socket);
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-b baudrate] [-t seconds] [-p poll_us]\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int baudrate = 0;
+    int seconds = DEFAULT_SECONDS;
+    uint32_t poll_us = 0;
+    bool ok = true;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (strcmp(argv[ii], "-b") == 0 && ii + 1 < argc)
+        {
+            baudrate = atoi(argv[++ii]);
+        }
+        else if (strcmp(argv[ii], "-t") == 0 && ii + 1 < argc)
+        {
+            seconds = atoi(argv[++ii]);
+        }
+        else if (strcmp(argv[ii], "-p") == 0 && ii + 1 < argc)
+        {
+            poll_us = atoi(argv[++ii]);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if (seconds <= 0 || baudrate < 0)
+    {
+        usage(argv[0]);
+    }
+
+    if (baudrate > 0)
+    {
+        ok = run(baudrate, seconds, poll_us);
+    }
+    else
+    {
+        for (size_t ii = 0; ii < ARRAY_COUNT(_default_baudrates); ii++)
+        {
+            ok &= run(_default_baudrates[ii], seconds, poll_us);
+        }
+    }
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Round trips random GGA positions through gps_nmea_parser and times it.
+//
+// Build from the repository root, once for each coordinate format:
+//   cc -O2 -I components/gps_nmea_parser/include -o gps_parser_test
+//      tools/gps_parser_test.c components/gps_nmea_parser/gps/gps.c -lm
+//   cc -O2 -DGPS_CFG_FIXED_POINT=0 -I components/gps_nmea_parser/include -o gps_parser_test_float
+//      tools/gps_parser_test.c components/gps_nmea_parser/gps/gps.c -lm
+//
+// With GPS_CFG_FIXED_POINT every value has to come back exactly, with floats
+// within one unit of the last digit. Exits with 1 if any doesn't.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gps/gps.h"
+
+#define POSITIONS 200000
+#define SENTENCE_SIZE 128
+
+typedef struct
+{
+    int32_t latitude_e7;
+    int32_t longitude_e7;
+    int32_t altitude_cm;
+    char sentence[SENTENCE_SIZE];
+    size_t len;
+} position_t;
+
+static int32_t random_range(int32_t min, int32_t max)
+{
+    uint32_t r = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    return min + (int32_t)(r % (uint32_t)(max - min + 1));
+}
+
+// ddmm.mmmmmmm, enough minute decimals to hold 1e-7 degrees exactly. The last
+// one is always 0, so it doesn't matter that term_str drops it for longitudes.
+static int format_coordinate(char *buf, size_t size, int32_t value_e7, int deg_digits, char pos, char neg)
+{
+    uint32_t abs_e7 = value_e7 < 0 ? -(uint32_t)value_e7 : (uint32_t)value_e7;
+    uint32_t deg = abs_e7 / 10000000;
+    // In 1e-7 minutes
+    uint32_t min = (abs_e7 % 10000000) * 60;
+
+    return snprintf(buf, size, "%0*u%02u.%07u,%c", deg_digits, deg, min / 10000000, min % 10000000,
+                    value_e7 < 0 ? neg : pos);
+}
+
+static void format_gga(position_t *p)
+{
+    char lat[32], lon[32], body[SENTENCE_SIZE];
+    uint8_t crc = 0;
+    int32_t alt = p->altitude_cm;
+
+    format_coordinate(lat, sizeof(lat), p->latitude_e7, 2, 'N', 'S');
+    format_coordinate(lon, sizeof(lon), p->longitude_e7, 3, 'E', 'W');
+    snprintf(body, sizeof(body), "GPGGA,123519.00,%s,%s,1,08,0.9,%s%d.%02d,M,46.9,M,,",
+             lat, lon, alt < 0 ? "-" : "", abs(alt) / 100, abs(alt) % 100);
+
+    for (const char *c = body; *c; c++)
+    {
+        crc ^= *c;
+    }
+    p->len = snprintf(p->sentence, sizeof(p->sentence), "$%s*%02X\r\n", body, crc);
+}
+
+#if GPS_CFG_FIXED_POINT
+#define MAX_ERROR 0
+#define LATITUDE_E7(gps) ((gps)->latitude_e7)
+#define LONGITUDE_E7(gps) ((gps)->longitude_e7)
+#define ALTITUDE_CM(gps) ((gps)->altitude_cm)
+#else
+#define MAX_ERROR 1
+#define LATITUDE_E7(gps) ((int32_t)llround((gps)->latitude * 1e7))
+#define LONGITUDE_E7(gps) ((int32_t)llround((gps)->longitude * 1e7))
+#define ALTITUDE_CM(gps) ((int32_t)llround((gps)->altitude * 100))
+#endif
+
+static bool check(const char *what, int32_t got, int32_t expected, const position_t *p)
+{
+    if (labs((long)got - expected) > MAX_ERROR)
+    {
+        printf("FAIL: %s %d, expected %d from %s", what, got, expected, p->sentence);
+        return false;
+    }
+    return true;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static position_t positions[POSITIONS];
+    static gps_t gps;
+    bool ok = true;
+
+    srand(1);
+    for (int ii = 0; ii < POSITIONS; ii++)
+    {
+        position_t *p = &positions[ii];
+
+        p->latitude_e7 = random_range(-900000000, 900000000);
+        p->longitude_e7 = random_range(-1800000000, 1800000000);
+        p->altitude_cm = random_range(-50000, 1000000);
+        format_gga(p);
+    }
+
+    gps_init(&gps);
+    for (int ii = 0; ii < POSITIONS && ok; ii++)
+    {
+        const position_t *p = &positions[ii];
+
+        gps_process(&gps, p->sentence, p->len);
+        ok &= check("latitude", LATITUDE_E7(&gps), p->latitude_e7, p);
+        ok &= check("longitude", LONGITUDE_E7(&gps), p->longitude_e7, p);
+        ok &= check("altitude", ALTITUDE_CM(&gps), p->altitude_cm, p);
+    }
+
+    double start = now_ns();
+    for (int ii = 0; ii < POSITIONS; ii++)
+    {
+        gps_process(&gps, positions[ii].sentence, positions[ii].len);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("%s: %d GGA sentences, %.1f ns each\n", GPS_CFG_FIXED_POINT ? "fixed point" : "float",
+           POSITIONS, elapsed / POSITIONS);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
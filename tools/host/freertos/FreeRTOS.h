@@ -0,0 +1,13 @@
+// Host stand-in for the FreeRTOS types the firmware uses outside of tasks,
+// a tick is a millisecond here
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY UINT32_MAX
+#define pdFALSE 0
+#define pdTRUE 1
@@ -0,0 +1,4 @@
+// Host stand-in for freertos/event_groups.h, nothing outside the tasks uses it
+#pragma once
+
+#include "FreeRTOS.h"
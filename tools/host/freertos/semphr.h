@@ -0,0 +1,27 @@
+// Host stand-in for the FreeRTOS mutexes, backed by pthreads. Link with -pthread.
+#pragma once
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = malloc(sizeof(*mutex));
+    pthread_mutex_init(mutex, NULL);
+    return mutex;
+}
+
+// Only portMAX_DELAY is used with mutexes
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    return pthread_mutex_lock(mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    return pthread_mutex_unlock(mutex) == 0 ? pdTRUE : pdFALSE;
+}
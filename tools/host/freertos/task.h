@@ -0,0 +1,19 @@
+// Host stand-in for freertos/task.h, ticks come from the monotonic clock
+#pragma once
+
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+inline TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {.tv_sec = ticks / 1000, .tv_nsec = (ticks % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,9 @@
+// Host stand-in for the hal error codes
+#pragma once
+
+#include <assert.h>
+
+typedef int hal_err_t;
+
+#define HAL_ERR_NONE 0
+#define HAL_ERR_ASSERT_OK(e) assert((e) == HAL_ERR_NONE)
@@ -0,0 +1,6 @@
+// Host stand-in for the hal GPIO types
+#pragma once
+
+typedef int hal_gpio_t;
+
+#define HAL_GPIO_NONE -1
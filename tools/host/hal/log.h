@@ -0,0 +1,28 @@
+// Host stand-in for the hal log macros, prints to stdout
+#pragma once
+
+#include <stdio.h>
+
+#define LOG_D(tag, format, ...) ((void)0)
+#define LOG_I(tag, format, ...) printf("%s: " format "\n", tag, ##__VA_ARGS__)
+#define LOG_W(tag, format, ...) printf("%s: " format "\n", tag, ##__VA_ARGS__)
+#define LOG_E(tag, format, ...) fprintf(stderr, "%s: " format "\n", tag, ##__VA_ARGS__)
+#define LOG_V(tag, format, ...) ((void)0)
+
+#define LOG_BUFFER_D(tag, buf, size) ((void)0)
+#define LOG_BUFFER_I(tag, buf, size) ((void)0)
+#define LOG_BUFFER_W(tag, buf, size) ((void)0)
+#define LOG_BUFFER_E(tag, buf, size) ((void)0)
+#define LOG_BUFFER_V(tag, buf, size) ((void)0)
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define esp_log_level_set(tag, level) ((void)0)
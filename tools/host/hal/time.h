@@ -0,0 +1,12 @@
+// Host stand-in for the hal clock, microseconds from the monotonic clock
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+inline uint64_t hal_time_micros_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,20 @@
+// Host stand-in for main/io/hal_i2c.h. Tools stub the bus where a driver
+// sits on top of it, so the config is only passed around.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <hal/err.h>
+#include <hal/gpio.h>
+
+typedef int hal_i2c_bus_t;
+
+typedef struct hal_i2c_config_s
+{
+    hal_i2c_bus_t i2c_bus;
+    hal_gpio_t sda;
+    hal_gpio_t scl;
+    bool is_init;
+    uint32_t freq_hz;
+} hal_i2c_config_t;
@@ -0,0 +1,2 @@
+// Host stand-in for the generated sdkconfig.h, no options are needed
+#pragma once
@@ -0,0 +1,13 @@
+// Host stand-in for the lwIP socket header, which also brings in sockaddr_in,
+// select(), fcntl(), close(), the inet_ helpers and lwIP's u32_t
+#pragma once
+
+#include_next <sys/socket.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+typedef uint32_t u32_t;
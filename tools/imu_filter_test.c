@@ -0,0 +1,369 @@
+// Generates gyro, accel and mag samples from a known rotation, feeds them
+// through imu_update() at jittered times, with stalls and a rate change, and
+// checks the roll/pitch/yaw out of imu.c and madgwick follow the rotation.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/host -I main -I main/sensors -o imu_filter_test
+//      tools/imu_filter_test.c main/sensors/imu.c main/sensors/filter/madgwick.c
+//      main/sensors/filter/mahony.c -lm
+//
+// Also runs the samples without timestamps, so every update integrates the
+// nominal period as before imu_update_dt(), and prints how far that gets off.
+// Exits with 1 if any check fails.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "imu.h"
+#include "config/settings.h"
+#include "tracker/observer.h"
+#include "mag_calibration.h"
+#include "gyro_calibration.h"
+#include "accel_calibration.h"
+
+// Same as the MPU9250 at 8g and 1000dps with the AK8963
+#define ACCEL_LSB (1 / 4096.0)
+#define GYRO_LSB (1 / 32.8)
+#define MAG_LSB 0.15
+#define MAG_FIELD_UT 50.0
+#define MAG_INCLINATION 60.0
+#define MAG_DECLINATION 4.5f
+
+// Raw units, peak to peak
+#define ACCEL_NOISE 20.0
+#define GYRO_NOISE 4.0
+#define MAG_NOISE 4.0
+
+// Holds still to let the filter settle, then pans like a tracker while rocking
+#define STILL_SECS 10.0
+#define MOVING_SECS 20.0
+#define YAW_RATE 45.0
+// Up to this much of a period early or late, and a stall every STALL_EVERY_SECS
+#define JITTER 0.3
+#define STALL_SECS 0.06
+#define STALL_EVERY_SECS 2.0
+// One stall longer than IMU_MAX_DT while moving
+#define LONG_STALL_AT_SECS 12.0
+#define LONG_STALL_SECS 0.4
+
+// Errors allowed in degrees, at the end and anywhere after settling
+#define MAX_FINAL_ERROR 2.0
+#define MAX_ERROR 5.0
+// Time allowed to settle from the start and after the long stall
+#define SETTLE_SECS 5.0
+
+typedef struct
+{
+    double from;   // seconds
+    double rate;   // Hz
+} rate_step_t;
+
+// 200Hz like imu_task.c, dropping to 100Hz for a while
+static const rate_step_t _rates[] = {
+    {0, 200},
+    {15, 100},
+    {22, 200},
+};
+
+typedef struct
+{
+    double roll;
+    double pitch;
+    double yaw;
+} attitude_t;
+
+typedef struct
+{
+    float final[3];
+    float max[3];
+    uint32_t samples;
+} result_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// stubs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Stands for the settings and notifier code, imu.c only needs them to exist
+Notifier *Notifier_Create(size_t Size)
+{
+    static char notifier[256];
+    return (Notifier *)notifier;
+}
+
+const setting_t *settings_get_key(const char *key)
+{
+    return NULL;
+}
+
+bool settings_get_key_bool(const char *key)
+{
+    return true;
+}
+
+void setting_set_bool(const setting_t *setting, bool v)
+{
+}
+
+// Only imu_mode_normal is exercised
+void mag_calibration_init(void) {}
+void mag_calibration_update(int16_t mx, int16_t my, int16_t mz) {}
+bool mag_calibration_finish(int16_t offsets[3], int16_t soft_iron[3][3]) { return false; }
+void gyro_calibration_init(void) {}
+void gyro_calibration_update(int16_t gx, int16_t gy, int16_t gz) {}
+void gyro_calibration_finish(int16_t offsets[3]) {}
+void accel_calibration_init(void) {}
+void accel_calibration_update(int16_t ax, int16_t ay, int16_t az) {}
+void accel_calibration_finish(int16_t offsets[3], int16_t gains[3]) {}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// reference rotation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static double random_noise(double peak_to_peak)
+{
+    return (rand() / (double)RAND_MAX - 0.5) * peak_to_peak;
+}
+
+static double deg_to_rad(double deg)
+{
+    return deg * M_PI / 180;
+}
+
+static attitude_t reference_attitude(double t)
+{
+    attitude_t a = {.roll = 10, .pitch = -5, .yaw = 30};
+
+    if (t > STILL_SECS)
+    {
+        double m = t - STILL_SECS;
+        a.roll += 15 * sin(2 * M_PI * 0.2 * m);
+        a.pitch += 10 * sin(2 * M_PI * 0.15 * m);
+        a.yaw += YAW_RATE * m;
+    }
+    return a;
+}
+
+// Z-Y-X, the order madgwick_get_roll_pitch_yaw() takes them apart in
+static void attitude_to_quaternion(const attitude_t *a, double q[4])
+{
+    double cr = cos(deg_to_rad(a->roll) / 2), sr = sin(deg_to_rad(a->roll) / 2);
+    double cp = cos(deg_to_rad(a->pitch) / 2), sp = sin(deg_to_rad(a->pitch) / 2);
+    double cy = cos(deg_to_rad(a->yaw) / 2), sy = sin(deg_to_rad(a->yaw) / 2);
+
+    q[0] = cr * cp * cy + sr * sp * sy;
+    q[1] = sr * cp * cy - cr * sp * sy;
+    q[2] = cr * sp * cy + sr * cp * sy;
+    q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+// An earth frame vector seen from the sensor, i.e. rotated by q's conjugate
+static void earth_to_sensor(const double q[4], const double e[3], double s[3])
+{
+    double r[3][3] = {
+        {1 - 2 * (q[2] * q[2] + q[3] * q[3]), 2 * (q[1] * q[2] - q[0] * q[3]), 2 * (q[1] * q[3] + q[0] * q[2])},
+        {2 * (q[1] * q[2] + q[0] * q[3]), 1 - 2 * (q[1] * q[1] + q[3] * q[3]), 2 * (q[2] * q[3] - q[0] * q[1])},
+        {2 * (q[1] * q[3] - q[0] * q[2]), 2 * (q[2] * q[3] + q[0] * q[1]), 1 - 2 * (q[1] * q[1] + q[2] * q[2])},
+    };
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        s[ii] = r[0][ii] * e[0] + r[1][ii] * e[1] + r[2][ii] * e[2];
+    }
+}
+
+// Body rates in degrees per second, from 2 * conj(q) * dq/dt
+static void body_rates(double t, double rates[3])
+{
+    const double h = 1e-5;
+    double q[4], qa[4], qb[4], dq[4];
+    attitude_t a = reference_attitude(t);
+    attitude_t before = reference_attitude(t - h);
+    attitude_t after = reference_attitude(t + h);
+
+    attitude_to_quaternion(&a, q);
+    attitude_to_quaternion(&before, qa);
+    attitude_to_quaternion(&after, qb);
+    for (int ii = 0; ii < 4; ii++)
+    {
+        dq[ii] = (qb[ii] - qa[ii]) / (2 * h);
+    }
+
+    rates[0] = 2 * (q[0] * dq[1] - q[1] * dq[0] - q[2] * dq[3] + q[3] * dq[2]);
+    rates[1] = 2 * (q[0] * dq[2] + q[1] * dq[3] - q[2] * dq[0] - q[3] * dq[1]);
+    rates[2] = 2 * (q[0] * dq[3] - q[1] * dq[2] + q[2] * dq[1] - q[3] * dq[0]);
+    for (int ii = 0; ii < 3; ii++)
+    {
+        rates[ii] *= 180 / M_PI;
+    }
+}
+
+static int16_t to_raw(double value, double lsb, double noise)
+{
+    return lrint(value / lsb + random_noise(noise));
+}
+
+static void make_sample(double t, imu_sensor_data_t *raw)
+{
+    double q[4], accel[3], gyro[3], mag[3];
+    attitude_t a = reference_attitude(t);
+    const double up[3] = {0, 0, 1};
+    const double field[3] = {
+        MAG_FIELD_UT * cos(deg_to_rad(MAG_INCLINATION)),
+        0,
+        -MAG_FIELD_UT * sin(deg_to_rad(MAG_INCLINATION)),
+    };
+
+    attitude_to_quaternion(&a, q);
+    earth_to_sensor(q, up, accel);
+    earth_to_sensor(q, field, mag);
+    body_rates(t, gyro);
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        raw->accel[ii] = to_raw(accel[ii], ACCEL_LSB, ACCEL_NOISE);
+        raw->gyro[ii] = to_raw(gyro[ii], GYRO_LSB, GYRO_NOISE);
+        raw->mag[ii] = to_raw(mag[ii], MAG_LSB, MAG_NOISE);
+    }
+    raw->mag_updated = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// test
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static double sample_rate(double t)
+{
+    double rate = _rates[0].rate;
+
+    for (size_t ii = 0; ii < sizeof(_rates) / sizeof(_rates[0]); ii++)
+    {
+        if (t >= _rates[ii].from)
+        {
+            rate = _rates[ii].rate;
+        }
+    }
+    return rate;
+}
+
+static float angle_diff(float a, float b)
+{
+    float d = fmodf(a - b, 360.0f);
+    if (d > 180.0f)
+    {
+        d -= 360.0f;
+    }
+    if (d < -180.0f)
+    {
+        d += 360.0f;
+    }
+    return d;
+}
+
+static bool settled(double t)
+{
+    if (t < SETTLE_SECS)
+    {
+        return false;
+    }
+    return t < LONG_STALL_AT_SECS || t > LONG_STALL_AT_SECS + LONG_STALL_SECS + SETTLE_SECS;
+}
+
+static void run(bool timestamps, result_t *result)
+{
+    static imu_t imu;
+    double end = STILL_SECS + MOVING_SECS;
+    double next_stall = STALL_EVERY_SECS;
+    bool long_stall_done = false;
+    double t = 0;
+
+    imu_init(&imu);
+    imu.lsb.accel_lsb = ACCEL_LSB;
+    imu.lsb.gyro_lsb = GYRO_LSB;
+    imu.lsb.mag_lsb = MAG_LSB;
+    imu.cal.mag_declination = MAG_DECLINATION;
+
+    memset(result, 0, sizeof(*result));
+    srand(1);
+
+    while (t <= end)
+    {
+        attitude_t a = reference_attitude(t);
+        float expected[3] = {a.roll, a.pitch, fmodf(a.yaw + MAG_DECLINATION, 360.0f)};
+
+        make_sample(t, &imu.raw);
+        // Without timestamps imu_update_dt() falls back to the nominal period
+        imu.raw.time = timestamps ? (time_micros_t)(t * MICROS_PER_SEC) + 1 : 0;
+        imu_update(&imu);
+        result->samples++;
+
+        for (int ii = 0; ii < 3; ii++)
+        {
+            float error = fabsf(angle_diff(imu.data.orientation[ii], expected[ii]));
+            if (settled(t) && error > result->max[ii])
+            {
+                result->max[ii] = error;
+            }
+            result->final[ii] = error;
+        }
+
+        double period = 1 / sample_rate(t);
+        t += period * (1 + random_noise(2 * JITTER));
+        if (!long_stall_done && t >= LONG_STALL_AT_SECS)
+        {
+            t += LONG_STALL_SECS;
+            long_stall_done = true;
+        }
+        else if (t >= next_stall)
+        {
+            t += STALL_SECS;
+            next_stall += STALL_EVERY_SECS;
+        }
+    }
+}
+
+static void print_result(const char *name, const result_t *r)
+{
+    printf("%-10s | %u samples | final error roll %5.2f pitch %5.2f yaw %5.2f | max roll %5.2f pitch %5.2f yaw %5.2f\n",
+           name, r->samples,
+           r->final[0], r->final[1], r->final[2],
+           r->max[0], r->max[1], r->max[2]);
+}
+
+int main(void)
+{
+    result_t nominal, timed;
+    bool ok = true;
+
+    run(false, &nominal);
+    print_result("nominal dt", &nominal);
+
+    run(true, &timed);
+    print_result("sample dt", &timed);
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        if (timed.final[ii] > MAX_FINAL_ERROR)
+        {
+            printf("  FAIL: final error on axis %d over %.1f degrees\n", ii, MAX_FINAL_ERROR);
+            ok = false;
+        }
+        if (timed.max[ii] > MAX_ERROR)
+        {
+            printf("  FAIL: error on axis %d over %.1f degrees after settling\n", ii, MAX_ERROR);
+            ok = false;
+        }
+    }
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
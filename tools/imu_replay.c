@@ -0,0 +1,394 @@
+// Replays an IMU capture (see main/sensors/imu_log_format.h) through the
+// orientation filters on the host, to compare them and measure their cost.
+//
+// Build from the repository root:
+//   cc -O2 -I main/sensors -I main/sensors/filter -o imu_replay
+//      tools/imu_replay.c main/sensors/filter/madgwick.c main/sensors/filter/mahony.c -lm
+//
+// Capture with the IMU "Raw Log" setting in UDP mode, e.g.:
+//   socat -u UDP-RECV:8897 CREATE:capture.bin
+// then:
+//   ./imu_replay [-r heading] [-w warmup_s] capture.bin
+//
+// -r gives the true heading in degrees while the tracker was standing still,
+// the mean error against it is reported. Without it, only drift is.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_log_format.h"
+#include "madgwick.h"
+#include "mahony.h"
+
+// Same as imu.c
+#define NOMINAL_RATE_HZ 100
+#define MAX_DT 0.1f
+
+typedef struct
+{
+    float gyro[3];
+    float accel[3];
+    float mag[3];
+    float dt;
+    float time; // seconds since the first sample
+} sample_t;
+
+typedef struct
+{
+    sample_t *samples;
+    size_t count;
+    size_t capacity;
+    uint32_t blocks;
+    uint32_t lost;
+    float mag_declination;
+} capture_t;
+
+typedef struct
+{
+    const char *name;
+    void *state;
+    void (*init)(void *state, float sample_freq);
+    void (*update)(void *state, const sample_t *s);
+    void (*orientation)(void *state, float data[3], float md);
+} filter_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// loading
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Same as alignReading() in imu.c, indexed by imu_board_align_t
+static void align_reading(float *values, uint8_t align)
+{
+    const float x = values[0], y = values[1], z = values[2];
+
+    switch (align)
+    {
+    case 1: values[0] = y;  values[1] = -x; values[2] = z;  break;
+    case 2: values[0] = -x; values[1] = -y; values[2] = z;  break;
+    case 3: values[0] = -y; values[1] = x;  values[2] = z;  break;
+    case 4: values[0] = -x; values[1] = y;  values[2] = -z; break;
+    case 5: values[0] = y;  values[1] = x;  values[2] = -z; break;
+    case 6: values[0] = x;  values[1] = -y; values[2] = -z; break;
+    case 7: values[0] = -y; values[1] = -x; values[2] = -z; break;
+    case 8: values[0] = -y; values[1] = -x; values[2] = z;  break;
+    case 9: values[0] = x;  values[1] = y;  values[2] = -z; break;
+    default: break;
+    }
+}
+
+// Calibration, alignment and units as imu_update() does them
+static void convert_record(const imu_log_header_t *h, const imu_log_record_t *r, sample_t *s)
+{
+    for (int ii = 0; ii < 3; ii++)
+    {
+        // imu.c keeps the adjusted values as int16
+        int16_t accel = (r->accel[ii] - h->accel_off[ii]) * h->accel_scale[ii] / 4096;
+        int16_t gyro = r->gyro[ii] - h->gyro_off[ii];
+        int32_t mag = (h->mag_soft_iron[ii][0] * (r->mag[0] - h->mag_bias[0]) +
+                       h->mag_soft_iron[ii][1] * (r->mag[1] - h->mag_bias[1]) +
+                       h->mag_soft_iron[ii][2] * (r->mag[2] - h->mag_bias[2])) /
+                      4096;
+
+        s->accel[ii] = accel;
+        s->gyro[ii] = gyro;
+        s->mag[ii] = (int16_t)mag;
+    }
+
+    align_reading(s->accel, h->accel_align);
+    align_reading(s->gyro, h->gyro_align);
+    align_reading(s->mag, h->mag_align);
+
+    for (int ii = 0; ii < 3; ii++)
+    {
+        s->accel[ii] *= h->accel_lsb;
+        s->gyro[ii] *= h->gyro_lsb;
+        s->mag[ii] *= h->mag_lsb;
+    }
+}
+
+static bool capture_push(capture_t *c, const sample_t *s)
+{
+    if (c->count == c->capacity)
+    {
+        size_t capacity = c->capacity ? c->capacity * 2 : 4096;
+        sample_t *samples = realloc(c->samples, capacity * sizeof(*samples));
+        if (!samples)
+        {
+            return false;
+        }
+        c->samples = samples;
+        c->capacity = capacity;
+    }
+    c->samples[c->count++] = *s;
+    return true;
+}
+
+static bool capture_load(FILE *f, capture_t *c)
+{
+    imu_log_header_t h;
+    imu_log_record_t r;
+    bool first = true;
+    uint32_t next_seq = 0;
+    uint32_t last_time = 0;
+    double time = 0;
+
+    while (fread(&h, sizeof(h), 1, f) == 1)
+    {
+        if (h.magic != IMU_LOG_MAGIC || h.version != IMU_LOG_VERSION)
+        {
+            fprintf(stderr, "bad block header after %u blocks\n", c->blocks);
+            return false;
+        }
+
+        if (!first && h.seq != next_seq)
+        {
+            c->lost += h.seq - next_seq;
+        }
+        next_seq = h.seq + h.count;
+        c->mag_declination = h.mag_declination;
+        c->blocks++;
+
+        for (int ii = 0; ii < h.count; ii++)
+        {
+            if (fread(&r, sizeof(r), 1, f) != 1)
+            {
+                fprintf(stderr, "truncated block %u\n", c->blocks);
+                return c->count > 0;
+            }
+
+            sample_t s;
+            convert_record(&h, &r, &s);
+
+            // Unsigned difference, so the 32 bit microseconds can wrap
+            uint32_t delta = r.time - last_time;
+            if (first || delta == 0)
+            {
+                s.dt = 1.0f / NOMINAL_RATE_HZ;
+            }
+            else
+            {
+                s.dt = delta / 1e6f;
+                if (s.dt > MAX_DT)
+                {
+                    s.dt = MAX_DT;
+                }
+            }
+            last_time = r.time;
+            first = false;
+
+            time += s.dt;
+            s.time = time;
+
+            if (!capture_push(c, &s))
+            {
+                fprintf(stderr, "out of memory\n");
+                return false;
+            }
+        }
+    }
+    return c->count > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// filters
+//
+////////////////////////////////////////////////////////////////////////////////
+static madgwick_t _madgwick;
+static mahony_t _mahony;
+
+static void madgwick_filter_init(void *state, float sample_freq)
+{
+    madgwick_init(state, sample_freq);
+}
+
+static void madgwick_filter_update(void *state, const sample_t *s)
+{
+    madgwick_update(state,
+                    s->gyro[0], s->gyro[1], s->gyro[2],
+                    s->accel[0], s->accel[1], s->accel[2],
+                    s->mag[0], s->mag[1], s->mag[2], s->dt);
+}
+
+static void madgwick_filter_orientation(void *state, float data[3], float md)
+{
+    madgwick_get_roll_pitch_yaw(state, data, md);
+}
+
+static void mahony_filter_init(void *state, float sample_freq)
+{
+    mahony_init(state, sample_freq);
+}
+
+static void mahony_filter_update(void *state, const sample_t *s)
+{
+    mahony_update(state,
+                  s->gyro[0], s->gyro[1], s->gyro[2],
+                  s->accel[0], s->accel[1], s->accel[2],
+                  s->mag[0], s->mag[1], s->mag[2], s->dt);
+}
+
+static void mahony_filter_orientation(void *state, float data[3], float md)
+{
+    mahony_get_roll_pitch_yaw(state, data, md);
+}
+
+// Add alternative filters here
+static const filter_t _filters[] = {
+    {"madgwick", &_madgwick, madgwick_filter_init, madgwick_filter_update, madgwick_filter_orientation},
+    {"mahony", &_mahony, mahony_filter_init, mahony_filter_update, mahony_filter_orientation},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// replay
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Wrapped to [-180, 180)
+static float heading_diff(float a, float b)
+{
+    float d = fmodf(a - b + 540.0f, 360.0f) - 180.0f;
+    return d;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void replay(const filter_t *filter, const capture_t *c, float warmup, bool has_reference, float reference)
+{
+    float orientation[3];
+    float warm_yaw = 0;
+    float warm_time = 0;
+    bool warm = false;
+    // Unwrapped, so drift over several turns still adds up
+    double yaw_travel = 0;
+    float last_yaw = 0;
+    double error_sum = 0;
+    size_t error_count = 0;
+
+    filter->init(filter->state, NOMINAL_RATE_HZ);
+
+    double start = now_ns();
+    for (size_t ii = 0; ii < c->count; ii++)
+    {
+        const sample_t *s = &c->samples[ii];
+
+        filter->update(filter->state, s);
+        filter->orientation(filter->state, orientation, c->mag_declination);
+
+        if (s->time < warmup)
+        {
+            continue;
+        }
+
+        if (!warm)
+        {
+            warm = true;
+            warm_yaw = orientation[2];
+            warm_time = s->time;
+        }
+        else
+        {
+            yaw_travel += heading_diff(orientation[2], last_yaw);
+        }
+        last_yaw = orientation[2];
+
+        if (has_reference)
+        {
+            error_sum += fabsf(heading_diff(orientation[2], reference));
+            error_count++;
+        }
+    }
+    double elapsed = now_ns() - start;
+
+    printf("%-10s roll %7.2f pitch %7.2f yaw %7.2f", filter->name, orientation[0], orientation[1], orientation[2]);
+
+    float span = c->samples[c->count - 1].time - warm_time;
+    if (warm && span > 0)
+    {
+        printf(" | drift %7.3f deg/min (from %.1f)", yaw_travel / span * 60.0f, warm_yaw);
+    }
+    if (error_count > 0)
+    {
+        printf(" | heading error %6.2f deg", error_sum / error_count);
+    }
+    // Orientation extraction is included, the firmware does it every sample too
+    printf(" | %6.1f ns/update\n", elapsed / c->count);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-r heading] [-w warmup_s] [capture.bin]\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    float warmup = 10.0f;
+    float reference = 0;
+    bool has_reference = false;
+    const char *path = NULL;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (strcmp(argv[ii], "-r") == 0 && ii + 1 < argc)
+        {
+            reference = atof(argv[++ii]);
+            has_reference = true;
+        }
+        else if (strcmp(argv[ii], "-w") == 0 && ii + 1 < argc)
+        {
+            warmup = atof(argv[++ii]);
+        }
+        else if (argv[ii][0] == '-' && argv[ii][1] != '\0')
+        {
+            usage(argv[0]);
+        }
+        else
+        {
+            path = argv[ii];
+        }
+    }
+
+    FILE *f = (path && strcmp(path, "-") != 0) ? fopen(path, "rb") : stdin;
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    capture_t capture;
+    memset(&capture, 0, sizeof(capture));
+    if (!capture_load(f, &capture))
+    {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    if (f != stdin)
+    {
+        fclose(f);
+    }
+
+    printf("%zu samples in %u blocks, %.1fs, %u lost\n",
+           capture.count, capture.blocks, capture.samples[capture.count - 1].time, capture.lost);
+
+    for (size_t ii = 0; ii < sizeof(_filters) / sizeof(_filters[0]); ii++)
+    {
+        replay(&_filters[ii], &capture, warmup, has_reference, reference);
+    }
+
+    free(capture.samples);
+    return 0;
+}
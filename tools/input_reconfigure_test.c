@@ -0,0 +1,266 @@
+// Cycles the UART inputs through reconfigures, as tracker_reconfigure_input()
+// does, and checks that opening and closing them doesn't touch the heap.
+//
+// Build from the repository root (GNU ld, for --wrap):
+//   cc -O2 -I tools/host -I main -o input_reconfigure_test
+//      -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+//      tools/input_reconfigure_test.c main/io/io.c main/input/input.c
+//      main/input/input_ltm.c main/input/input_nmea.c main/input/input_smartport.c main/input/input_ubx.c
+//      main/protocols/ltm.c main/protocols/nmea.c main/protocols/smartport.c main/protocols/ubx.c
+//      components/gps_nmea_parser/gps/gps.c -lm
+//
+// MAVLink needs the c_library_v2 submodule and isn't part of the cycle.
+// Exits with 1 if any check fails.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input/input_ltm.h"
+#include "input/input_nmea.h"
+#include "input/input_smartport.h"
+#include "input/input_ubx.h"
+#include "io/serial.h"
+#include "protocols/atp.h"
+#include "tracker/telemetry.h"
+#include "util/macros.h"
+
+#define CYCLES 1000
+// Updates after each open, like the tracker's IO task would run
+#define UPDATES 10
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// heap accounting
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Only calls from the firmware objects are wrapped, libc's own aren't counted
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static uint32_t _allocs;
+static int32_t _live;
+
+void *__wrap_malloc(size_t size)
+{
+    _allocs++;
+    _live++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    _allocs++;
+    _live++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    _allocs++;
+    if (!ptr)
+    {
+        _live++;
+    }
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr)
+    {
+        _live--;
+    }
+    __real_free(ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// stubs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Stands for the UART driver, which keeps its ports in a static table too
+struct serial_port_s
+{
+    bool open;
+    int baud_rate;
+};
+
+static serial_port_t _port;
+static uint32_t _port_opens;
+
+serial_port_t *serial_port_open(const serial_port_config_t *config)
+{
+    if (_port.open)
+    {
+        printf("  FAIL: port opened twice\n");
+        exit(1);
+    }
+    _port.open = true;
+    _port.baud_rate = config->baud_rate;
+    _port_opens++;
+    return &_port;
+}
+
+void serial_port_destroy(serial_port_t **port)
+{
+    if (*port)
+    {
+        (*port)->open = false;
+        *port = NULL;
+    }
+}
+
+int serial_port_read(serial_port_t *port, void *buf, size_t size, time_ticks_t timeout)
+{
+    return 0;
+}
+
+int serial_port_write(serial_port_t *port, const void *buf, size_t size)
+{
+    return size;
+}
+
+bool serial_port_set_baudrate(serial_port_t *port, uint32_t baudrate)
+{
+    port->baud_rate = baudrate;
+    return true;
+}
+
+io_flags_t serial_port_io_flags(serial_port_t *port)
+{
+    return 0;
+}
+
+char *gpio_toa(hal_gpio_t gpio)
+{
+    return "GPIO";
+}
+
+// Nothing is received, telemetry is never written
+telemetry_t *atp_get_telemetry_tag_val(uint8_t tag)
+{
+    return NULL;
+}
+
+bool telemetry_set_u8(telemetry_t *val, uint8_t v, time_micros_t now)
+{
+    return false;
+}
+
+bool telemetry_set_u16(telemetry_t *val, uint16_t v, time_micros_t now)
+{
+    return false;
+}
+
+bool telemetry_set_i16(telemetry_t *val, int16_t v, time_micros_t now)
+{
+    return false;
+}
+
+bool telemetry_set_i32(telemetry_t *val, int32_t v, time_micros_t now)
+{
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// reconfigure
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// As uart_t keeps them
+static union {
+    input_ltm_t ltm;
+    input_nmea_t nmea;
+    input_smartport_t smartport;
+    input_ubx_t ubx;
+} _inputs;
+
+// All the configs start with baudrate, rx and tx
+static union {
+    input_ltm_config_t ltm;
+    input_nmea_config_t nmea;
+    input_smartport_config_t smartport;
+    input_ubx_config_t ubx;
+} _config;
+
+typedef struct
+{
+    const char *name;
+    void (*init)(void *input);
+} input_type_t;
+
+static const input_type_t _types[] = {
+    {"LTM", (void (*)(void *))input_ltm_init},
+    {"NMEA", (void (*)(void *))input_nmea_init},
+    {"SmartPort", (void (*)(void *))input_smartport_init},
+    {"UBX", (void (*)(void *))input_ubx_init},
+};
+
+static input_t *_input;
+
+static void reconfigure(const input_type_t *type)
+{
+    if (_input)
+    {
+        input_close(_input, &_config);
+        _input = NULL;
+    }
+
+    memset(&_inputs, 0, sizeof(_inputs));
+    type->init(&_inputs);
+    _input = (input_t *)&_inputs;
+
+    _config.ltm.baudrate = 115200;
+    _config.ltm.rx = 16;
+    _config.ltm.tx = 17;
+    input_open(NULL, _input, &_config);
+
+    for (int ii = 0; ii < UPDATES; ii++)
+    {
+        input_update(_input, time_micros_now());
+    }
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    // The first round may set up lazily allocated state, only the rest must stay flat
+    for (size_t ii = 0; ii < ARRAY_COUNT(_types); ii++)
+    {
+        reconfigure(&_types[ii]);
+    }
+    uint32_t allocs = _allocs;
+    int32_t live = _live;
+
+    for (int cycle = 0; cycle < CYCLES; cycle++)
+    {
+        reconfigure(&_types[cycle % ARRAY_COUNT(_types)]);
+    }
+
+    input_close(_input, &_config);
+
+    printf("%d reconfigures, %u ports opened, %u allocations (%u during the cycles), %d live\n",
+           CYCLES, _port_opens, _allocs, _allocs - allocs, _live);
+
+    if (_allocs != allocs || _live != live)
+    {
+        printf("FAIL: the heap changed while reconfiguring\n");
+        ok = false;
+    }
+    if (_port.open)
+    {
+        printf("FAIL: the port was left open\n");
+        ok = false;
+    }
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
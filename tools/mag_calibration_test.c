@@ -0,0 +1,146 @@
+// Feeds mag_calibration with readings from a synthetic hard and soft iron
+// distorted sphere and checks the correction it finds makes it round again.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/host -I main -I main/sensors -o mag_calibration_test
+//      tools/mag_calibration_test.c main/sensors/mag_calibration.c main/sensors/sensor_calib.c -lm
+//
+// Exits with 1 if any check fails.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mag_calibration.h"
+
+#define FIELD 300.0  // Earth field in raw units
+#define NOISE 4.0    // Peak to peak, raw units
+#define SAMPLES 6000
+#define CHECKS 2000
+// Corrected radius has to stay within this of its mean
+#define MAX_SPREAD 0.02
+
+// Soft iron stretches and skews the sphere, hard iron moves it
+static const double _soft_iron[3][3] = {
+    {1.20, 0.10, 0.05},
+    {0.10, 0.85, -0.08},
+    {0.05, -0.08, 1.00},
+};
+static const double _hard_iron[3] = {120, -80, 45};
+
+static double random_unit(void)
+{
+    return rand() / (double)RAND_MAX;
+}
+
+// A random direction, over the whole sphere or around the horizon only
+static void random_direction(double u[3], bool planar)
+{
+    double theta = planar ? M_PI / 2 + 0.05 * sin(2 * M_PI * random_unit()) : acos(2 * random_unit() - 1);
+    double phi = 2 * M_PI * random_unit();
+
+    u[0] = sin(theta) * cos(phi);
+    u[1] = sin(theta) * sin(phi);
+    u[2] = cos(theta);
+}
+
+static void distort(const double u[3], double noise, double m[3])
+{
+    for (int ii = 0; ii < 3; ii++)
+    {
+        m[ii] = _hard_iron[ii] + (random_unit() - 0.5) * noise;
+        for (int jj = 0; jj < 3; jj++)
+        {
+            m[ii] += FIELD * _soft_iron[ii][jj] * u[jj];
+        }
+    }
+}
+
+// Radius spread of clean readings corrected as imu_update() does, relative to the mean
+static double corrected_spread(const int16_t offsets[3], int16_t soft_iron[3][3], bool planar)
+{
+    double min = INFINITY, max = 0, sum = 0;
+
+    for (int ii = 0; ii < CHECKS; ii++)
+    {
+        double u[3], m[3], c[3] = {0, 0, 0};
+
+        random_direction(u, planar);
+        distort(u, 0, m);
+        for (int jj = 0; jj < 3; jj++)
+        {
+            for (int kk = 0; kk < 3; kk++)
+            {
+                c[jj] += soft_iron[jj][kk] * (m[kk] - offsets[kk]) / MAG_CALIBRATION_ONE;
+            }
+        }
+
+        double r = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        min = fmin(min, r);
+        max = fmax(max, r);
+        sum += r;
+    }
+    return (max - min) / (sum / CHECKS);
+}
+
+static bool run(const char *name, int samples, bool planar, bool expect_fit)
+{
+    int16_t offsets[3];
+    int16_t soft_iron[3][3];
+    bool ok = true;
+
+    srand(1);
+    mag_calibration_init();
+    for (int ii = 0; ii < samples; ii++)
+    {
+        double u[3], m[3];
+
+        random_direction(u, planar);
+        distort(u, NOISE, m);
+        mag_calibration_update(lrint(m[0]), lrint(m[1]), lrint(m[2]));
+    }
+
+    bool fit = mag_calibration_finish(offsets, soft_iron);
+    double spread = corrected_spread(offsets, soft_iron, planar);
+
+    printf("%s: %s, offsets %d %d %d, radius spread %.2f%%\n", name, fit ? "ellipsoid" : "offsets only",
+           offsets[0], offsets[1], offsets[2], spread * 100);
+
+    if (fit != expect_fit)
+    {
+        printf("  FAIL: expected %s\n", expect_fit ? "an ellipsoid fit" : "offsets only");
+        ok = false;
+    }
+    if (fit && spread > MAX_SPREAD)
+    {
+        printf("  FAIL: spread above %.1f%%\n", MAX_SPREAD * 100);
+        ok = false;
+    }
+    if (!fit)
+    {
+        for (int ii = 0; ii < 3; ii++)
+        {
+            for (int jj = 0; jj < 3; jj++)
+            {
+                if (soft_iron[ii][jj] != (ii == jj ? MAG_CALIBRATION_ONE : 0))
+                {
+                    printf("  FAIL: soft iron is not identity\n");
+                    return false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+int main(void)
+{
+    bool ok = run("sphere", SAMPLES, false, true);
+    // Only turned around one axis, the fit can't see the third one
+    ok &= run("planar", SAMPLES, true, false);
+    ok &= run("few samples", MAG_CALIBRATION_MIN_SAMPLES - 1, false, false);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+// Feeds recorded FIFO byte streams through mpu9250_read_fifo() over a
+// stubbed I2C bus, to check bursts, overflows and misaligned counts.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/host -I main -o mpu9250_fifo_test
+//      tools/mpu9250_fifo_test.c main/sensors/driver/mpu9250.c
+//
+// Exits with 1 if any check fails.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sensors/driver/mpu9250.h"
+#include "util/macros.h"
+
+// Room for an overflowed FIFO and then some
+#define STREAM_SIZE 1024
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// stubbed bus
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// The part's FIFO, as the bytes it would return on FIFO_R_W
+static uint8_t _fifo[STREAM_SIZE];
+static uint16_t _fifo_len;
+static uint16_t _fifo_pos;
+static uint32_t _fifo_resets;
+static bool _fail_reads;
+
+static uint16_t fifo_available(void)
+{
+    return _fifo_len - _fifo_pos;
+}
+
+static void fifo_push(const uint8_t *data, uint16_t len)
+{
+    memcpy(&_fifo[_fifo_len], data, len);
+    _fifo_len += len;
+}
+
+static void fifo_clear(void)
+{
+    _fifo_len = 0;
+    _fifo_pos = 0;
+}
+
+void mpu9250_i2c_init(mpu9250_i2c_config_t *cfg)
+{
+}
+
+bool mpu9250_i2c_read(mpu9250_i2c_config_t *cfg, uint8_t *data, uint32_t size)
+{
+    return false;
+}
+
+bool mpu9250_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t *data, uint32_t size)
+{
+    if (size == 2 && data[0] == MPU9250_USER_CTRL && (data[1] & MPU9250_USER_CTRL_FIFO_RST))
+    {
+        fifo_clear();
+        _fifo_resets++;
+    }
+    return true;
+}
+
+bool ak8963_i2c_read(mpu9250_i2c_config_t *cfg, uint8_t *data, uint32_t size)
+{
+    return false;
+}
+
+bool ak8963_i2c_write(mpu9250_i2c_config_t *cfg, uint8_t *data, uint32_t size)
+{
+    return false;
+}
+
+bool mpu9250_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t *data, uint32_t size)
+{
+    if (_fail_reads)
+    {
+        return false;
+    }
+
+    switch (reg)
+    {
+    case MPU9250_FIFO_COUNTH:
+    {
+        // The part counts up to 8191 bytes, the top bits of COUNTH are undefined
+        uint16_t count = fifo_available();
+        data[0] = 0xE0 | (count >> 8);
+        data[1] = count & 0xff;
+        return true;
+    }
+    case MPU9250_FIFO_R_W:
+        if (size > fifo_available())
+        {
+            printf("  FAIL: read %u bytes past the FIFO end\n", size);
+            return false;
+        }
+        memcpy(data, &_fifo[_fifo_pos], size);
+        _fifo_pos += size;
+        return true;
+    default:
+        memset(data, 0, size);
+        return true;
+    }
+}
+
+bool ak8963_i2c_read_reg(mpu9250_i2c_config_t *cfg, uint8_t reg, uint8_t *data, uint32_t size)
+{
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// recorded samples
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Sample ii of a stream, with a new mag measurement every other one and an
+// overflowed one every 7th
+static void record_sample(int ii, uint8_t data[MPU9250_FIFO_SAMPLE_SIZE])
+{
+    const int16_t values[] = {
+        // accel, temp, gyro
+        1000 + ii, -2000 - ii, 4096, 300, ii, -ii, 7 * ii,
+    };
+    const int16_t mag[] = {100 + ii, -50, ii * 3};
+
+    for (int jj = 0; jj < 7; jj++)
+    {
+        data[jj * 2] = values[jj] >> 8;
+        data[jj * 2 + 1] = values[jj] & 0xff;
+    }
+
+    // ST1, HXL..HZH and ST2 from the I2C master, mag is little endian
+    data[14] = ii % 2 == 0 ? AK8963_ST1_DRDY : 0;
+    for (int jj = 0; jj < 3; jj++)
+    {
+        data[15 + jj * 2] = mag[jj] & 0xff;
+        data[16 + jj * 2] = mag[jj] >> 8;
+    }
+    data[21] = ii % 7 == 6 ? AK8963_ST2_HOFL : 0;
+}
+
+static void record_samples(int first, int count)
+{
+    uint8_t data[MPU9250_FIFO_SAMPLE_SIZE];
+
+    for (int ii = first; ii < first + count; ii++)
+    {
+        record_sample(ii, data);
+        fifo_push(data, sizeof(data));
+    }
+}
+
+static bool check_sample(int ii, const imu_sensor_data_t *s)
+{
+    bool mag_updated = ii % 2 == 0 && ii % 7 != 6;
+
+    if (s->accel[0] != 1000 + ii || s->accel[1] != -2000 - ii || s->accel[2] != 4096 ||
+        s->gyro[0] != ii || s->gyro[1] != -ii || s->gyro[2] != 7 * ii ||
+        s->mag_updated != mag_updated ||
+        (mag_updated && (s->mag[0] != 100 + ii || s->mag[1] != -50 || s->mag[2] != ii * 3)))
+    {
+        printf("  FAIL: sample %d parsed as accel %d %d %d gyro %d %d %d mag %d %d %d (%s)\n", ii,
+               s->accel[0], s->accel[1], s->accel[2], s->gyro[0], s->gyro[1], s->gyro[2],
+               s->mag[0], s->mag[1], s->mag[2], s->mag_updated ? "updated" : "not updated");
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests
+//
+////////////////////////////////////////////////////////////////////////////////
+static mpu9250_t _mpu9250;
+static imu_sensor_data_t _samples[MPU9250_FIFO_MAX_BURST + 4];
+
+static void reset(void)
+{
+    fifo_clear();
+    _fifo_resets = 0;
+    _fail_reads = false;
+    memset(_samples, 0, sizeof(_samples));
+}
+
+static bool expect_read(int max_samples, int expected, int first)
+{
+    int n = mpu9250_read_fifo(&_mpu9250, _samples, max_samples);
+    if (n != expected)
+    {
+        printf("  FAIL: read %d samples, expected %d\n", n, expected);
+        return false;
+    }
+    for (int ii = 0; ii < n; ii++)
+    {
+        if (!check_sample(first + ii, &_samples[ii]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_burst(void)
+{
+    reset();
+    record_samples(0, 5);
+    return expect_read(ARRAY_COUNT(_samples), 5, 0) && expect_read(ARRAY_COUNT(_samples), 0, 0);
+}
+
+// More queued than a burst takes, the rest comes with the next read in order
+static bool test_long_burst(void)
+{
+    reset();
+    record_samples(0, MPU9250_FIFO_MAX_BURST + 3);
+    return expect_read(ARRAY_COUNT(_samples), MPU9250_FIFO_MAX_BURST, 0) &&
+           expect_read(ARRAY_COUNT(_samples), 3, MPU9250_FIFO_MAX_BURST) &&
+           expect_read(2, 0, 0);
+}
+
+static bool test_max_samples(void)
+{
+    reset();
+    record_samples(0, 5);
+    return expect_read(2, 2, 0) && expect_read(2, 2, 2) && expect_read(2, 1, 4);
+}
+
+// Samples lost to an overflow are reported, and the FIFO starts over
+static bool test_overflow(void)
+{
+    reset();
+    record_samples(0, MPU9250_FIFO_SIZE / MPU9250_FIFO_SAMPLE_SIZE + 1);
+    if (!expect_read(ARRAY_COUNT(_samples), -1, 0))
+    {
+        return false;
+    }
+    if (_fifo_resets != 1 || fifo_available() != 0)
+    {
+        printf("  FAIL: FIFO wasn't reset\n");
+        return false;
+    }
+    record_samples(40, 3);
+    return expect_read(ARRAY_COUNT(_samples), 3, 40);
+}
+
+// A partial sample means the start of the stream is lost, nothing can be trusted
+static bool test_misaligned(void)
+{
+    uint8_t data[MPU9250_FIFO_SAMPLE_SIZE];
+
+    reset();
+    record_sample(0, data);
+    fifo_push(&data[5], sizeof(data) - 5);
+    record_samples(1, 3);
+    if (!expect_read(ARRAY_COUNT(_samples), -1, 0))
+    {
+        return false;
+    }
+    if (_fifo_resets != 1)
+    {
+        printf("  FAIL: FIFO wasn't reset\n");
+        return false;
+    }
+    return true;
+}
+
+static bool test_bus_error(void)
+{
+    reset();
+    record_samples(0, 3);
+    _fail_reads = true;
+    if (!expect_read(ARRAY_COUNT(_samples), 0, 0))
+    {
+        return false;
+    }
+    _fail_reads = false;
+    return expect_read(ARRAY_COUNT(_samples), 3, 0);
+}
+
+typedef struct
+{
+    const char *name;
+    bool (*run)(void);
+} test_t;
+
+static const test_t _tests[] = {
+    {"burst", test_burst},
+    {"long burst", test_long_burst},
+    {"max samples", test_max_samples},
+    {"overflow", test_overflow},
+    {"misaligned", test_misaligned},
+    {"bus error", test_bus_error},
+};
+
+int main(void)
+{
+    bool ok = true;
+
+    for (size_t ii = 0; ii < ARRAY_COUNT(_tests); ii++)
+    {
+        bool passed = _tests[ii].run();
+        printf("%-12s %s\n", _tests[ii].name, passed ? "ok" : "FAILED");
+        ok &= passed;
+    }
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
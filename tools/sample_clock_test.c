@@ -0,0 +1,155 @@
+// Feeds a simulated IMU FIFO, read at jittered times, through sample_clock
+// and checks the sample timestamps come out evenly spaced.
+//
+// Build from the repository root:
+//   cc -O2 -I tools/host -I main -I main/sensors -o sample_clock_test
+//      tools/sample_clock_test.c main/sensors/sample_clock.c -lm
+//
+// Exits with 1 if any check fails.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sample_clock.h"
+
+#define RATE_HZ 200
+#define FIFO_SAMPLES 16
+#define SECONDS 60
+// The part's oscillator is this much faster than ours
+#define DRIFT_PPM 3000
+// Reads every 5ms plus up to this much scheduling jitter, and now and then a stall
+#define POLL_US 5000
+#define JITTER_US 3000
+#define STALL_US 40000
+#define STALL_EVERY 500
+
+// dt error allowed away from re-anchors, the stamps are whole microseconds
+#define MAX_DT_ERROR_US 1.0
+
+typedef struct
+{
+    double dt_sum_sq;
+    double dt_max;
+    uint32_t count;
+    uint32_t anchors;
+} stats_t;
+
+static void stats_add(stats_t *stats, double dt_error)
+{
+    stats->dt_sum_sq += dt_error * dt_error;
+    if (fabs(dt_error) > stats->dt_max)
+    {
+        stats->dt_max = fabs(dt_error);
+    }
+    stats->count++;
+}
+
+// How imu_task stamped bursts before: from the read time, 1 / RATE_HZ apart
+static time_micros_t read_time_stamp(int ii, int n, time_micros_t now)
+{
+    return now - (time_micros_t)(n - 1 - ii) * MICROS_PER_SEC / RATE_HZ;
+}
+
+static bool run(bool overflow)
+{
+    const double period = 1e6 / RATE_HZ / (1 + DRIFT_PPM / 1e6);
+    sample_clock_t clock;
+    stats_t clock_stats = {0};
+    stats_t read_stats = {0};
+    time_micros_t last_clock = 0;
+    time_micros_t last_read = 0;
+    double taken = 1e6; // When the next sample is taken by the part
+    time_micros_t now = 1000000;
+    uint32_t reads = 0;
+    uint32_t resets = 0;
+    bool ok = true;
+
+    srand(1);
+    sample_clock_init(&clock, RATE_HZ);
+
+    while (now < (time_micros_t)SECONDS * MICROS_PER_SEC)
+    {
+        now += POLL_US + rand() % JITTER_US;
+        if (++reads % STALL_EVERY == 0)
+        {
+            now += overflow ? STALL_US * 4 : STALL_US;
+        }
+
+        int n = 0;
+        while (taken <= now)
+        {
+            n++;
+            taken += period;
+        }
+
+        if (n > FIFO_SAMPLES)
+        {
+            // Overflowed, the driver resets the FIFO and reports the loss
+            sample_clock_reset(&clock);
+            last_clock = 0;
+            last_read = 0;
+            resets++;
+            continue;
+        }
+
+        sample_clock_burst(&clock, n, now);
+        if (clock.count == 0 && n > 0 && last_clock != 0)
+        {
+            clock_stats.anchors++;
+        }
+
+        for (int ii = 0; ii < n; ii++)
+        {
+            time_micros_t t = sample_clock_next(&clock);
+            time_micros_t r = read_time_stamp(ii, n, now);
+
+            if (last_clock != 0 && !(ii == 0 && clock.count == 1))
+            {
+                stats_add(&clock_stats, (double)(t - last_clock) - period);
+            }
+            if (last_read != 0)
+            {
+                stats_add(&read_stats, (double)(r - last_read) - period);
+            }
+            last_clock = t;
+            last_read = r;
+        }
+    }
+
+    double clock_rms = sqrt(clock_stats.dt_sum_sq / clock_stats.count);
+    double read_rms = sqrt(read_stats.dt_sum_sq / read_stats.count);
+
+    printf("%s: %u FIFO resets, %u re-anchors\n", overflow ? "overflowing" : "jittered", resets, clock_stats.anchors);
+    printf("  read time stamps    dt error rms %7.1fus max %7.1fus\n", read_rms, read_stats.dt_max);
+    printf("  sample clock stamps dt error rms %7.1fus max %7.1fus\n", clock_rms, clock_stats.dt_max);
+
+    // The part's own drift is all that's left between re-anchors
+    const double allowed = MAX_DT_ERROR_US + 1e6 / RATE_HZ * DRIFT_PPM / 1e6;
+    if (clock_stats.dt_max > allowed)
+    {
+        printf("  FAIL: dt error above %.1fus\n", allowed);
+        ok = false;
+    }
+    if (clock_rms >= read_rms)
+    {
+        printf("  FAIL: no better than stamping from the read time\n");
+        ok = false;
+    }
+    if (overflow && resets == 0)
+    {
+        printf("  FAIL: the FIFO never overflowed\n");
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    bool ok = run(false);
+    ok &= run(true);
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+// Measures how long an ATP or MAVLink datagram waits in the WiFi receive task
+// before it's handled, and how often the task wakes up while idle, with the
+// real socket code from main/wifi/udp.c on top of the host's POSIX sockets.
+//
+// Build from the repository root:
+//   cc -O2 -pthread -I tools/host -I main -o udp_receive_bench
+//      tools/udp_receive_bench.c main/wifi/udp.c
+//
+// then:
+//   ./udp_receive_bench [-n datagrams]
+//
+// Binds the firmware's ports (UDP_PORT and MAVLINK_ROUTER_UDP_LOCAL_PORT), so
+// nothing else may be using them. Runs the receive loop both as it is now
+// (wifi_udp_wait()) and as it was before, polling and sleeping 10ms when idle.
+// Exits with 1 if a datagram is lost, or if the select() loop takes longer than
+// MAX_AVG_LATENCY_US on average or wakes more than the timeout needs when idle.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "protocols/atp.h"
+#include "protocols/mavlink_router.h"
+#include "util/macros.h"
+#include "util/time.h"
+#include "wifi/udp.h"
+
+// Same as wifi.h
+#define BUFFER_LENGHT 512
+#define WIFI_RECEIVE_TIMEOUT_MS 500
+// What task_receive() slept for when both sockets were empty, before select()
+#define POLL_IDLE_DELAY_MS 10
+
+#define DEFAULT_DATAGRAMS 200
+#define MAX_DATAGRAMS 10000
+#define IDLE_US SECS_TO_MICROS(2)
+// Random gaps between datagrams, so they land anywhere in the poll sleep
+#define MAX_GAP_US 20000
+#define MAX_AVG_LATENCY_US 1000
+
+typedef struct
+{
+    uint32_t seq;
+    time_micros_t sent;
+} probe_t;
+
+typedef struct
+{
+    const char *name;
+    void (*loop)(void);
+} receiver_t;
+
+static volatile bool _running;
+static volatile uint32_t _wakeups;
+static time_micros_t _received[MAX_DATAGRAMS];
+static time_micros_t _sent[MAX_DATAGRAMS];
+static uint32_t _duplicates;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// receive task
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Stands for wifi->callback() and mavlink_router_receive()
+static void handle(const char *buffer, int len)
+{
+    time_micros_t now = time_micros_now();
+    probe_t probe;
+
+    if (len != sizeof(probe))
+    {
+        return;
+    }
+    memcpy(&probe, buffer, sizeof(probe));
+    if (probe.seq >= MAX_DATAGRAMS)
+    {
+        return;
+    }
+    if (_received[probe.seq] != 0)
+    {
+        _duplicates++;
+        return;
+    }
+    _received[probe.seq] = now;
+}
+
+// task_receive() in wifi.c
+static void loop_select(void)
+{
+    static char buffer[BUFFER_LENGHT];
+    int len;
+
+    while (_running)
+    {
+        _wakeups++;
+        int readable = wifi_udp_wait(WIFI_RECEIVE_TIMEOUT_MS);
+
+        if (readable & UDP_READABLE_SERVER)
+        {
+            while ((len = wifi_udp_receive(buffer, BUFFER_LENGHT)) > 0)
+            {
+                handle(buffer, len);
+            }
+        }
+
+        if (readable & UDP_READABLE_MAVLINK)
+        {
+            while ((len = wifi_udp_mavlink_receive(buffer, BUFFER_LENGHT)) > 0)
+            {
+                handle(buffer, len);
+            }
+        }
+    }
+}
+
+// task_receive() before it used wifi_udp_wait()
+static void loop_poll(void)
+{
+    static char buffer[BUFFER_LENGHT];
+    int len;
+
+    while (_running)
+    {
+        bool idle = true;
+        _wakeups++;
+
+        len = wifi_udp_receive(buffer, BUFFER_LENGHT);
+        if (len > 0)
+        {
+            handle(buffer, len);
+            idle = false;
+        }
+
+        len = wifi_udp_mavlink_receive(buffer, BUFFER_LENGHT);
+        if (len > 0)
+        {
+            handle(buffer, len);
+            idle = false;
+        }
+
+        if (idle)
+        {
+            vTaskDelay(MILLIS_TO_TICKS(POLL_IDLE_DELAY_MS));
+        }
+    }
+}
+
+static void *receiver_task(void *arg)
+{
+    const receiver_t *receiver = arg;
+    receiver->loop();
+    return NULL;
+}
+
+static const receiver_t _receivers[] = {
+    {"poll", loop_poll},
+    {"select", loop_select},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// bench
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void sleep_us(uint32_t us)
+{
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000L};
+    nanosleep(&ts, NULL);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool run(const receiver_t *receiver, int sock, uint32_t count)
+{
+    struct sockaddr_in ports[2];
+    pthread_t thread;
+    bool ok = true;
+
+    memset(ports, 0, sizeof(ports));
+    ports[0].sin_family = AF_INET;
+    ports[0].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ports[0].sin_port = htons(UDP_PORT);
+    ports[1] = ports[0];
+    ports[1].sin_port = htons(MAVLINK_ROUTER_UDP_LOCAL_PORT);
+
+    memset(_received, 0, sizeof(_received));
+    memset(_sent, 0, sizeof(_sent));
+    _duplicates = 0;
+    _wakeups = 0;
+    _running = true;
+    pthread_create(&thread, NULL, receiver_task, (void *)receiver);
+
+    // Idle first, to count the wakeups without traffic
+    sleep_us(IDLE_US);
+    uint32_t idle_wakeups = _wakeups;
+
+    for (uint32_t ii = 0; ii < count; ii++)
+    {
+        sleep_us(rand() % MAX_GAP_US);
+        probe_t probe = {.seq = ii, .sent = time_micros_now()};
+        _sent[ii] = probe.sent;
+        // Alternates between the ATP and MAVLink sockets
+        sendto(sock, &probe, sizeof(probe), 0, (struct sockaddr *)&ports[ii % 2], sizeof(ports[ii % 2]));
+    }
+
+    // Let the last one arrive, then wake the loop up so it sees _running
+    sleep_us(MILLIS_TO_MICROS(50));
+    _running = false;
+    probe_t stop = {.seq = MAX_DATAGRAMS};
+    sendto(sock, &stop, sizeof(stop), 0, (struct sockaddr *)&ports[0], sizeof(ports[0]));
+    pthread_join(thread, NULL);
+
+    static uint32_t latencies[MAX_DATAGRAMS];
+    uint32_t received = 0;
+    uint64_t total = 0;
+    for (uint32_t ii = 0; ii < count; ii++)
+    {
+        if (_received[ii] != 0)
+        {
+            latencies[received] = _received[ii] - _sent[ii];
+            total += latencies[received];
+            received++;
+        }
+    }
+    qsort(latencies, received, sizeof(latencies[0]), compare_u32);
+
+    uint32_t avg = received > 0 ? total / received : 0;
+    float idle_rate = idle_wakeups / (IDLE_US / 1e6f);
+    printf("%-6s | %u/%u received, latency avg %6uus median %6uus max %6uus | idle wakeups %6.1f/s\n",
+           receiver->name,
+           received,
+           count,
+           avg,
+           received > 0 ? latencies[received / 2] : 0,
+           received > 0 ? latencies[received - 1] : 0,
+           idle_rate);
+
+    if (received != count || _duplicates > 0)
+    {
+        printf("  FAIL: %u lost, %u duplicated\n", count - received, _duplicates);
+        ok = false;
+    }
+    if (receiver->loop == loop_select)
+    {
+        if (avg > MAX_AVG_LATENCY_US)
+        {
+            printf("  FAIL: average latency over %uus\n", MAX_AVG_LATENCY_US);
+            ok = false;
+        }
+        // One wakeup per timeout, plus the first one
+        if (idle_wakeups > IDLE_US / MILLIS_TO_MICROS(WIFI_RECEIVE_TIMEOUT_MS) + 1)
+        {
+            printf("  FAIL: %u wakeups while idle\n", idle_wakeups);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n datagrams]\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = DEFAULT_DATAGRAMS;
+    bool ok = true;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (strcmp(argv[ii], "-n") == 0 && ii + 1 < argc)
+        {
+            count = atoi(argv[++ii]);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if (count == 0 || count > MAX_DATAGRAMS)
+    {
+        usage(argv[0]);
+    }
+
+    wifi_udp_init();
+    if (wifi_create_udp_server() != ESP_OK || wifi_create_udp_mavlink(htonl(INADDR_LOOPBACK)) != ESP_OK)
+    {
+        fprintf(stderr, "could not bind ports %d and %d\n", UDP_PORT, MAVLINK_ROUTER_UDP_LOCAL_PORT);
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+
+    srand(1);
+    for (size_t ii = 0; ii < ARRAY_COUNT(_receivers); ii++)
+    {
+        ok &= run(&_receivers[ii], sock, count);
+    }
+
+    close(sock);
+    wifi_udp_close();
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}